@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+#include "affinity.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+static int pin_cpus[AFFINITY_MAX_CPUS];
+static int pin_count = 0;
+static int cpu_node[AFFINITY_MAX_CPUS];
+static int node_count = 0;           // 0 until the topology has been read
+static _Thread_local int thread_node = -1;
+
+/**
+ * @brief parse a cpulist such as "0-3,8" into a membership array
+ *
+ * @param[in] list text to parse
+ * @param[out] member member[cpu] set for every listed cpu
+ *
+ * @return false on malformed text or a cpu past AFFINITY_MAX_CPUS
+ */
+static bool parse_cpulist(const char* list, bool* member){
+    const char* at = list;
+    while (*at && *at != '\n'){
+        char* end;
+        long first = strtol(at, &end, 10);
+        if (end == at || first < 0){
+            return false;
+        }
+        long last = first;
+        at = end;
+        if (*at == '-'){
+            last = strtol(at + 1, &end, 10);
+            if (end == at + 1 || last < first){
+                return false;
+            }
+            at = end;
+        }
+        if (last >= AFFINITY_MAX_CPUS){
+            return false;
+        }
+        for (long cpu = first; cpu <= last; cpu++){
+            member[cpu] = true;
+        }
+        if (*at == ','){
+            at++;
+        } else if (*at && *at != '\n'){
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief read which node every cpu belongs to from sysfs, once
+ */
+static void read_topology(void){
+    if (node_count > 0){
+        return;
+    }
+
+    for (int cpu = 0; cpu < AFFINITY_MAX_CPUS; cpu++){
+        cpu_node[cpu] = 0;
+    }
+
+    int nodes = 0;
+    for (int node = 0; node < AFFINITY_MAX_NODES; node++){
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE* file = fopen(path, "r");
+        if (!file){
+            continue;
+        }
+
+        char line[4096];
+        bool member[AFFINITY_MAX_CPUS] = { false };
+        if (fgets(line, sizeof(line), file) && parse_cpulist(line, member)){
+            for (int cpu = 0; cpu < AFFINITY_MAX_CPUS; cpu++){
+                if (member[cpu]){
+                    cpu_node[cpu] = node;
+                }
+            }
+            nodes = node + 1;
+        }
+        fclose(file);
+    }
+
+    node_count = nodes > 0 ? nodes : 1;
+}
+
+bool affinity_parse(const char* list, char* error, size_t errorSize){
+    read_topology();
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    bool member[AFFINITY_MAX_CPUS] = { false };
+    int count = 0;
+
+    if (strcmp(list, "all") == 0){
+        // node by node, so consecutive thread indices stay on one socket
+        for (int node = 0; node < node_count; node++){
+            for (int cpu = 0; cpu < online && cpu < AFFINITY_MAX_CPUS; cpu++){
+                if (cpu_node[cpu] == node){
+                    pin_cpus[count++] = cpu;
+                }
+            }
+        }
+    } else {
+        if (!parse_cpulist(list, member)){
+            snprintf(error, errorSize, "bad CPU list \"%s\"", list);
+            return false;
+        }
+        for (int cpu = 0; cpu < AFFINITY_MAX_CPUS; cpu++){
+            if (!member[cpu]){
+                continue;
+            }
+            if (cpu >= online){
+                snprintf(error, errorSize, "CPU %d is not online (%ld CPUs)", cpu, online);
+                return false;
+            }
+            pin_cpus[count++] = cpu;
+        }
+    }
+
+    if (count == 0){
+        snprintf(error, errorSize, "no CPUs in \"%s\"", list);
+        return false;
+    }
+    pin_count = count;
+    return true;
+}
+
+bool affinity_enabled(void){
+    return pin_count > 0;
+}
+
+int affinity_cpu_count(void){
+    return pin_count;
+}
+
+int affinity_node_count(void){
+    read_topology();
+    return node_count;
+}
+
+int affinity_cpu_for(int index){
+    if (pin_count == 0 || index < 0){
+        return -1;
+    }
+    return pin_cpus[index % pin_count];
+}
+
+int affinity_node_for(int index){
+    int cpu = affinity_cpu_for(index);
+    return cpu < 0 ? -1 : cpu_node[cpu];
+}
+
+bool affinity_pin_self(int index){
+    int cpu = affinity_cpu_for(index);
+    if (cpu < 0){
+        return false;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0){
+        return false;
+    }
+    thread_node = cpu_node[cpu];
+    return true;
+}
+
+int affinity_thread_node(void){
+    return thread_node;
+}
+
+/**
+ * @brief apply a memory policy to the pages under a range
+ *
+ * @param[in] addr start of the range
+ * @param[in] len length in bytes
+ * @param[in] mode MPOL_PREFERRED or MPOL_INTERLEAVE
+ * @param[in] mask node bitmask
+ */
+static void bind_pages(void* addr, size_t len, int mode, unsigned long mask){
+    if (!addr || len == 0){
+        return;
+    }
+
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~(page - 1);
+    uintptr_t end = ((uintptr_t)addr + len + page - 1) & ~(page - 1);
+
+    // best effort: memory that cannot move simply stays where it is
+    syscall(SYS_mbind, (void*)start, end - start, mode, &mask, sizeof(mask) * 8, MPOL_MF_MOVE);
+}
+
+void affinity_place(void* addr, size_t len, int node){
+    if (node < 0 || node >= AFFINITY_MAX_NODES || affinity_node_count() < 2){
+        return;
+    }
+    bind_pages(addr, len, MPOL_PREFERRED, 1UL << node);
+}
+
+void affinity_interleave(void* addr, size_t len){
+    int nodes = affinity_node_count();
+    if (nodes < 2){
+        return;
+    }
+    unsigned long mask = nodes >= 64 ? ~0UL : (1UL << nodes) - 1;
+    bind_pages(addr, len, MPOL_INTERLEAVE, mask);
+}
@@ -0,0 +1,89 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define AFFINITY_MAX_CPUS 1024
+#define AFFINITY_MAX_NODES 64
+
+/**
+ * @brief Choose the CPUs simulation threads are pinned to.
+ *
+ * The list uses the kernel's cpulist format ("0-3,8,10-11"); "all" takes
+ * every online CPU ordered node by node, so neighbouring thread indices
+ * share a NUMA node. Thread index i runs on the (i % count)-th CPU.
+ *
+ * @param[in] list CPU list or "all".
+ * @param[out] error Message for a bad list.
+ * @param[in] errorSize Size of error.
+ * @return false on a malformed list or a CPU this machine does not have.
+ */
+bool affinity_parse(const char* list, char* error, size_t errorSize);
+
+/**
+ * @brief Check whether threads are being pinned.
+ * @return true after a successful affinity_parse.
+ */
+bool affinity_enabled(void);
+
+/**
+ * @brief Number of CPUs in the pin list.
+ * @return CPU count, 0 when pinning is off.
+ */
+int affinity_cpu_count(void);
+
+/**
+ * @brief Number of NUMA nodes with CPUs, read from sysfs.
+ * @return Node count, 1 when the machine has no NUMA information.
+ */
+int affinity_node_count(void);
+
+/**
+ * @brief CPU a thread index is pinned to.
+ * @param[in] index Thread index.
+ * @return CPU number, -1 when pinning is off.
+ */
+int affinity_cpu_for(int index);
+
+/**
+ * @brief NUMA node of the CPU a thread index is pinned to.
+ * @param[in] index Thread index.
+ * @return Node number, -1 when pinning is off.
+ */
+int affinity_node_for(int index);
+
+/**
+ * @brief Pin the calling thread to the CPU for a thread index.
+ * @param[in] index Thread index.
+ * @return false when pinning is off or the kernel refused.
+ */
+bool affinity_pin_self(int index);
+
+/**
+ * @brief NUMA node the calling thread was pinned to.
+ * @return Node number, -1 for a thread that was never pinned.
+ */
+int affinity_thread_node(void);
+
+/**
+ * @brief Move a memory range to a NUMA node and keep new pages there.
+ *
+ * Uses mbind with MPOL_PREFERRED and MPOL_MF_MOVE on every page the range
+ * touches, so callers placing small objects should pass one page at a
+ * time. Does nothing on single-node machines.
+ *
+ * @param[in] addr Start of the range.
+ * @param[in] len Length in bytes.
+ * @param[in] node Target node; negative does nothing.
+ */
+void affinity_place(void* addr, size_t len, int node);
+
+/**
+ * @brief Spread a memory range's pages across every node round robin.
+ * @param[in] addr Start of the range.
+ * @param[in] len Length in bytes.
+ */
+void affinity_interleave(void* addr, size_t len);
+
+#endif // AFFINITY_H
@@ -0,0 +1,905 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <malloc.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "defs.h"
+#include "helpers.h"
+
+#define BENCH_MAX_GUARD_COUNTS 16
+#define SUITE_MAX_SCENARIOS 32
+#define BENCH_SEED 1u                                 // Default --seed: run i of a configuration seeds its streams with this + i
+#define SUITE_SEED 20240601u                          // Every suite child keys its guards' and thieves' random streams off this
+#define SUITE_GENERATED "shape=grid,rooms=10000,seed=1" // Generated museum the suite runs on
+#define SUITE_TOLERANCE 25.0                          // Default percent a metric may worsen before it counts as a regression
+#define SUITE_RSS_SLACK_KB 8192                       // Peak RSS growth below this is malloc arena noise, whatever the percentage
+#define SUITE_REPEATS 3                               // Children per scenario; the median of each metric is reported
+
+// One fixed configuration of the benchmark suite
+struct SuiteScenario {
+    char name[48];
+    bool generated;            // SUITE_GENERATED instead of the built-in museum
+    int guards;
+    bool logging;              // CSV logs and console narration on, written to a scratch directory
+    bool slow;                 // Only run with --full: logging sleeps 2 ms per record, so big rosters take minutes
+};
+
+// What a suite child reports back to the parent through a pipe
+struct SuiteResult {
+    int runs;
+    unsigned long turns;
+    double simSeconds;         // Wall time inside sim_run, summed over runs
+    double wallSeconds;        // Wall time of the whole scenario, museum building included
+    unsigned long long p50;
+    unsigned long long p99;
+    long peakRssKb;            // Filled in by the parent from wait4
+};
+
+// Generated layout every run uses, NULL for the built-in museum
+static const struct Layout* bench_layout = NULL;
+
+// Thieves let loose in every run
+static int bench_thieves = 1;
+
+// Engine every run uses, threads unless --engine sharded
+static struct SimOptions bench_options = { 0 };
+
+// First run's seed for every configuration, 0 for clock-based streams
+static unsigned bench_seed = BENCH_SEED;
+
+// Stop repeating a configuration after this much wall time, museum building included; 0 for no limit
+static double bench_wall_limit = 0.0;
+
+/**
+ * @brief build a museum with generated guards, run it once and tear it down
+ *
+ * @param[in] guards number of guards to add
+ * @param[in] seed seed for every guard's and thief's random stream, 0 for clock-based
+ * @param[out] result statistics for this run
+ */
+static void bench_run_once(int guards, unsigned seed, struct SimResult* result) {
+    rand_seed(seed);
+    struct Museum museum;
+    museum_init(&museum);
+    if (bench_layout) {
+        museum_build(&museum, bench_layout);
+    } else {
+        museum_populate_rooms(&museum);
+    }
+    museum_reserve_guards(&museum, guards);
+
+    for (int i = 0; i < guards; i++) {
+        char name[MAX_GUARD_NAME];
+        snprintf(name, sizeof(name), "Guard %d", i + 1);
+        museum_add_guard(&museum, name, i + 1);
+    }
+
+    museum_add_thieves(&museum, bench_thieves);
+    sim_run(&museum, &bench_options, result);
+    museum_cleanup(&museum);
+}
+
+/**
+ * @brief repeat runs of one configuration until enough wall time has passed
+ *
+ * stops early once bench_wall_limit is reached, for configurations where
+ * building the museum takes much longer than running it. run i is seeded
+ * with firstSeed + i, so the runs are independent samples and the same
+ * firstSeed repeats them
+ *
+ * @param[in] guards number of guards per run
+ * @param[in] minSeconds minimum total simulated wall time
+ * @param[in] firstSeed seed of the first run, 0 for clock-based streams
+ * @param[out] total accumulated statistics across runs; solveTurns only counts solved runs
+ * @param[out] solves number of runs that ended with every case solved
+ *
+ * @return number of runs performed
+ */
+static int bench_config(int guards, double minSeconds, unsigned firstSeed, struct SimResult* total, int* solves) {
+    memset(total, 0, sizeof(*total));
+    *solves = 0;
+    latency_hist_init(&total->turnLatency);
+
+    int runs = 0;
+    unsigned long long start = stats_now_ns();
+    while (total->seconds < minSeconds || runs == 0) {
+        if (runs > 0 && bench_wall_limit > 0 && (double)(stats_now_ns() - start) / 1e9 >= bench_wall_limit) {
+            break;
+        }
+        struct SimResult one;
+        bench_run_once(guards, firstSeed == 0 ? 0 : firstSeed + (unsigned)runs, &one);
+
+        total->turns += one.turns;
+        if (one.solved) {
+            total->solveTurns += one.solveTurns;
+            (*solves)++;
+        }
+        total->thiefTurns += one.thiefTurns;
+        total->lockOps += one.lockOps;
+        total->crossNode += one.crossNode;
+        total->lockWaitNs += one.lockWaitNs;
+        total->moveAborts += one.moveAborts;
+        total->seconds += one.seconds;
+        latency_hist_merge(&total->turnLatency, &one.turnLatency);
+        runs++;
+    }
+
+    return runs;
+}
+
+/**
+ * @brief generate a compact museum and time generating, building and traversing it
+ *
+ * reports generation time, bytes per room against a full struct Room, the
+ * CSR build time, a breadth-first search from the exit and a long random
+ * walk that updates the out-of-line occupancy arrays the way a guard would
+ *
+ * @param[in] gen generator options, rooms included
+ *
+ * @return 0 on success, 1 if the museum could not be built
+ */
+static int bench_compact(const struct LayoutGenOptions* gen) {
+    uint32_t rooms = gen->rooms;
+    struct Layout layout;
+    unsigned long long start = stats_now_ns();
+    if (!layout_generate(&layout, gen)) {
+        fprintf(stderr, "Could not generate a %u room %s museum\n", rooms, layout_shape_to_string(gen->shape));
+        return 1;
+    }
+    double genSec = (double)(stats_now_ns() - start) / 1e9;
+
+    struct CompactMuseum museum;
+    start = stats_now_ns();
+    bool built = layout_to_compact(&layout, &museum);
+    layout_free(&layout);
+    if (!built) {
+        fprintf(stderr, "Could not build a %u room compact museum\n", rooms);
+        return 1;
+    }
+    double buildSec = (double)(stats_now_ns() - start) / 1e9;
+
+    uint32_t* dist = malloc((size_t)rooms * sizeof(uint32_t));
+    start = stats_now_ns();
+    uint32_t reached = dist ? compact_bfs(&museum, museum.exitRoom, dist) : 0;
+    double bfsSec = (double)(stats_now_ns() - start) / 1e9;
+    free(dist);
+
+    unsigned long steps = 10000000UL;
+    uint32_t at = museum.exitRoom;
+    unsigned rng = 0x9E3779B9u;
+    start = stats_now_ns();
+    for (unsigned long s = 0; s < steps; s++) {
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+        uint32_t degree = compact_degree(&museum, at);
+        if (degree == 0) {
+            break;
+        }
+        uint32_t next = museum.neighbours[museum.offsets[at] + rng % degree];
+        atomic_fetch_sub_explicit(&museum.guards[at], 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&museum.guards[next], 1, memory_order_relaxed);
+        at = next;
+    }
+    double walkSec = (double)(stats_now_ns() - start) / 1e9;
+
+    char name[64];
+    size_t bytes = compact_memory_bytes(&museum);
+    printf("compact %s museum: %u rooms, %u doors, %u distinct names (room %u is \"%s\")\n",
+           layout_shape_to_string(gen->shape), rooms, museum.offsets[rooms] / 2, museum.names.count, rooms - 1,
+           compact_room_name(&museum, rooms - 1, name, sizeof(name)));
+    printf("  memory:      %.1f MB (%.1f bytes/room; struct Room alone is %zu bytes)\n",
+           (double)bytes / 1e6, (double)bytes / rooms, sizeof(struct Room));
+    printf("  generate:    %.3f s (%d threads)\n", genSec, gen->threads);
+    printf("  build:       %.3f s\n", buildSec);
+    printf("  bfs:         %.3f s, %u rooms reached (%.1f ns/room)\n", bfsSec, reached, bfsSec * 1e9 / rooms);
+    printf("  random walk: %lu steps in %.3f s (%.1f ns/step)\n", steps, walkSec, walkSec * 1e9 / steps);
+
+    compact_free(&museum);
+    return 0;
+}
+
+/**
+ * @brief compare exploration strategies by how quickly and cheaply they solve the case
+ *
+ * every strategy runs at every guard count with the first lock backend.
+ * turns and lock acquisitions per solve are both taken over the solved
+ * runs only: the guard turns made before the case was solved, and every
+ * lock the guards took in those runs (thieves take none)
+ *
+ * @param[in] strategies strategies to compare
+ * @param[in] strategyCount number of strategies
+ * @param[in] guardCounts guard counts to run
+ * @param[in] guardCountLen number of guard counts
+ * @param[in] minSeconds minimum total simulated wall time per configuration
+ * @param[in] minRuns minimum runs per configuration
+ */
+static void bench_strategies(const enum GuardStrategy* strategies, int strategyCount, const int* guardCounts,
+                             int guardCountLen, double minSeconds, int minRuns) {
+    printf("%-9s %7s %5s %8s %14s %14s %12s\n",
+           "strategy", "guards", "runs", "solved", "turns/solve", "locks/solve", "turns/s");
+
+    for (int s = 0; s < strategyCount; s++) {
+        strategy_set(strategies[s]);
+
+        for (int g = 0; g < guardCountLen; g++) {
+            int solves = 0;
+            int runs = 0;
+            unsigned long turns = 0;
+            unsigned long solveLocks = 0;
+            unsigned long solveTurns = 0;
+            double seconds = 0.0;
+
+            // solve rates need many runs, so keep going until both limits are met
+            while (runs < minRuns || seconds < minSeconds) {
+                struct SimResult one;
+                bench_run_once(guardCounts[g], bench_seed == 0 ? 0 : bench_seed + (unsigned)runs, &one);
+                runs++;
+                turns += one.turns;
+                seconds += one.seconds;
+                if (one.solved) {
+                    solves++;
+                    solveTurns += one.solveTurns;
+                    solveLocks += one.lockOps;
+                }
+            }
+
+            printf("%-9s %7d %5d %7.0f%% ", strategy_to_string(strategies[s]), guardCounts[g], runs,
+                   100.0 * solves / runs);
+            if (solves > 0) {
+                printf("%14.0f %14.0f", (double)solveTurns / solves, (double)solveLocks / solves);
+            } else {
+                printf("%14s %14s", "n/a", "n/a");
+            }
+            printf(" %12.0f\n", seconds > 0 ? (double)turns / seconds : 0.0);
+            fflush(stdout);
+        }
+    }
+}
+
+/**
+ * @brief list the suite's scenarios in a fixed order
+ *
+ * every guard count on both museums with logging off, and with logging on
+ * where it finishes in seconds; the rest are marked slow
+ *
+ * @param[out] out scenarios, at least SUITE_MAX_SCENARIOS entries
+ *
+ * @return number of scenarios
+ */
+static int suite_scenarios(struct SuiteScenario* out) {
+    static const int guards[] = { 1, 8, 64, 1000, 10000 };
+    int count = 0;
+
+    for (int generated = 0; generated < 2; generated++) {
+        for (int g = 0; g < (int)(sizeof(guards) / sizeof(guards[0])); g++) {
+            for (int logging = 0; logging < 2; logging++) {
+                struct SuiteScenario* sc = &out[count++];
+                sc->generated = generated;
+                sc->guards = guards[g];
+                sc->logging = logging;
+                sc->slow = logging && guards[g] >= 1000;
+                snprintf(sc->name, sizeof(sc->name), "%s-%dg-%s", generated ? "generated" : "builtin",
+                         guards[g], logging ? "logging" : "quiet");
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief delete the log files in the current directory and the directory itself
+ *
+ * @param[in] dir scratch directory the child is in
+ */
+static void suite_remove_logs(const char* dir) {
+    DIR* handle = opendir(".");
+    if (handle) {
+        struct dirent* entry;
+        while ((entry = readdir(handle)) != NULL) {
+            if (strncmp(entry->d_name, "log_", 4) == 0) {
+                unlink(entry->d_name);
+            }
+        }
+        closedir(handle);
+    }
+    if (chdir("/") == 0) {
+        rmdir(dir);
+    }
+}
+
+/**
+ * @brief run one scenario in a forked child and send the result to the parent
+ *
+ * the museum is built here rather than in the parent, so the child's peak
+ * RSS covers everything the scenario allocates. logging scenarios write
+ * their CSV files to a scratch directory that is removed afterwards
+ *
+ * @param[in] sc scenario to run
+ * @param[in] minSeconds minimum simulated wall time
+ * @param[in] fd write end of the result pipe
+ */
+static void suite_child(const struct SuiteScenario* sc, double minSeconds, int fd) {
+    unsigned long long start = stats_now_ns();
+    struct SuiteResult result;
+    memset(&result, 0, sizeof(result));
+    // glibc gives threads extra malloc arenas depending on who contended
+    // first, which makes peak RSS jump between identical runs
+    mallopt(M_ARENA_MAX, 1);
+    bench_wall_limit = 1.0 + 2.0 * minSeconds;
+
+    struct Layout layout;
+    if (sc->generated) {
+        struct LayoutGenOptions gen;
+        char error[256];
+        layout_gen_defaults(&gen);
+        if (!layout_gen_parse(SUITE_GENERATED, &gen, error, sizeof(error)) || !layout_generate(&layout, &gen)) {
+            _exit(1);
+        }
+        bench_layout = &layout;
+    } else {
+        bench_layout = NULL;
+    }
+
+    char dir[] = "/tmp/heist-bench-XXXXXX";
+    if (sc->logging) {
+        if (!mkdtemp(dir) || chdir(dir) != 0 || !freopen("/dev/null", "w", stdout)) {
+            _exit(1);
+        }
+    }
+    log_set_enabled(sc->logging);
+
+    struct SimResult total;
+    int solves;
+    result.runs = bench_config(sc->guards, minSeconds, SUITE_SEED, &total, &solves);
+    result.turns = total.turns;
+    result.simSeconds = total.seconds;
+    result.p50 = latency_hist_percentile(&total.turnLatency, 50.0);
+    result.p99 = latency_hist_percentile(&total.turnLatency, 99.0);
+
+    if (sc->logging) {
+        suite_remove_logs(dir);
+    }
+    if (sc->generated) {
+        layout_free(&layout);
+    }
+    result.wallSeconds = (double)(stats_now_ns() - start) / 1e9;
+
+    ssize_t written = write(fd, &result, sizeof(result));
+    _exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+}
+
+/**
+ * @brief fork a child for one scenario and collect its result and peak RSS
+ *
+ * @param[in] sc scenario to run
+ * @param[in] minSeconds minimum simulated wall time
+ * @param[out] result what the child reported, with peakRssKb from wait4
+ *
+ * @return false if the child could not run or did not finish cleanly
+ */
+static bool suite_run(const struct SuiteScenario* sc, double minSeconds, struct SuiteResult* result) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        suite_child(sc, minSeconds, fds[1]);
+    }
+
+    // the result is smaller than PIPE_BUF, so it arrives in one piece or not at all
+    close(fds[1]);
+    ssize_t got = read(fds[0], result, sizeof(*result));
+    close(fds[0]);
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        return false;
+    }
+    result->peakRssKb = usage.ru_maxrss;
+    return got == (ssize_t)sizeof(*result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief middle value of SUITE_REPEATS numbers, reordering them
+ * @param[in,out] values numbers to pick from
+ * @return the median
+ */
+static double suite_median(double* values) {
+    for (int i = 1; i < SUITE_REPEATS; i++) {
+        for (int j = i; j > 0 && values[j - 1] > values[j]; j--) {
+            double swap = values[j];
+            values[j] = values[j - 1];
+            values[j - 1] = swap;
+        }
+    }
+    return values[SUITE_REPEATS / 2];
+}
+
+/**
+ * @brief run one scenario SUITE_REPEATS times and keep the median of each metric
+ *
+ * one child's throughput, tail latency and peak RSS move with the thread
+ * schedule and with how far the guards happened to walk, so a single child
+ * is too noisy to gate on. the runs and turns reported are those of the
+ * child with the median throughput
+ *
+ * @param[in] sc scenario to run
+ * @param[in] minSeconds minimum simulated wall time per child
+ * @param[out] result median result
+ *
+ * @return false if any child failed
+ */
+static bool suite_run_median(const struct SuiteScenario* sc, double minSeconds, struct SuiteResult* result) {
+    struct SuiteResult repeats[SUITE_REPEATS];
+    double turnsPerSec[SUITE_REPEATS], sorted[SUITE_REPEATS], p50[SUITE_REPEATS], p99[SUITE_REPEATS], rss[SUITE_REPEATS];
+    for (int i = 0; i < SUITE_REPEATS; i++) {
+        if (!suite_run(sc, minSeconds, &repeats[i])) {
+            return false;
+        }
+        struct SuiteResult* r = &repeats[i];
+        turnsPerSec[i] = r->simSeconds > 0 ? (double)r->turns / r->simSeconds : 0.0;
+        sorted[i] = turnsPerSec[i];
+        p50[i] = (double)r->p50;
+        p99[i] = (double)r->p99;
+        rss[i] = (double)r->peakRssKb;
+    }
+
+    double medianTurns = suite_median(sorted);
+    for (int i = 0; i < SUITE_REPEATS; i++) {
+        if (turnsPerSec[i] == medianTurns) {
+            *result = repeats[i];
+        }
+    }
+    result->p50 = (unsigned long long)suite_median(p50);
+    result->p99 = (unsigned long long)suite_median(p99);
+    result->peakRssKb = (long)suite_median(rss);
+    return true;
+}
+
+/**
+ * @brief find a number in one line of suite JSON
+ *
+ * only reads the format suite_write_json produces, one scenario per line
+ *
+ * @param[in] line text of the line
+ * @param[in] key field name without quotes
+ * @param[out] value parsed number
+ *
+ * @return false when the line has no such field
+ */
+static bool suite_json_number(const char* line, const char* key, double* value) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char* at = strstr(line, pattern);
+    if (!at) {
+        return false;
+    }
+    char* end;
+    *value = strtod(at + strlen(pattern), &end);
+    return end != at + strlen(pattern);
+}
+
+/**
+ * @brief look up one scenario's numbers in a baseline file
+ *
+ * @param[in] path baseline JSON written by an earlier --json
+ * @param[in] name scenario name
+ * @param[out] turnsPerSec baseline throughput
+ * @param[out] p99 baseline p99 turn latency
+ * @param[out] rssKb baseline peak RSS
+ *
+ * @return false when the file has no complete entry for the scenario
+ */
+static bool suite_baseline(const char* path, const char* name, double* turnsPerSec, double* p99, double* rssKb) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    char pattern[80];
+    snprintf(pattern, sizeof(pattern), "\"name\": \"%.60s\"", name);
+    char line[1024];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), file)) {
+        found = strstr(line, pattern) && suite_json_number(line, "turns_per_sec", turnsPerSec) &&
+                suite_json_number(line, "p99_ns", p99) && suite_json_number(line, "peak_rss_kb", rssKb);
+    }
+    fclose(file);
+    return found;
+}
+
+/**
+ * @brief write suite results as JSON, one scenario object per line
+ *
+ * @param[in] path output file, "-" for stdout
+ * @param[in] scenarios scenarios that ran
+ * @param[in] results their results
+ * @param[in] count number of scenarios
+ * @param[in] minSeconds minimum simulated wall time per scenario
+ *
+ * @return false if the file could not be written
+ */
+static bool suite_write_json(const char* path, const struct SuiteScenario* scenarios, const struct SuiteResult* results,
+                             int count, double minSeconds) {
+    FILE* file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "{\n  \"lock\": \"%s\",\n  \"min_seconds\": %.3f,\n  \"seed\": %u,\n  \"generated\": \"%s\",\n",
+            lock_backend_to_string(lock_backend_get()), minSeconds, SUITE_SEED, SUITE_GENERATED);
+    fprintf(file, "  \"scenarios\": [\n");
+    for (int i = 0; i < count; i++) {
+        const struct SuiteResult* r = &results[i];
+        fprintf(file,
+                "    {\"name\": \"%s\", \"layout\": \"%s\", \"guards\": %d, \"logging\": %s, \"runs\": %d, "
+                "\"turns\": %lu, \"turns_per_sec\": %.1f, \"wall_seconds\": %.3f, \"peak_rss_kb\": %ld, "
+                "\"p50_ns\": %llu, \"p99_ns\": %llu}%s\n",
+                scenarios[i].name, scenarios[i].generated ? "generated" : "builtin", scenarios[i].guards,
+                scenarios[i].logging ? "true" : "false", r->runs, r->turns,
+                r->simSeconds > 0 ? (double)r->turns / r->simSeconds : 0.0, r->wallSeconds, r->peakRssKb,
+                r->p50, r->p99, i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    bool ok = !ferror(file);
+    if (file != stdout) {
+        ok = fclose(file) == 0 && ok;
+    }
+    return ok;
+}
+
+/**
+ * @brief run the fixed benchmark suite and compare it against a baseline
+ *
+ * each scenario runs SUITE_REPEATS times, every time in its own child
+ * process so its peak RSS can be read with wait4, and the medians are
+ * compared. throughput that drops, or p99 latency or peak RSS that grows,
+ * by more than tolerance percent against the baseline is a regression;
+ * peak RSS must also grow by more than SUITE_RSS_SLACK_KB
+ *
+ * @param[in] minSeconds minimum simulated wall time per scenario
+ * @param[in] full also run the slow logging scenarios
+ * @param[in] jsonPath where to write the results, NULL for nowhere
+ * @param[in] baselinePath results to compare against, NULL to skip; must exist when given
+ * @param[in] tolerance allowed change in percent
+ *
+ * @return 0 when every scenario ran and none regressed, 1 otherwise or when the baseline is missing
+ */
+static int bench_suite(double minSeconds, bool full, const char* jsonPath, const char* baselinePath, double tolerance) {
+    struct SuiteScenario all[SUITE_MAX_SCENARIOS];
+    struct SuiteScenario scenarios[SUITE_MAX_SCENARIOS];
+    struct SuiteResult results[SUITE_MAX_SCENARIOS];
+    int allCount = suite_scenarios(all);
+    int count = 0;
+    for (int i = 0; i < allCount; i++) {
+        if (full || !all[i].slow) {
+            scenarios[count++] = all[i];
+        }
+    }
+
+    // a gate with nothing to compare against would pass every run, so refuse before spending minutes
+    bool haveBaseline = baselinePath != NULL;
+    if (haveBaseline && access(baselinePath, R_OK) != 0) {
+        fprintf(stderr, "No baseline at %s. Record one on this machine with \"make bench-baseline\" "
+                        "(or run without --baseline).\n", baselinePath);
+        return 1;
+    }
+
+    printf("%-24s %5s %12s %9s %9s %10s %10s", "scenario", "runs", "turns/s", "wall(s)", "rss(MB)", "p50(ns)",
+           "p99(ns)");
+    if (haveBaseline) {
+        printf(" %9s %9s %9s", "turns/s", "p99", "rss");
+    }
+    printf("\n");
+
+    int failures = 0;
+    int regressions = 0;
+    for (int i = 0; i < count; i++) {
+        struct SuiteResult* r = &results[i];
+        if (!suite_run_median(&scenarios[i], minSeconds, r)) {
+            memset(r, 0, sizeof(*r));
+            printf("%-24s failed\n", scenarios[i].name);
+            failures++;
+            continue;
+        }
+
+        double turnsPerSec = r->simSeconds > 0 ? (double)r->turns / r->simSeconds : 0.0;
+        printf("%-24s %5d %12.0f %9.3f %9.1f %10llu %10llu", scenarios[i].name, r->runs, turnsPerSec,
+               r->wallSeconds, (double)r->peakRssKb / 1024.0, r->p50, r->p99);
+
+        double baseTurns, baseP99, baseRss;
+        if (haveBaseline && suite_baseline(baselinePath, scenarios[i].name, &baseTurns, &baseP99, &baseRss)) {
+            // changes are signed so that positive always means worse
+            double turnsChange = baseTurns > 0 ? 100.0 * (baseTurns - turnsPerSec) / baseTurns : 0.0;
+            double p99Change = baseP99 > 0 ? 100.0 * ((double)r->p99 - baseP99) / baseP99 : 0.0;
+            double rssChange = baseRss > 0 ? 100.0 * ((double)r->peakRssKb - baseRss) / baseRss : 0.0;
+            printf(" %+8.1f%% %+8.1f%% %+8.1f%%", -turnsChange, p99Change, rssChange);
+            bool rssWorse = rssChange > tolerance && (double)r->peakRssKb - baseRss > SUITE_RSS_SLACK_KB;
+            if (turnsChange > tolerance || p99Change > tolerance || rssWorse) {
+                printf("  REGRESSION");
+                regressions++;
+            }
+        } else if (haveBaseline) {
+            printf(" %9s %9s %9s", "new", "new", "new");
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    if (jsonPath && !suite_write_json(jsonPath, scenarios, results, count, minSeconds)) {
+        fprintf(stderr, "Could not write %s\n", jsonPath);
+        failures++;
+    }
+
+    if (haveBaseline) {
+        printf("%d of %d scenarios regressed by more than %.0f%%\n", regressions, count, tolerance);
+    }
+    return failures > 0 || regressions > 0 ? 1 : 0;
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--locks a,b,...] [--guards n,m,...] [--min-time SECONDS] [--counters] [--room-cap N] [--generate SPEC]\n"
+            "          [--engine threads|sharded] [--workers K] [--pin CPUS] [--thieves N]\n"
+            "          [--strategies a,b,... [--runs N]] [--ignore-congestion] [--catalogue FILE] [--seed N]\n"
+            "       %s --compact-rooms N [--generate SPEC]\n"
+            "       %s --suite [--full] [--json FILE] [--baseline FILE] [--tolerance PCT] [--min-time SECONDS]\n"
+            "  --locks   backends to compare (default sem,pthread,ticket,futex,mcs)\n"
+            "  --guards  guard counts to run (default 1,8,64,256)\n"
+            "  --min-time  wall time spent per configuration (default 0.25)\n"
+            "  --counters  add LLC and L1D miss counts per turn (needs a PMU)\n"
+            "  --room-cap  soft limit on guards per room (default unlimited)\n"
+            "  --generate  run on a generated museum, e.g. shape=wings,rooms=5000,seed=3\n"
+            "  --engine  threads (default) or sharded region workers\n"
+            "  --workers  regions for the sharded engine (default one per CPU)\n"
+            "  --pin  pin threads to CPUS (e.g. 0-7 or all) and report cross-node room locks per turn\n"
+            "  --thieves  thieves let loose in every run (default 1)\n"
+            "  --strategies  compare exploration strategies (random,lrv,frontier,pursuit) on turns and\n"
+            "             lock acquisitions per solve instead of comparing locks\n"
+            "  --ignore-congestion  choose rooms without looking at occupancy or lock waits\n"
+            "  --runs  minimum runs per strategy and guard count (default 50)\n"
+            "  --seed  run i of every row seeds its random streams with N + i (default %u, 0 for the clock)\n"
+            "  --catalogue  evidence types and thief profiles to run with instead of the built-in set\n"
+            "  --compact-rooms  generate, build and traverse an N-room compact museum instead\n"
+            "  --suite  run the fixed seeded scenarios (1 to 10k guards, built-in and generated museum,\n"
+            "           logging on and off), each in its own process for peak RSS\n"
+            "  --full  include the logging scenarios with 1k and 10k guards, which take minutes\n"
+            "  --json  write the suite results to FILE as JSON (\"-\" for stdout)\n"
+            "  --baseline  compare against an earlier --json file and exit 1 on a regression or when FILE is missing\n"
+            "  --tolerance  percent turns/s may drop, or p99 and peak RSS may grow, before it counts (default %.0f)\n",
+            prog, prog, prog, BENCH_SEED, SUITE_TOLERANCE);
+}
+
+int main(int argc, char* argv[]) {
+    enum LockBackend backends[LOCK_BACKEND_COUNT];
+    int backendCount = 0;
+    int guardCounts[BENCH_MAX_GUARD_COUNTS] = { 1, 8, 64, 256 };
+    int guardCountLen = 4;
+    double minSeconds = 0.25;
+    bool counters = false;
+    uint32_t compactRooms = 0;
+    const char* generateSpec = NULL;
+    enum GuardStrategy strategies[STRATEGY_COUNT];
+    int strategyCount = 0;
+    int minRuns = 50;
+    bool suite = false;
+    bool suiteFull = false;
+    const char* jsonPath = NULL;
+    const char* baselinePath = NULL;
+    double tolerance = SUITE_TOLERANCE;
+
+    for (int i = 0; i < LOCK_BACKEND_COUNT; i++) {
+        backends[backendCount++] = (enum LockBackend)i;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--locks") == 0 && i + 1 < argc) {
+            backendCount = 0;
+            char* list = argv[++i];
+            for (char* tok = strtok(list, ","); tok && backendCount < LOCK_BACKEND_COUNT; tok = strtok(NULL, ",")) {
+                if (!lock_backend_from_string(tok, &backends[backendCount])) {
+                    fprintf(stderr, "Unknown lock backend: %s\n", tok);
+                    return 1;
+                }
+                backendCount++;
+            }
+        } else if (strcmp(argv[i], "--guards") == 0 && i + 1 < argc) {
+            guardCountLen = 0;
+            char* list = argv[++i];
+            for (char* tok = strtok(list, ","); tok && guardCountLen < BENCH_MAX_GUARD_COUNTS; tok = strtok(NULL, ",")) {
+                guardCounts[guardCountLen++] = atoi(tok);
+            }
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minSeconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--counters") == 0) {
+            counters = true;
+        } else if (strcmp(argv[i], "--room-cap") == 0 && i + 1 < argc) {
+            room_set_guard_cap(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            const char* engine = argv[++i];
+            if (strcmp(engine, "threads") == 0) {
+                bench_options.engine = ENGINE_THREADS;
+            } else if (strcmp(engine, "sharded") == 0) {
+                bench_options.engine = ENGINE_SHARDED;
+            } else {
+                fprintf(stderr, "Unknown engine: %s\n", engine);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            bench_options.workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pin") == 0 && i + 1 < argc) {
+            char error[128];
+            if (!affinity_parse(argv[++i], error, sizeof(error))) {
+                fprintf(stderr, "Invalid --pin: %s\n", error);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--thieves") == 0 && i + 1 < argc) {
+            bench_thieves = atoi(argv[++i]);
+            if (bench_thieves < 1) {
+                bench_thieves = 1;
+            }
+        } else if (strcmp(argv[i], "--strategies") == 0 && i + 1 < argc) {
+            strategyCount = 0;
+            char* list = argv[++i];
+            for (char* tok = strtok(list, ","); tok && strategyCount < STRATEGY_COUNT; tok = strtok(NULL, ",")) {
+                if (!strategy_from_string(tok, &strategies[strategyCount])) {
+                    fprintf(stderr, "Unknown strategy: %s\n", tok);
+                    return 1;
+                }
+                strategyCount++;
+            }
+        } else if (strcmp(argv[i], "--ignore-congestion") == 0) {
+            strategy_set_congestion_aware(false);
+        } else if (strcmp(argv[i], "--catalogue") == 0 && i + 1 < argc) {
+            char error[512];
+            if (!catalogue_load(argv[++i], error, sizeof(error))) {
+                fprintf(stderr, "Invalid catalogue: %s\n", error);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            bench_seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            minRuns = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--compact-rooms") == 0 && i + 1 < argc) {
+            compactRooms = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+            generateSpec = argv[++i];
+        } else if (strcmp(argv[i], "--suite") == 0) {
+            suite = true;
+        } else if (strcmp(argv[i], "--full") == 0) {
+            suiteFull = true;
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    struct LayoutGenOptions gen;
+    layout_gen_defaults(&gen);
+    char error[256];
+    if (generateSpec && !layout_gen_parse(generateSpec, &gen, error, sizeof(error))) {
+        fprintf(stderr, "Invalid generator spec: %s\n", error);
+        return 1;
+    }
+    if (gen.threads <= 0) {
+        gen.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    if (compactRooms > 0) {
+        gen.rooms = compactRooms;
+        return bench_compact(&gen);
+    }
+
+    if (suite) {
+        lock_backend_set(backends[0]);
+        return bench_suite(minSeconds, suiteFull, jsonPath, baselinePath, tolerance);
+    }
+
+    struct Layout layout;
+    if (generateSpec) {
+        if (!layout_generate(&layout, &gen)) {
+            fprintf(stderr, "Could not generate a %u room %s museum\n", gen.rooms, layout_shape_to_string(gen.shape));
+            return 1;
+        }
+        bench_layout = &layout;
+        printf("%s museum, %u rooms, %zu doors\n", layout_shape_to_string(gen.shape),
+               layout_room_count(&layout), layout.doorCount);
+    }
+
+    log_set_enabled(false);
+    if (bench_seed != 0) {
+        printf("seed %u: run i of every row uses seed %u + i\n", bench_seed, bench_seed);
+    } else {
+        printf("unseeded: every run draws clock-based streams\n");
+    }
+
+    if (strategyCount > 0) {
+        lock_backend_set(backends[0]);
+        bench_strategies(strategies, strategyCount, guardCounts, guardCountLen, minSeconds, minRuns);
+        if (bench_layout) {
+            layout_free(&layout);
+        }
+        return 0;
+    }
+
+    printf("%-8s %7s %5s %12s %10s %10s %10s %12s %12s %12s",
+           "backend", "guards", "runs", "turns/s", "p50(ns)", "p99(ns)", "p99.9(ns)", "locks/turn",
+           "waitns/turn", "aborts/turn");
+    if (counters) {
+        printf(" %12s %12s", "llc-miss/t", "l1d-miss/t");
+    }
+    if (affinity_enabled()) {
+        printf(" %12s", "xnode/turn");
+    }
+    printf("\n");
+
+    for (int b = 0; b < backendCount; b++) {
+        lock_backend_set(backends[b]);
+
+        for (int g = 0; g < guardCountLen; g++) {
+            struct SimResult total;
+            struct HwCounters hw;
+            unsigned long long misses[HW_COUNTER_COUNT] = { 0 };
+            bool haveCounters = counters && hw_counters_start(&hw);
+
+            int solves;
+            int runs = bench_config(guardCounts[g], minSeconds, bench_seed, &total, &solves);
+
+            if (haveCounters) {
+                hw_counters_stop(&hw, misses);
+            }
+
+            double turnsPerSec = total.seconds > 0 ? (double)total.turns / total.seconds : 0.0;
+            double locksPerTurn = total.turns > 0 ? (double)total.lockOps / (double)total.turns : 0.0;
+
+            printf("%-8s %7d %5d %12.0f %10llu %10llu %10llu %12.2f %12.1f %12.4f",
+                   lock_backend_to_string(backends[b]),
+                   guardCounts[g],
+                   runs,
+                   turnsPerSec,
+                   latency_hist_percentile(&total.turnLatency, 50.0),
+                   latency_hist_percentile(&total.turnLatency, 99.0),
+                   latency_hist_percentile(&total.turnLatency, 99.9),
+                   locksPerTurn,
+                   total.turns > 0 ? (double)total.lockWaitNs / (double)total.turns : 0.0,
+                   total.turns > 0 ? (double)total.moveAborts / (double)total.turns : 0.0);
+            if (counters && haveCounters && total.turns > 0) {
+                printf(" %12.1f %12.1f",
+                       (double)misses[HW_CACHE_MISSES] / (double)total.turns,
+                       (double)misses[HW_L1D_MISSES] / (double)total.turns);
+            } else if (counters) {
+                printf(" %12s %12s", "n/a", "n/a");
+            }
+            if (affinity_enabled()) {
+                printf(" %12.3f", total.turns > 0 ? (double)total.crossNode / (double)total.turns : 0.0);
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+
+    if (bench_layout) {
+        layout_free(&layout);
+    }
+    return 0;
+}
@@ -0,0 +1,410 @@
+#include "catalogue.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#define CATALOGUE_LINE_MAX 4096
+
+// Profiles consistent with one evidence mask
+struct CandidateEntry {
+    EvidenceMask mask;
+    uint32_t count;    // 0 marks an empty slot
+    uint32_t profile;  // Last profile counted; the only one when count is 1
+};
+
+struct Catalogue {
+    int typeCount;
+    char typeNames[CATALOGUE_MAX_TYPES][CATALOGUE_MAX_NAME];
+    int profileCount;
+    int profileCap;
+    char (*profileNames)[CATALOGUE_MAX_NAME];
+    EvidenceMask* profileMasks;
+    struct CandidateEntry* table;   // Open addressing over every non-empty subset of every profile
+    size_t tableMask;               // Table size minus one, a power of two minus one
+    int tableShift;                 // 64 minus log2 of the table size
+};
+
+// The museum's original seven devices and twelve thieves, in the bit and
+// list order the simulation has always used
+static const char* const builtin_catalogue[] = {
+    "evidence camera_blackout",
+    "evidence forced_lock",
+    "evidence glass_vibration",
+    "evidence rfid_spoof",
+    "evidence motion_trigger",
+    "evidence laser_trip",
+    "evidence tool_marks",
+    "profile insider rfid_spoof camera_blackout forced_lock",
+    "profile smash_and_grab glass_vibration motion_trigger tool_marks",
+    "profile tech_specialist camera_blackout laser_trip rfid_spoof",
+    "profile lockpicker forced_lock tool_marks laser_trip",
+    "profile acrobat laser_trip motion_trigger camera_blackout",
+    "profile vandal glass_vibration tool_marks camera_blackout",
+    "profile con_artist rfid_spoof motion_trigger glass_vibration",
+    "profile pro forced_lock rfid_spoof tool_marks",
+    "profile opportunist motion_trigger forced_lock glass_vibration",
+    "profile night_crawler camera_blackout motion_trigger rfid_spoof",
+    "profile cutter tool_marks glass_vibration laser_trip",
+    "profile ghost_entry camera_blackout laser_trip tool_marks",
+};
+
+static struct Catalogue active;
+static bool active_ready = false;
+
+/**
+ * @brief release everything a catalogue owns
+ *
+ * @param[in,out] cat catalogue to empty
+ */
+static void catalogue_free(struct Catalogue* cat){
+    free(cat->profileNames);
+    free(cat->profileMasks);
+    free(cat->table);
+    memset(cat, 0, sizeof(*cat));
+}
+
+/**
+ * @brief slot a mask hashes to
+ *
+ * @param[in] cat catalogue with a table
+ * @param[in] mask evidence mask
+ *
+ * @return first slot to probe
+ */
+static size_t table_slot(const struct Catalogue* cat, EvidenceMask mask){
+    return (size_t)((mask * 0x9E3779B97F4A7C15ULL) >> cat->tableShift) & cat->tableMask;
+}
+
+/**
+ * @brief find a mask's entry in the candidate table
+ *
+ * @param[in] cat catalogue with a table
+ * @param[in] mask non-zero evidence mask
+ *
+ * @return the entry, or the empty slot where it would go
+ */
+static struct CandidateEntry* table_find(const struct Catalogue* cat, EvidenceMask mask){
+    size_t slot = table_slot(cat, mask);
+    while (cat->table[slot].count != 0 && cat->table[slot].mask != mask){
+        slot = (slot + 1) & cat->tableMask;
+    }
+    return &cat->table[slot];
+}
+
+/**
+ * @brief count every non-empty subset of every profile into the table
+ *
+ * @param[in,out] cat catalogue with all profiles declared
+ * @param[out] error message on failure
+ * @param[in] errorSize size of error
+ *
+ * @return false when the table would be too large or memory ran out
+ */
+static bool build_table(struct Catalogue* cat, char* error, size_t errorSize){
+    size_t entries = 0;
+    for (int p = 0; p < cat->profileCount; p++){
+        entries += ((size_t)1 << __builtin_popcountll(cat->profileMasks[p])) - 1;
+        if (entries > CATALOGUE_MAX_ENTRIES){
+            snprintf(error, errorSize, "profiles have more than %u evidence subsets between them", CATALOGUE_MAX_ENTRIES);
+            return false;
+        }
+    }
+
+    // at most half full keeps linear probing short
+    int bits = 4;
+    while (((size_t)1 << bits) < entries * 2){
+        bits++;
+    }
+    cat->table = calloc((size_t)1 << bits, sizeof(struct CandidateEntry));
+    if (!cat->table){
+        snprintf(error, errorSize, "out of memory for %zu candidate entries", entries);
+        return false;
+    }
+    cat->tableMask = ((size_t)1 << bits) - 1;
+    cat->tableShift = 64 - bits;
+
+    for (int p = 0; p < cat->profileCount; p++){
+        EvidenceMask full = cat->profileMasks[p];
+        // walks every subset of full from full itself down to the lowest bit
+        for (EvidenceMask sub = full; sub != 0; sub = (sub - 1) & full){
+            struct CandidateEntry* entry = table_find(cat, sub);
+            entry->mask = sub;
+            entry->count++;
+            entry->profile = (uint32_t)p;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief index of a declared evidence type
+ *
+ * @param[in] cat catalogue being read
+ * @param[in] name type name
+ *
+ * @return type index, -1 if no type has that name
+ */
+static int find_type(const struct Catalogue* cat, const char* name){
+    for (int t = 0; t < cat->typeCount; t++){
+        if (strcmp(cat->typeNames[t], name) == 0){
+            return t;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief apply one catalogue line
+ *
+ * @param[in,out] cat catalogue being read
+ * @param[in,out] line text of the line, split in place
+ * @param[out] error message for a bad line
+ * @param[in] errorSize size of error
+ *
+ * @return false if the line is malformed
+ */
+static bool load_line(struct Catalogue* cat, char* line, char* error, size_t errorSize){
+    char* save = NULL;
+    char* word = strtok_r(line, " \t\r", &save);
+    if (!word || word[0] == '#'){
+        return true;
+    }
+
+    bool isEvidence = strcmp(word, "evidence") == 0;
+    if (!isEvidence && strcmp(word, "profile") != 0){
+        snprintf(error, errorSize, "unknown statement \"%s\"", word);
+        return false;
+    }
+
+    char* name = strtok_r(NULL, " \t\r", &save);
+    if (!name){
+        snprintf(error, errorSize, "\"%s\" needs a name", word);
+        return false;
+    }
+    if (strlen(name) >= CATALOGUE_MAX_NAME){
+        snprintf(error, errorSize, "name \"%s\" is longer than %d characters", name, CATALOGUE_MAX_NAME - 1);
+        return false;
+    }
+
+    if (isEvidence){
+        if (find_type(cat, name) >= 0){
+            snprintf(error, errorSize, "evidence \"%s\" declared twice", name);
+            return false;
+        }
+        if (cat->typeCount == CATALOGUE_MAX_TYPES){
+            snprintf(error, errorSize, "more than %d evidence types", CATALOGUE_MAX_TYPES);
+            return false;
+        }
+        strcpy(cat->typeNames[cat->typeCount++], name);
+        return true;
+    }
+
+    EvidenceMask mask = 0;
+    for (char* type = strtok_r(NULL, " \t\r", &save); type && type[0] != '#'; type = strtok_r(NULL, " \t\r", &save)){
+        int t = find_type(cat, type);
+        if (t < 0){
+            snprintf(error, errorSize, "profile \"%s\" uses undeclared evidence \"%s\"", name, type);
+            return false;
+        }
+        mask |= (EvidenceMask)1 << t;
+    }
+    if (mask == 0){
+        snprintf(error, errorSize, "profile \"%s\" leaves no evidence", name);
+        return false;
+    }
+    if (__builtin_popcountll(mask) > CATALOGUE_MAX_PROFILE_TYPES){
+        snprintf(error, errorSize, "profile \"%s\" has more than %d evidence types", name, CATALOGUE_MAX_PROFILE_TYPES);
+        return false;
+    }
+
+    if (cat->profileCount == cat->profileCap){
+        int cap = cat->profileCap ? cat->profileCap * 2 : 16;
+        void* names = realloc(cat->profileNames, (size_t)cap * sizeof(*cat->profileNames));
+        if (names){
+            cat->profileNames = names;
+        }
+        void* masks = realloc(cat->profileMasks, (size_t)cap * sizeof(*cat->profileMasks));
+        if (masks){
+            cat->profileMasks = masks;
+        }
+        if (!names || !masks){
+            snprintf(error, errorSize, "out of memory for %d profiles", cap);
+            return false;
+        }
+        cat->profileCap = cap;
+    }
+    strcpy(cat->profileNames[cat->profileCount], name);
+    cat->profileMasks[cat->profileCount] = mask;
+    cat->profileCount++;
+    return true;
+}
+
+/**
+ * @brief build the candidate table and check every profile can be identified
+ *
+ * @param[in,out] cat fully read catalogue
+ * @param[out] error message naming the offending profiles
+ * @param[in] errorSize size of error
+ *
+ * @return false for an empty catalogue, an oversized table or a profile
+ * hidden inside another
+ */
+static bool finish(struct Catalogue* cat, char* error, size_t errorSize){
+    if (cat->typeCount == 0 || cat->profileCount == 0){
+        snprintf(error, errorSize, "needs at least one evidence type and one profile");
+        return false;
+    }
+    if (!build_table(cat, error, errorSize)){
+        return false;
+    }
+
+    for (int p = 0; p < cat->profileCount; p++){
+        if (table_find(cat, cat->profileMasks[p])->count == 1){
+            continue;
+        }
+        for (int q = 0; q < cat->profileCount; q++){
+            if (q != p && (cat->profileMasks[p] & cat->profileMasks[q]) == cat->profileMasks[p]){
+                snprintf(error, errorSize, "profile \"%s\" is contained in \"%s\" and could never be told apart",
+                         cat->profileNames[p], cat->profileNames[q]);
+                break;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief make a catalogue the active one, freeing the previous
+ *
+ * @param[in] cat catalogue to install, moved from
+ */
+static void install(struct Catalogue* cat){
+    if (active_ready){
+        catalogue_free(&active);
+    }
+    active = *cat;
+    active_ready = true;
+}
+
+bool catalogue_load(const char* path, char* error, size_t errorSize){
+    FILE* file = fopen(path, "r");
+    if (!file){
+        snprintf(error, errorSize, "%s: cannot open", path);
+        return false;
+    }
+
+    struct Catalogue cat;
+    memset(&cat, 0, sizeof(cat));
+    char line[CATALOGUE_LINE_MAX];
+    char message[256];
+    int lineNo = 0;
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), file)){
+        lineNo++;
+        char* newL = strchr(line, '\n');
+        if (newL){
+            *newL = '\0';
+        } else if (!feof(file)){
+            snprintf(message, sizeof(message), "line longer than %d characters", CATALOGUE_LINE_MAX - 2);
+            ok = false;
+            break;
+        }
+        ok = load_line(&cat, line, message, sizeof(message));
+    }
+    fclose(file);
+
+    if (!ok){
+        snprintf(error, errorSize, "%s:%d: %s", path, lineNo, message);
+    } else if (!finish(&cat, message, sizeof(message))){
+        snprintf(error, errorSize, "%s: %s", path, message);
+        ok = false;
+    }
+
+    if (!ok){
+        catalogue_free(&cat);
+        return false;
+    }
+    install(&cat);
+    return true;
+}
+
+void catalogue_ensure(void){
+    if (active_ready){
+        return;
+    }
+
+    struct Catalogue cat;
+    memset(&cat, 0, sizeof(cat));
+    char line[CATALOGUE_LINE_MAX];
+    char error[256];
+    for (size_t i = 0; i < sizeof(builtin_catalogue) / sizeof(builtin_catalogue[0]); i++){
+        strcpy(line, builtin_catalogue[i]);
+        if (!load_line(&cat, line, error, sizeof(error))){
+            break;
+        }
+    }
+    // the built-in lines are known to be valid
+    finish(&cat, error, sizeof(error));
+    install(&cat);
+}
+
+int catalogue_type_count(void){
+    catalogue_ensure();
+    return active.typeCount;
+}
+
+int catalogue_profile_count(void){
+    catalogue_ensure();
+    return active.profileCount;
+}
+
+const char* catalogue_type_name(EvidenceMask evidence){
+    catalogue_ensure();
+    if (evidence == 0 || (evidence & (evidence - 1)) != 0){
+        return "unknown";
+    }
+    int type = __builtin_ctzll(evidence);
+    return type < active.typeCount ? active.typeNames[type] : "unknown";
+}
+
+const char* catalogue_profile_name(int profile){
+    catalogue_ensure();
+    return profile >= 0 && profile < active.profileCount ? active.profileNames[profile] : "unknown";
+}
+
+EvidenceMask catalogue_profile_mask(int profile){
+    catalogue_ensure();
+    return profile >= 0 && profile < active.profileCount ? active.profileMasks[profile] : 0;
+}
+
+int catalogue_candidates(EvidenceMask found, int* only){
+    if (found == 0){
+        if (only && active.profileCount == 1){
+            *only = 0;
+        }
+        return active.profileCount;
+    }
+
+    struct CandidateEntry* entry = table_find(&active, found);
+    if (only && entry->count == 1){
+        *only = (int)entry->profile;
+    }
+    return (int)entry->count;
+}
+
+EvidenceMask evidence_nth_bit(EvidenceMask mask, int n){
+#ifdef __BMI2__
+    return _pdep_u64((EvidenceMask)1 << n, mask);
+#else
+    for (int i = 0; i < n && mask; i++){
+        mask &= mask - 1;
+    }
+    return mask & (~mask + 1);
+#endif
+}
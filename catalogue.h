@@ -0,0 +1,93 @@
+#ifndef CATALOGUE_H
+#define CATALOGUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CATALOGUE_MAX_TYPES 64          // One bit of an EvidenceMask each
+#define CATALOGUE_MAX_NAME 32
+#define CATALOGUE_MAX_PROFILE_TYPES 16  // Evidence per profile; each profile adds 2^size table entries
+#define CATALOGUE_MAX_ENTRIES (1u << 24) // Cap on candidate table entries summed over every profile
+
+typedef uint64_t EvidenceMask; // Bit t stands for evidence type t of the active catalogue
+
+/**
+ * @brief Replace the active catalogue with one read from a file.
+ *
+ * Lines are "evidence NAME" to declare the next type and
+ * "profile NAME TYPE TYPE ..." to declare a thief profile leaving those
+ * types. '#' starts a comment. Every profile must be identifiable by its
+ * full evidence, so no profile may be contained in another. Must be
+ * called before the museum is built.
+ *
+ * @param[in] path File to read.
+ * @param[out] error Message with the file and line of a problem.
+ * @param[in] errorSize Size of error.
+ * @return false if the file could not be read or is invalid; the active catalogue is kept.
+ */
+bool catalogue_load(const char* path, char* error, size_t errorSize);
+
+/**
+ * @brief Make sure a catalogue is active, installing the built-in one if none was loaded.
+ */
+void catalogue_ensure(void);
+
+/**
+ * @brief Number of evidence types in the active catalogue.
+ * @return Type count, at most CATALOGUE_MAX_TYPES.
+ */
+int catalogue_type_count(void);
+
+/**
+ * @brief Number of thief profiles in the active catalogue.
+ * @return Profile count.
+ */
+int catalogue_profile_count(void);
+
+/**
+ * @brief Name of one evidence type.
+ * @param[in] evidence A single evidence bit.
+ * @return Static name, "unknown" for a bit the catalogue does not define.
+ */
+const char* catalogue_type_name(EvidenceMask evidence);
+
+/**
+ * @brief Name of one thief profile.
+ * @param[in] profile Profile index.
+ * @return Name, "unknown" when out of range.
+ */
+const char* catalogue_profile_name(int profile);
+
+/**
+ * @brief Evidence a profile leaves.
+ * @param[in] profile Profile index.
+ * @return Mask of the profile's types, 0 when out of range.
+ */
+EvidenceMask catalogue_profile_mask(int profile);
+
+/**
+ * @brief Count the profiles consistent with the evidence found so far.
+ *
+ * One lookup in a hash table holding every subset of every profile, built
+ * when the catalogue is installed, so the cost does not grow with the
+ * number of profiles.
+ *
+ * @param[in] found Evidence collected for one thief.
+ * @param[out] only Set to the profile when exactly one fits; may be NULL.
+ * @return Number of profiles whose evidence includes all of found.
+ */
+int catalogue_candidates(EvidenceMask found, int* only);
+
+/**
+ * @brief Select the n-th lowest set bit of a mask.
+ *
+ * Uses pdep when built for BMI2, otherwise clears the n lower bits one by one.
+ *
+ * @param[in] mask Mask to pick from.
+ * @param[in] n Index below the popcount of mask.
+ * @return The selected bit alone, 0 if mask has no n-th bit.
+ */
+EvidenceMask evidence_nth_bit(EvidenceMask mask, int n);
+
+#endif // CATALOGUE_H
@@ -0,0 +1,253 @@
+#include "compact.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief FNV-1a hash of a string
+ *
+ * @param[in] text string to hash
+ *
+ * @return 32-bit hash
+ */
+static uint32_t strtab_hash(const char* text){
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++){
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void strtab_init(struct StringTable* table){
+    memset(table, 0, sizeof(*table));
+}
+
+void strtab_free(struct StringTable* table){
+    free(table->data);
+    free(table->offsets);
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+/**
+ * @brief double the hash index and reinsert every id
+ *
+ * @param[in,out] table string table
+ *
+ * @return false if memory ran out
+ */
+static bool strtab_grow_slots(struct StringTable* table){
+    uint32_t newCap = table->slotCap ? table->slotCap * 2 : 64;
+    uint32_t* slots = calloc(newCap, sizeof(uint32_t));
+    if (!slots){
+        return false;
+    }
+
+    for (uint32_t id = 0; id < table->count; id++){
+        uint32_t slot = strtab_hash(table->data + table->offsets[id]) & (newCap - 1);
+        while (slots[slot]){
+            slot = (slot + 1) & (newCap - 1);
+        }
+        slots[slot] = id + 1;
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->slotCap = newCap;
+    return true;
+}
+
+uint32_t strtab_intern(struct StringTable* table, const char* text){
+    // keep the index at most half full
+    if ((table->count + 1) * 2 > table->slotCap && !strtab_grow_slots(table)){
+        return UINT32_MAX;
+    }
+
+    uint32_t slot = strtab_hash(text) & (table->slotCap - 1);
+    while (table->slots[slot]){
+        uint32_t id = table->slots[slot] - 1;
+        if (strcmp(table->data + table->offsets[id], text) == 0){
+            return id;
+        }
+        slot = (slot + 1) & (table->slotCap - 1);
+    }
+
+    size_t len = strlen(text) + 1;
+    if (table->used + len > table->cap){
+        size_t newCap = table->cap ? table->cap * 2 : 256;
+        while (newCap < table->used + len){
+            newCap *= 2;
+        }
+        char* data = realloc(table->data, newCap);
+        if (!data){
+            return UINT32_MAX;
+        }
+        table->data = data;
+        table->cap = newCap;
+    }
+
+    if (table->count >= table->offsetCap){
+        uint32_t newCap = table->offsetCap ? table->offsetCap * 2 : 16;
+        uint32_t* offsets = realloc(table->offsets, newCap * sizeof(uint32_t));
+        if (!offsets){
+            return UINT32_MAX;
+        }
+        table->offsets = offsets;
+        table->offsetCap = newCap;
+    }
+
+    uint32_t id = table->count++;
+    table->offsets[id] = (uint32_t)table->used;
+    memcpy(table->data + table->used, text, len);
+    table->used += len;
+    table->slots[slot] = id + 1;
+    return id;
+}
+
+const char* strtab_get(const struct StringTable* table, uint32_t id){
+    if (id >= table->count){
+        return "";
+    }
+    return table->data + table->offsets[id];
+}
+
+/**
+ * @brief build CSR adjacency from an edge list
+ *
+ * one pass counts degrees, a prefix sum turns them into row offsets and a
+ * second pass drops every edge into both of its rows
+ *
+ * @param[out] museum compact museum to fill
+ * @param[in] roomCount number of rooms
+ * @param[in] edges undirected edges as index pairs
+ * @param[in] edgeCount number of edges
+ * @param[in] exitRoom index of the exit room
+ *
+ * @return false on bad input or allocation failure
+ */
+bool compact_build(struct CompactMuseum* museum, uint32_t roomCount,
+                   const uint32_t (*edges)[2], size_t edgeCount, uint32_t exitRoom){
+    memset(museum, 0, sizeof(*museum));
+    strtab_init(&museum->names);
+
+    if (roomCount == 0 || exitRoom >= roomCount || edgeCount * 2 >= UINT32_MAX){
+        return false;
+    }
+
+    museum->roomCount = roomCount;
+    museum->exitRoom = exitRoom;
+    museum->offsets = calloc((size_t)roomCount + 1, sizeof(uint32_t));
+    museum->neighbours = malloc(edgeCount * 2 * sizeof(uint32_t) + 1);
+    museum->nameIds = calloc(roomCount, sizeof(uint32_t));
+    museum->nameNumbers = calloc(roomCount, sizeof(uint32_t));
+    museum->guards = calloc(roomCount, sizeof(*museum->guards));
+    museum->thieves = calloc(roomCount, sizeof(*museum->thieves));
+    museum->evidence = calloc(roomCount, sizeof(*museum->evidence));
+
+    if (!museum->offsets || !museum->neighbours || !museum->nameIds || !museum->nameNumbers ||
+        !museum->guards || !museum->thieves || !museum->evidence){
+        compact_free(museum);
+        return false;
+    }
+
+    for (size_t e = 0; e < edgeCount; e++){
+        if (edges[e][0] >= roomCount || edges[e][1] >= roomCount){
+            compact_free(museum);
+            return false;
+        }
+        museum->offsets[edges[e][0] + 1]++;
+        museum->offsets[edges[e][1] + 1]++;
+    }
+
+    for (uint32_t r = 0; r < roomCount; r++){
+        museum->offsets[r + 1] += museum->offsets[r];
+    }
+
+    // offsets[r] doubles as the fill cursor for row r, then gets shifted back
+    for (size_t e = 0; e < edgeCount; e++){
+        uint32_t a = edges[e][0];
+        uint32_t b = edges[e][1];
+        museum->neighbours[museum->offsets[a]++] = b;
+        museum->neighbours[museum->offsets[b]++] = a;
+    }
+    for (uint32_t r = roomCount; r > 0; r--){
+        museum->offsets[r] = museum->offsets[r - 1];
+    }
+    museum->offsets[0] = 0;
+
+    return true;
+}
+
+void compact_free(struct CompactMuseum* museum){
+    free(museum->offsets);
+    free(museum->neighbours);
+    free(museum->nameIds);
+    free(museum->nameNumbers);
+    free(museum->guards);
+    free(museum->thieves);
+    free(museum->evidence);
+    strtab_free(&museum->names);
+    memset(museum, 0, sizeof(*museum));
+}
+
+void compact_set_name(struct CompactMuseum* museum, uint32_t room, const char* base, uint32_t number){
+    museum->nameIds[room] = strtab_intern(&museum->names, base);
+    museum->nameNumbers[room] = number;
+}
+
+const char* compact_room_name(const struct CompactMuseum* museum, uint32_t room, char* buffer, size_t size){
+    const char* base = strtab_get(&museum->names, museum->nameIds[room]);
+    if (museum->nameNumbers[room]){
+        snprintf(buffer, size, "%s %u", base, museum->nameNumbers[room]);
+    } else {
+        snprintf(buffer, size, "%s", base);
+    }
+    return buffer;
+}
+
+uint32_t compact_degree(const struct CompactMuseum* museum, uint32_t room){
+    return museum->offsets[room + 1] - museum->offsets[room];
+}
+
+size_t compact_memory_bytes(const struct CompactMuseum* museum){
+    size_t rooms = museum->roomCount;
+    size_t doors = rooms ? museum->offsets[rooms] : 0;
+
+    return (rooms + 1) * sizeof(uint32_t)              // offsets
+         + doors * sizeof(uint32_t)                    // neighbours
+         + rooms * 2 * sizeof(uint32_t)                // nameIds, nameNumbers
+         + rooms * (sizeof(*museum->guards) + sizeof(*museum->thieves) + sizeof(*museum->evidence))
+         + museum->names.cap
+         + museum->names.offsetCap * sizeof(uint32_t)
+         + museum->names.slotCap * sizeof(uint32_t);
+}
+
+uint32_t compact_bfs(const struct CompactMuseum* museum, uint32_t source, uint32_t* dist){
+    uint32_t* queue = malloc((size_t)museum->roomCount * sizeof(uint32_t));
+    if (!queue){
+        return 0;
+    }
+
+    for (uint32_t r = 0; r < museum->roomCount; r++){
+        dist[r] = UINT32_MAX;
+    }
+
+    uint32_t head = 0, tail = 0;
+    dist[source] = 0;
+    queue[tail++] = source;
+
+    while (head < tail){
+        uint32_t room = queue[head++];
+        for (uint32_t i = museum->offsets[room]; i < museum->offsets[room + 1]; i++){
+            uint32_t next = museum->neighbours[i];
+            if (dist[next] == UINT32_MAX){
+                dist[next] = dist[room] + 1;
+                queue[tail++] = next;
+            }
+        }
+    }
+
+    free(queue);
+    return tail;
+}
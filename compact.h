@@ -0,0 +1,129 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define COMPACT_NO_ROOM UINT32_MAX
+
+// Interned strings: every distinct string is stored once and referred to by id.
+struct StringTable {
+    char* data;          // NUL-terminated strings back to back
+    size_t used;
+    size_t cap;
+    uint32_t* offsets;   // Start of each string in data, indexed by id
+    uint32_t count;
+    uint32_t offsetCap;
+    uint32_t* slots;     // Open-addressing hash of id + 1, 0 marks an empty slot
+    uint32_t slotCap;
+};
+
+// Index-based museum for very large generated buildings. Rooms are plain
+// 32-bit indices, adjacency is stored in CSR form and names are interned, so
+// a room costs a few dozen bytes instead of a full struct Room.
+struct CompactMuseum {
+    uint32_t roomCount;
+    uint32_t exitRoom;
+    uint32_t* offsets;       // roomCount + 1 entries; room r's doors are neighbours[offsets[r] .. offsets[r+1])
+    uint32_t* neighbours;    // Every door listed from both sides
+    uint32_t* nameIds;       // Interned base name of each room
+    uint32_t* nameNumbers;   // Appended to the base name when non-zero ("Gallery 17")
+    struct StringTable names;
+    // Occupancy lives in parallel arrays rather than in a room record
+    _Atomic uint32_t* guards;
+    _Atomic uint8_t* thieves;
+    _Atomic uint8_t* evidence;
+};
+
+/**
+ * @brief Initialize an empty string table.
+ * @param[out] table Table to initialize.
+ */
+void strtab_init(struct StringTable* table);
+
+/**
+ * @brief Free every string held by a table.
+ * @param[in,out] table Table to release.
+ */
+void strtab_free(struct StringTable* table);
+
+/**
+ * @brief Return the id of a string, adding it on first use.
+ * @param[in,out] table Table to search.
+ * @param[in] text String to intern.
+ * @return Stable id of the string.
+ */
+uint32_t strtab_intern(struct StringTable* table, const char* text);
+
+/**
+ * @brief Look up an interned string.
+ * @param[in] table Table holding the string.
+ * @param[in] id Id returned by strtab_intern.
+ * @return The stored string; valid until the next strtab_intern call.
+ */
+const char* strtab_get(const struct StringTable* table, uint32_t id);
+
+/**
+ * @brief Build the CSR adjacency of a compact museum from an undirected edge list.
+ * @param[out] museum Museum to build; names start out empty.
+ * @param[in] roomCount Number of rooms.
+ * @param[in] edges Pairs of room indices, edgeCount pairs in total.
+ * @param[in] edgeCount Number of edges.
+ * @param[in] exitRoom Index of the exit room.
+ * @return false when memory ran out or an edge is out of range.
+ */
+bool compact_build(struct CompactMuseum* museum, uint32_t roomCount,
+                   const uint32_t (*edges)[2], size_t edgeCount, uint32_t exitRoom);
+
+/**
+ * @brief Free everything owned by a compact museum.
+ * @param[in,out] museum Museum to release.
+ */
+void compact_free(struct CompactMuseum* museum);
+
+/**
+ * @brief Give a room a name made of an interned base and an optional number.
+ * @param[in,out] museum Museum holding the room.
+ * @param[in] room Room index.
+ * @param[in] base Base name, interned once however many rooms share it.
+ * @param[in] number Suffix number, 0 for none.
+ */
+void compact_set_name(struct CompactMuseum* museum, uint32_t room, const char* base, uint32_t number);
+
+/**
+ * @brief Format a room's display name.
+ * @param[in] museum Museum holding the room.
+ * @param[in] room Room index.
+ * @param[out] buffer Destination.
+ * @param[in] size Size of buffer.
+ * @return buffer.
+ */
+const char* compact_room_name(const struct CompactMuseum* museum, uint32_t room, char* buffer, size_t size);
+
+/**
+ * @brief Number of doors of a room.
+ * @param[in] museum Museum holding the room.
+ * @param[in] room Room index.
+ * @return Degree of the room.
+ */
+uint32_t compact_degree(const struct CompactMuseum* museum, uint32_t room);
+
+/**
+ * @brief Bytes of heap memory used by a compact museum.
+ * @param[in] museum Museum to measure.
+ * @return Total size of every array it owns.
+ */
+size_t compact_memory_bytes(const struct CompactMuseum* museum);
+
+/**
+ * @brief Breadth-first distances from one room.
+ * @param[in] museum Museum to search.
+ * @param[in] source Start room.
+ * @param[out] dist roomCount entries, UINT32_MAX for unreachable rooms.
+ * @return Number of rooms reached.
+ */
+uint32_t compact_bfs(const struct CompactMuseum* museum, uint32_t source, uint32_t* dist);
+
+#endif // COMPACT_H
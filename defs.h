@@ -2,19 +2,29 @@
 #define DEFS_H
 
 #include <stdbool.h>
-#include <semaphore.h>
+#include <stdint.h>
+#include "lock.h"
+#include "stats.h"
+#include "layout.h"
+#include "shm.h"
+#include "affinity.h"
+#include "catalogue.h"
 #include <pthread.h>
 
-#define MAX_ROOM_NAME 64
+#define MAX_ROOM_NAME LAYOUT_MAX_NAME
 #define MAX_GUARD_NAME 64
-#define MAX_ROOMS 24
-#define MAX_ROOM_OCCUPANCY 8
-#define MAX_CONNECTIONS 8
+#define ROOM_INITIAL_SLOTS 4
+#define GUARD_MOVE_PROBES 4        // Doors a guard tries while looking for a room its device has not scanned
+#define ROOM_WAIT_PER_GUARD_NS 1000 // Average lock wait that counts as much congestion as one more guard
+#define STRATEGY_SAMPLE 8          // Doors or rooms a strategy looks at per move, so hub rooms stay cheap
+#define RECENT_DROPS 8             // Rooms of the latest evidence drops the casefile remembers for pursuit
 #define ENTITY_BOREDOM_MAX 15
 #define GUARD_STRESS_MAX 15
-#define DEFAULT_THIEF_ID 68057
-
-typedef unsigned char EvidenceByte; // Just giving a helpful name to unsigned char for evidence bitmasks
+#define DEFAULT_THIEF_ID 68057     // First thief's id; later thieves count up from it
+#define EVIDENCE_TYPES CATALOGUE_MAX_TYPES // Slots in per-type arrays; the active catalogue uses the first catalogue_type_count()
+#define CACHE_LINE 64
+#define ROUTE_ALL_PAIRS_MAX 1024   // Museums up to this size get a full next-hop table
+#define ROUTE_NONE UINT16_MAX
 
 enum LogReason {
     LR_CLUES = 0,        // Collected enough unique clue types
@@ -23,76 +33,101 @@ enum LogReason {
 };
 
 
-enum TamperType {
-    TP_CAMERA_BLACKOUT = 1 << 0,
-    TP_FORCED_LOCK     = 1 << 1,
-    TP_GLASS_VIBRATION = 1 << 2,
-    TP_RFID_SPOOF      = 1 << 3,
-    TP_MOTION_TRIGGER  = 1 << 4,
-    TP_LASER_TRIP      = 1 << 5,
-    TP_TOOL_MARKS      = 1 << 6,
+struct CaseFile {
+    _Atomic EvidenceMask collected; // Union of all of the evidence bits collected between all guards, only grows via fetch-or
+    atomic_bool          solved;    // Latched once every thief's case has one candidate left, derived from the fetch-or results
+    _Atomic EvidenceMask* cases;    // Evidence attributed to each thief, by thief index; NULL until thieves are added
+    int caseCount;
+    atomic_int solvedCases;         // Cases narrowed down to a single candidate profile
+    atomic_int holders[EVIDENCE_TYPES]; // Active guards carrying each device, by bit index
+    _Atomic(struct Room*) recentDrops[RECENT_DROPS]; // Ring of the rooms thieves dropped evidence in last
+    atomic_uint dropCursor;         // Drops recorded so far; the next one goes to dropCursor % RECENT_DROPS
 };
 
-enum ThiefProfile {
-    TH_INSIDER        = TP_RFID_SPOOF      | TP_CAMERA_BLACKOUT | TP_FORCED_LOCK,
-    TH_SMASH_AND_GRAB = TP_GLASS_VIBRATION | TP_MOTION_TRIGGER  | TP_TOOL_MARKS,
-    TH_TECH_SPECIALIST= TP_CAMERA_BLACKOUT | TP_LASER_TRIP      | TP_RFID_SPOOF,
-    TH_LOCKPICKER     = TP_FORCED_LOCK     | TP_TOOL_MARKS      | TP_LASER_TRIP,
-    TH_ACROBAT        = TP_LASER_TRIP      | TP_MOTION_TRIGGER  | TP_CAMERA_BLACKOUT,
-    TH_VANDAL         = TP_GLASS_VIBRATION | TP_TOOL_MARKS      | TP_CAMERA_BLACKOUT,
-    TH_CON_ARTIST     = TP_RFID_SPOOF      | TP_MOTION_TRIGGER  | TP_GLASS_VIBRATION,
-    TH_PRO            = TP_FORCED_LOCK     | TP_RFID_SPOOF      | TP_TOOL_MARKS,
-    TH_OPPORTUNIST    = TP_MOTION_TRIGGER  | TP_FORCED_LOCK     | TP_GLASS_VIBRATION,
-    TH_NIGHT_CRAWLER  = TP_CAMERA_BLACKOUT | TP_MOTION_TRIGGER | TP_RFID_SPOOF,
-    TH_CUTTER         = TP_TOOL_MARKS      | TP_GLASS_VIBRATION | TP_LASER_TRIP,
-    TH_GHOST_ENTRY    = TP_CAMERA_BLACKOUT | TP_LASER_TRIP | TP_TOOL_MARKS
-};
 
-struct CaseFile {
-    EvidenceByte collected; // Union of all of the evidence bits collected between all guards
-    bool         solved;    // True when >=3 unique bits set
-    sem_t        mutex;     // Used for synchronizing both fields when multithreading
+// Guards listed in a room. It grows by copying into a larger array; the old
+// array stays on the retired chain until the museum is cleaned up, so a
+// reader scanning without the lock never touches freed memory.
+struct GuardSlots {
+	struct GuardSlots* retired;        // Smaller arrays this one replaced
+	int capacity;
+	_Atomic(struct Guard*) entries[];  // Written under the room lock, read by anyone
 };
 
-
+// Hot fields come first and start on their own cache line; the cold block is
+// aligned too, so a room's mutable state never shares a line with another
+// room's state or with the read-only names and adjacency.
 struct Room {
-	char name[MAX_ROOM_NAME];
-	struct Room* connectedRooms[MAX_CONNECTIONS];
+	// Hot: written by many threads while the simulation runs
+	_Alignas(CACHE_LINE) _Atomic uint64_t occupancy; // Guards in the low 32 bits, thieves in the high 32 bits
+	_Atomic EvidenceMask evidence;            // Set by fetch-or, collected by fetch-and
+	_Atomic EvidenceMask scanned;             // Devices that scanned the room since a thief last dropped evidence here
+	_Atomic uint64_t lastVisit;               // stats_now_ns when a least-recently-visited guard last entered the room
+	struct Lock mutex;
+	_Atomic(struct GuardSlots*) guardSlots;   // NULL until the first guard arrives, replaced under mutex
+	_Atomic int guardCount;                   // Entries used in guardSlots, written under mutex
+	int lastNode;                             // NUMA node of the last pinned thread to lock the room, written under mutex
+	_Atomic uint32_t waitNs;                  // Moving average of the wait for mutex, written under mutex
+	// Cold: fixed once the layout is built, read without the lock
+	_Alignas(CACHE_LINE) char name[MAX_ROOM_NAME];
+	struct Room** connectedRooms; // Slice of the museum's door array
 	int connections;
-	struct Thief* thief;
-	struct Guard* guards[MAX_ROOM_OCCUPANCY];
-	int guardCount;
+	int doorCapacity;             // Length of that slice, fixed when the museum is built
 	bool isExit;
-	EvidenceByte evidence;
-	sem_t mutex;
+	struct Room* toExit;   // Next hop on a shortest path to the exit, NULL in the exit itself
+	int exitDistance;      // Doors between this room and the exit, -1 if unreachable
+	int region;            // Worker owning the room under the sharded engine
+	_Atomic uint16_t* droppedBy; // Index of the thief that last dropped each evidence type here; the room's slice of Museum.drops
 };
 
  
 struct Thief {
-	int id;
-	enum ThiefProfile type;
+	_Alignas(CACHE_LINE) int id;
+	int index;                 // Position in museum->thieves and in the casefile's cases
+	int profile;               // Index into the active catalogue's profiles
 	struct Room* currentRoom;
+	struct CaseFile* casefile; // Where drops are recorded for guards pursuing them
 	int boredom;
 	bool active;
-	sem_t mutex;
+	unsigned long moveRetries; // Failed validations that were retried, owned by the thief thread
+	unsigned long moveAborts;  // Moves given up because guards walked in
+	unsigned randState;        // Random stream keyed by id, bound while the thief acts
 };
 
-struct RoomNode{
-	struct Room* room;
-	struct RoomNode* next;
+// Breadcrumb trail stored as indices into the museum's room array
+struct RoomStack {
+	struct Room* rooms;  // Base the indices refer to
+	uint32_t* items;
+	uint32_t size;
+	uint32_t capacity;   // Kept across returns so the trail is reused, never shrunk
 };
 
-struct RoomStack {
-	struct RoomNode* head;
+// Copy of the guard fields other threads may look at, see guard_read_snapshot
+struct GuardSnapshot {
+	int stress;
+	int boredom;
+	EvidenceMask device;
+	enum LogReason whyExit;
+	bool active;
+	bool returningToControl;
+	bool inControlRoom;
 };
 
 struct Guard{
-        char name[MAX_GUARD_NAME];
+        // Owned by the guard's thread: only that thread reads or writes these while it runs
+        _Alignas(CACHE_LINE) char name[MAX_GUARD_NAME];
         int id;
         struct Room* currentRoom;
+        int roomSlot;               // Index in currentRoom's guard slots; written under that room's lock
+        int region;                 // Region whose worker runs this guard, -1 under the threaded engine
+        int focus;                  // Thief whose case change_device tries to narrow down, taken modulo the case count
+        struct Room* handoffTo;     // Sharded engine: claimed room in another region, set instead of moving
+        struct Room* target;        // Frontier strategy: unscanned room being walked to, NULL when none
+        struct Museum* museum;      // Route tables and the room array for the exploration strategies
         struct CaseFile* casefile;
-        enum TamperType device;
+        EvidenceMask device;
         struct RoomStack breadcrumb;
+        unsigned randState;         // Random stream keyed by id, bound while the guard takes a turn
         int stress;
         int boredom;
         enum LogReason whyExit;
@@ -100,41 +135,143 @@ struct Guard{
 	bool inControlRoom;
 	bool returningToControl;
 	bool starting;
-	sem_t mutex;
+	unsigned long moveRetries; // Slot reservations that lost a race and were retried
+	unsigned long moveAborts;  // Moves given up because the target room was full
+	unsigned long returns;     // Completed trips back to the Security Office
+	unsigned long returnSteps; // Moves made while returning
+	unsigned long returnLocks; // Lock acquisitions made while returning
+	unsigned long solveTurns;  // Turns taken while some case was still unsolved
+	// Published once per turn with release ordering for everyone else, on its
+	// own line so monitor reads never pull the owner's working fields away
+	_Alignas(CACHE_LINE) _Atomic uint64_t snapshot;
 };
 
 
 struct Museum {
     struct Room* starting_room;
-    struct Room rooms[MAX_ROOMS];
+    struct Room* rooms;     // Cache-line aligned array sized from the layout
     int room_count;
-    struct Guard** guards;
+    struct Room** doors;    // Every room's neighbours back to back, each door listed from both sides
+    _Atomic uint16_t* drops; // catalogue_type_count() droppedBy slots per room, written as thieves drop evidence
+    uint16_t* routeNext;    // room_count^2 next-hop indices, [from * room_count + to]; NULL for large museums
+    uint16_t* routeDist;    // Matching shortest-path lengths, ROUTE_NONE when unreachable
+    struct Guard* guards;   // Cache-line aligned slab sized from the roster, never reallocated
     int guardCount;
     int guardMax;
-    struct CaseFile casefile;
-    struct Thief thief;
+    _Alignas(CACHE_LINE) struct CaseFile casefile; // Read by every guard, kept apart from the room array
+    struct Thief* thieves;  // Cache-line aligned slab, one entry per thief
+    int thiefCount;
 };
 
+// Key space of a random stream, so a guard and a thief with the same id never share one
+enum RandOwner {
+    RAND_THREAD = 0,                  // A thread drawing for no entity
+    RAND_GUARD = 1,
+    RAND_THIEF = 2
+};
 
+enum GuardStrategy {
+    STRATEGY_RANDOM = 0,              // Random door, preferring rooms the coverage map marks unscanned
+    STRATEGY_LRV = 1,                 // Least recently visited neighbour
+    STRATEGY_FRONTIER = 2,            // Nearest room this device has not scanned, by the route tables
+    STRATEGY_PURSUIT = 3,             // Towards recent drops, nearer ones more likely
+    STRATEGY_COUNT
+};
+
+enum SimEngine {
+    ENGINE_THREADS = 0,               // One thread per guard and per thief, rooms locked in pairs
+    ENGINE_SHARDED = 1                // Rooms partitioned into regions, one lock-free worker per region
+};
+
+struct SimOptions {
+    int monitorMs;                    // >0 prints a live summary built from guard snapshots at this interval
+    enum SimEngine engine;
+    int workers;                      // Sharded engine: number of regions, 0 for one per CPU
+    int processes;                    // >1 forks this many guard processes over a shared museum; needs shm_arena_create first
+};
+
+struct SimResult {
+    unsigned long turns;              // Guard turns taken across every guard
+    unsigned long thiefTurns;         // Turns taken by every thief
+    unsigned long lockOps;            // Lock acquisitions made by guard threads (thieves take none)
+    unsigned long moveRetries;        // Optimistic move validations retried by guards and thief
+    unsigned long moveAborts;         // Moves abandoned after validation failed
+    unsigned long returns;            // Completed trips back to the exit
+    unsigned long returnSteps;        // Moves spent returning
+    unsigned long returnLocks;        // Lock acquisitions spent returning
+    unsigned long solveTurns;         // Guard turns taken before every case was solved, all of them when it never was
+    bool solved;                      // Every case was solved by the end of the run
+    int regions;                      // Sharded engine: regions the museum was split into
+    unsigned long cutDoors;           // Sharded engine: doors joining two regions
+    double imbalance;                 // Sharded engine: largest region over the average size
+    unsigned long handoffs;           // Sharded engine: moves passed to another region's worker
+    unsigned long queueFull;          // Sharded engine: handoffs refused by a full queue
+    bool aborted;                     // Sharded engine: ran out of memory and stopped early
+    int processes;                    // Guard processes forked, 0 when everything ran in this process
+    int failedProcesses;              // Guard processes that crashed or exited with an error
+    unsigned long crossNode;          // Pinned threads: room locks (or sharded handoffs) that crossed NUMA nodes
+    unsigned long lockWaits;          // Room lock acquisitions that found the lock taken
+    unsigned long lockWaitNs;         // Time spent waiting in those acquisitions
+    double seconds;                   // Wall time from thread start to last join
+    struct LatencyHist turnLatency;   // Latency of individual guard turns
+};
+
+
+//casefile functions
+EvidenceMask casefile_add_evidence(struct CaseFile* file, int thief, EvidenceMask evidence);
+EvidenceMask casefile_collected(struct CaseFile* file);
+bool casefile_solved(struct CaseFile* file);
+EvidenceMask casefile_case(struct CaseFile* file, int thief);
+int casefile_solved_cases(struct CaseFile* file);
+int casefile_candidates(struct CaseFile* file, int thief);
+void casefile_swap_device(struct CaseFile* file, EvidenceMask from, EvidenceMask to);
+void casefile_note_drop(struct CaseFile* file, struct Room* room);
+struct Room* casefile_recent_drop(struct CaseFile* file, int slot);
+int casefile_holders(struct CaseFile* file, EvidenceMask device);
 //house functions
-void add_guard(struct Room* room, struct Guard* guard);
+bool add_guard(struct Room* room, struct Guard* guard);
 void remove_guard(struct Room* room, struct Guard* guard);
+int room_collect_guards(struct Room* room, struct Guard** out, int max);
+void room_free_slots(struct Room* room);
+void room_set_guard_cap(int cap);
+int room_get_guard_cap(void);
+int room_guard_count(struct Room* room);
+bool room_has_thief(struct Room* room);
+void room_guard_enter(struct Room* room);
+bool room_guard_reserve(struct Room* room, unsigned long* retries);
+void room_guard_leave(struct Room* room);
+void room_thief_enter(struct Room* room);
+bool room_thief_leave(struct Room* room, unsigned long* retries);
 void museum_init(struct Museum* museum);
 void museum_cleanup(struct Museum* museum);
+bool museum_build(struct Museum* museum, const struct Layout* layout);
+bool museum_reserve_guards(struct Museum* museum, int count);
 bool museum_add_guard(struct Museum* museum, const char* name, int id);
+bool museum_add_thieves(struct Museum* museum, int count);
+void museum_build_routes(struct Museum* museum);
+struct Room* museum_next_hop(struct Museum* museum, struct Room* from, struct Room* to);
+int museum_distance(struct Museum* museum, struct Room* from, struct Room* to);
 //ghost fucnitons
-void thief_init(struct Thief* thief, struct Museum* museum);
+void thief_init(struct Thief* thief, struct Museum* museum, int index);
 void thief_move(struct Thief* thief);
 void thief_haunt(struct Thief* thief);
 void thief_update(struct Thief* thief);
 //roomstack functions
-void roomstack_init(struct RoomStack* stack);
+void roomstack_init(struct RoomStack* stack, struct Room* rooms);
 void push(struct RoomStack* stack, struct Room* room);
 struct Room* pop(struct RoomStack* stack);
 void empty_roomstack(struct RoomStack* stack);
+void roomstack_free(struct RoomStack* stack);
 //room functions
 void room_init(struct Room* room, const char* name, bool isExit);
 void room_connect(struct Room* first, struct Room* second);
+void room_set_owned(bool owned);
+void room_lock(struct Room* room);
+void room_unlock(struct Room* room);
+unsigned long room_thread_cross_node(void);
+unsigned long room_thread_lock_waits(void);
+unsigned long room_thread_lock_wait_ns(void);
+int room_congestion(struct Room* room);
 void lock_rooms(struct Room* to, struct Room* from);
 void unlock_rooms(struct Room* to, struct Room* from);
 void in_control_room(struct Guard* guard);
@@ -145,6 +282,28 @@ void search_for_evidence(struct Guard* guard);
 bool consider_exiting(struct Guard* guard);
 void update_state(struct Guard* guard);
 
+void scan_for_clues(struct Guard* guard);
+void guard_take_turn(struct Guard* guard);
+void guard_publish(struct Guard* guard);
+void guard_read_snapshot(struct Guard* guard, struct GuardSnapshot* snap);
+
+void guard_depart(struct Guard* guard);
+void guard_arrive(struct Guard* guard, struct Room* from, struct Room* to);
+void guard_cancel_handoff(struct Guard* guard);
+
 void change_device(struct Guard* guard);
 void exit_to_control_room(struct Guard* guard);
+//strategy functions
+void strategy_set(enum GuardStrategy strategy);
+enum GuardStrategy strategy_get(void);
+bool strategy_from_string(const char* name, enum GuardStrategy* strategy);
+const char* strategy_to_string(enum GuardStrategy strategy);
+struct Room* strategy_next_room(struct Guard* guard);
+void strategy_note_arrival(struct Guard* guard, struct Room* room);
+void strategy_set_congestion_aware(bool aware);
+bool strategy_congestion_aware(void);
+//simulation functions
+void sim_run(struct Museum* museum, const struct SimOptions* options, struct SimResult* result);
+int museum_partition(struct Museum* museum, int regions, unsigned long* cutDoors, double* imbalance);
+void sim_run_sharded(struct Museum* museum, const struct SimOptions* options, struct SimResult* result);
 #endif // DEFS_H
@@ -0,0 +1,453 @@
+#include "layout.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define GEN_MAX_THREADS 64
+#define GEN_KINDS 4
+
+static const char* shape_names[SHAPE_COUNT] = { "grid", "wings", "small-world", "floors" };
+static const char* exit_names[EXIT_COUNT] = { "first", "center", "random" };
+static const char* room_kinds[GEN_KINDS] = { "Gallery", "Corridor", "Storage", "Office" };
+
+// Everything a worker needs to emit the doors and names of any room
+struct GenPlan {
+    const struct LayoutGenOptions* options;
+    uint32_t rooms;
+    uint32_t width;        // Grid row length (grid and every floor)
+    uint32_t floorSize;    // Rooms per floor
+    uint32_t exitRoom;
+    uint32_t exitName;     // Name id of "Security Office"
+    uint32_t kindNames[GEN_KINDS];
+    uint32_t stairName;
+    uint32_t wingName;
+};
+
+struct GenWorker {
+    struct GenPlan* plan;
+    struct Layout* layout;
+    uint32_t first;        // Rooms [first, last) belong to this worker
+    uint32_t last;
+    size_t doorCount;      // Pass 1 result
+    size_t doorStart;      // Pass 2 write position
+    pthread_t thread;
+};
+
+const char* layout_shape_to_string(enum LayoutShape shape){
+    return (shape >= 0 && shape < SHAPE_COUNT) ? shape_names[shape] : "unknown";
+}
+
+void layout_gen_defaults(struct LayoutGenOptions* options){
+    options->shape = SHAPE_GRID;
+    options->rooms = 1000;
+    options->seed = 1;
+    options->extraDoors = 0.0;
+    options->skew = 1;
+    options->branching = 3;
+    options->floors = 4;
+    options->stairwells = 2;
+    options->exit = EXIT_FIRST;
+    options->threads = 0;
+}
+
+bool layout_gen_parse(const char* spec, struct LayoutGenOptions* options, char* error, size_t errorSize){
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", spec);
+
+    for (char* tok = strtok(buffer, ","); tok; tok = strtok(NULL, ",")){
+        char* value = strchr(tok, '=');
+        if (!value){
+            snprintf(error, errorSize, "expected key=value, got \"%s\"", tok);
+            return false;
+        }
+        *value++ = '\0';
+
+        bool ok = true;
+        if (strcmp(tok, "shape") == 0){
+            ok = false;
+            for (int i = 0; i < SHAPE_COUNT; i++){
+                if (strcmp(value, shape_names[i]) == 0){
+                    options->shape = (enum LayoutShape)i;
+                    ok = true;
+                }
+            }
+        } else if (strcmp(tok, "exit") == 0){
+            ok = false;
+            for (int i = 0; i < EXIT_COUNT; i++){
+                if (strcmp(value, exit_names[i]) == 0){
+                    options->exit = (enum LayoutExit)i;
+                    ok = true;
+                }
+            }
+        } else if (strcmp(tok, "rooms") == 0){
+            options->rooms = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(tok, "seed") == 0){
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(tok, "extra") == 0){
+            options->extraDoors = atof(value);
+        } else if (strcmp(tok, "skew") == 0){
+            options->skew = atoi(value);
+        } else if (strcmp(tok, "branching") == 0){
+            options->branching = atoi(value);
+        } else if (strcmp(tok, "floors") == 0){
+            options->floors = atoi(value);
+        } else if (strcmp(tok, "stairwells") == 0){
+            options->stairwells = atoi(value);
+        } else if (strcmp(tok, "threads") == 0){
+            options->threads = atoi(value);
+        } else {
+            snprintf(error, errorSize, "unknown key \"%s\"", tok);
+            return false;
+        }
+
+        if (!ok){
+            snprintf(error, errorSize, "bad %s \"%s\"", tok, value);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief splitmix64 step, used as a counter-based generator
+ *
+ * @param[in] x input word
+ *
+ * @return well-mixed 64-bit value
+ */
+static uint64_t mix64(uint64_t x){
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief random word for one room and draw, independent of generation order
+ *
+ * @param[in] seed layout seed
+ * @param[in] room room index
+ * @param[in] draw draw number within that room
+ *
+ * @return 64 random bits
+ */
+static uint64_t room_random(uint64_t seed, uint32_t room, uint32_t draw){
+    return mix64(seed ^ mix64(((uint64_t)room << 8) | draw));
+}
+
+/**
+ * @brief uniform value in [0, 1) from 53 random bits
+ *
+ * @param[in] bits random word
+ *
+ * @return uniform double
+ */
+static double unit(uint64_t bits){
+    return (double)(bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief record one door, or only count it when doors is NULL
+ */
+static void emit(uint32_t (*doors)[2], size_t* count, uint32_t a, uint32_t b){
+    if (doors){
+        doors[*count][0] = a;
+        doors[*count][1] = b;
+    }
+    (*count)++;
+}
+
+/**
+ * @brief emit the doors a room owns
+ *
+ * every door is owned by exactly one of its rooms (the higher-numbered one
+ * for structural doors, the drawing room for extra doors), so workers never
+ * emit the same door twice and need no coordination
+ *
+ * @param[in] plan generation plan
+ * @param[in] r room index
+ * @param[out] doors destination, NULL to only count
+ * @param[in,out] count doors emitted so far
+ */
+static void room_doors(const struct GenPlan* plan, uint32_t r, uint32_t (*doors)[2], size_t* count){
+    const struct LayoutGenOptions* options = plan->options;
+    uint64_t seed = options->seed;
+    uint32_t n = plan->rooms;
+
+    switch (options->shape){
+        case SHAPE_GRID:
+            // left and upper neighbour: a row-major grid with a ragged last row stays connected
+            if (r % plan->width != 0){
+                emit(doors, count, r - 1, r);
+            }
+            if (r >= plan->width){
+                emit(doors, count, r - plan->width, r);
+            }
+            break;
+        case SHAPE_WINGS:
+            // parent drawn from [r / branching, r): depth stays logarithmic but wing sizes vary
+            if (r > 0){
+                uint32_t lo = (r - 1) / (uint32_t)options->branching;
+                uint32_t parent = lo + (uint32_t)(room_random(seed, r, 0) % (r - lo));
+                emit(doors, count, parent, r);
+            }
+            break;
+        case SHAPE_SMALL_WORLD:
+            if (r > 0){
+                emit(doors, count, r - 1, r);
+            }
+            if (r == n - 1 && n > 2){
+                emit(doors, count, 0, r);
+            }
+            break;
+        case SHAPE_FLOORS: {
+            uint32_t floor = r / plan->floorSize;
+            uint32_t local = r % plan->floorSize;
+            if (local % plan->width != 0){
+                emit(doors, count, r - 1, r);
+            }
+            if (local >= plan->width){
+                emit(doors, count, r - plan->width, r);
+            }
+            // stairwells sit at evenly spaced positions and lead to the same position one floor down;
+            // position 0 is always one of them, so every floor is reachable
+            if (floor > 0){
+                uint32_t spacing = plan->floorSize / (uint32_t)options->stairwells;
+                if (spacing == 0 || local % spacing == 0){
+                    emit(doors, count, r - plan->floorSize, r);
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    if (options->extraDoors <= 0.0 || n < 2){
+        return;
+    }
+
+    double extra = options->extraDoors;
+    int whole = (int)extra;
+    int draws = whole + (unit(room_random(seed, r, 1)) < extra - whole ? 1 : 0);
+    for (int d = 0; d < draws; d++){
+        double base = unit(room_random(seed, r, (uint32_t)(2 + d)));
+        double u = base;
+        for (int k = 1; k < options->skew; k++){
+            u *= base;
+        }
+        uint32_t other = (uint32_t)(u * n);
+        if (other >= n){
+            other = n - 1;
+        }
+        if (other != r){
+            emit(doors, count, r, other);
+        }
+    }
+}
+
+/**
+ * @brief base name and number of one generated room
+ *
+ * every room except the exit is named after its kind and numbered by its
+ * index, so names are unique while only a few strings are interned
+ *
+ * @param[in] plan generation plan
+ * @param[in] r room index
+ * @param[out] nameId base name id
+ * @param[out] number name suffix
+ */
+static void room_name(const struct GenPlan* plan, uint32_t r, uint32_t* nameId, uint32_t* number){
+    const struct LayoutGenOptions* options = plan->options;
+    *number = r;
+
+    if (r == plan->exitRoom){
+        *nameId = plan->exitName;
+        *number = 0;
+        return;
+    }
+
+    if (options->shape == SHAPE_WINGS && r <= (uint32_t)options->branching){
+        *nameId = plan->wingName;
+        return;
+    }
+    if (options->shape == SHAPE_FLOORS && plan->floorSize > 0){
+        uint32_t spacing = plan->floorSize / (uint32_t)options->stairwells;
+        uint32_t local = r % plan->floorSize;
+        if (spacing == 0 || local % spacing == 0){
+            *nameId = plan->stairName;
+            return;
+        }
+    }
+    *nameId = plan->kindNames[r % GEN_KINDS];
+}
+
+/**
+ * @brief pass 1: count the doors of a range of rooms
+ */
+static void* gen_count(void* arg){
+    struct GenWorker* worker = arg;
+    size_t count = 0;
+    for (uint32_t r = worker->first; r < worker->last; r++){
+        room_doors(worker->plan, r, NULL, &count);
+    }
+    worker->doorCount = count;
+    return NULL;
+}
+
+/**
+ * @brief pass 2: write the doors and names of a range of rooms
+ *
+ * each worker writes its own slice of the door array, starting where the
+ * prefix sum of pass 1 says its doors go
+ */
+static void* gen_fill(void* arg){
+    struct GenWorker* worker = arg;
+    struct Layout* layout = worker->layout;
+    uint32_t (*doors)[2] = layout->doors + worker->doorStart;
+    size_t count = 0;
+
+    for (uint32_t r = worker->first; r < worker->last; r++){
+        room_doors(worker->plan, r, doors, &count);
+        room_name(worker->plan, r, &layout->nameIds[r], &layout->nameNumbers[r]);
+    }
+    return NULL;
+}
+
+/**
+ * @brief run one pass on every worker, the first on the calling thread
+ *
+ * @param[in,out] workers worker ranges
+ * @param[in] count number of workers
+ * @param[in] pass pass function
+ */
+static void gen_run(struct GenWorker* workers, int count, void* (*pass)(void*)){
+    int started = 1;
+    for (int i = 1; i < count; i++){
+        if (pthread_create(&workers[i].thread, NULL, pass, &workers[i]) != 0){
+            break;
+        }
+        started++;
+    }
+    pass(&workers[0]);
+    for (int i = 1; i < started; i++){
+        pthread_join(workers[i].thread, NULL);
+    }
+    // any worker that could not get a thread runs here
+    for (int i = started; i < count; i++){
+        pass(&workers[i]);
+    }
+}
+
+/**
+ * @brief pick the exit room
+ *
+ * @param[in] plan generation plan with shape sizes filled in
+ *
+ * @return exit room index
+ */
+static uint32_t pick_exit(const struct GenPlan* plan){
+    const struct LayoutGenOptions* options = plan->options;
+    uint32_t n = plan->rooms;
+
+    switch (options->exit){
+        case EXIT_CENTER:
+            if (options->shape == SHAPE_GRID || options->shape == SHAPE_FLOORS){
+                uint32_t size = options->shape == SHAPE_GRID ? n : plan->floorSize;
+                uint32_t rows = (size + plan->width - 1) / plan->width;
+                uint32_t center = (rows / 2) * plan->width + plan->width / 2;
+                return center < n ? center : n / 2;
+            }
+            return n / 2;
+        case EXIT_RANDOM:
+            return (uint32_t)(mix64(options->seed ^ 0xE817ULL) % n);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief generate a layout in two parallel passes over room ranges
+ *
+ * doors are a pure function of the seed and room index, so pass 1 counts
+ * each range's doors, a prefix sum places every range in the door array and
+ * pass 2 writes doors and names straight into place
+ */
+bool layout_generate(struct Layout* layout, const struct LayoutGenOptions* options){
+    layout_init(layout);
+
+    uint32_t n = options->rooms;
+    if (n == 0 || options->branching < 1 || options->floors < 1 || options->stairwells < 1 ||
+        options->skew < 1 || options->extraDoors < 0.0 || options->extraDoors > LAYOUT_GEN_MAX_EXTRA){
+        return false;
+    }
+
+    struct GenPlan plan;
+    memset(&plan, 0, sizeof(plan));
+    plan.options = options;
+    plan.rooms = n;
+    plan.floorSize = n;
+    if (options->shape == SHAPE_FLOORS){
+        plan.floorSize = (n + (uint32_t)options->floors - 1) / (uint32_t)options->floors;
+    }
+    plan.width = 1;
+    while ((uint64_t)plan.width * plan.width < plan.floorSize){
+        plan.width++;
+    }
+    plan.exitRoom = pick_exit(&plan);
+
+    plan.exitName = layout_intern_name(layout, "Security Office");
+    plan.stairName = layout_intern_name(layout, "Stairwell");
+    plan.wingName = layout_intern_name(layout, "Wing Corridor");
+    bool interned = plan.exitName != LAYOUT_NO_ROOM && plan.stairName != LAYOUT_NO_ROOM &&
+                    plan.wingName != LAYOUT_NO_ROOM;
+    for (int k = 0; k < GEN_KINDS; k++){
+        plan.kindNames[k] = layout_intern_name(layout, room_kinds[k]);
+        interned = interned && plan.kindNames[k] != LAYOUT_NO_ROOM;
+    }
+    if (!interned){
+        layout_free(layout);
+        return false;
+    }
+
+    int threads = options->threads > 0 ? options->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1){
+        threads = 1;
+    }
+    if (threads > GEN_MAX_THREADS){
+        threads = GEN_MAX_THREADS;
+    }
+    if ((uint32_t)threads > n){
+        threads = (int)n;
+    }
+
+    struct GenWorker workers[GEN_MAX_THREADS];
+    for (int i = 0; i < threads; i++){
+        workers[i].plan = &plan;
+        workers[i].layout = layout;
+        workers[i].first = (uint32_t)((uint64_t)n * i / threads);
+        workers[i].last = (uint32_t)((uint64_t)n * (i + 1) / threads);
+    }
+
+    gen_run(workers, threads, gen_count);
+
+    size_t doors = 0;
+    for (int i = 0; i < threads; i++){
+        workers[i].doorStart = doors;
+        doors += workers[i].doorCount;
+    }
+
+    if (!layout_reserve(layout, n, doors + 1)){
+        layout_free(layout);
+        return false;
+    }
+
+    gen_run(workers, threads, gen_fill);
+
+    layout->roomCount = n;
+    layout->doorCount = doors;
+    layout->exitRoom = plan.exitRoom;
+    return true;
+}
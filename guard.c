@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 
 /**
  * @brief initialize guard and place them in the van
@@ -23,115 +24,170 @@ void guard_init(struct Guard* guard, struct Museum* museum, const char* name, in
     guard->id = id;
     guard->currentRoom = museum->starting_room;
 
-    const enum TamperType* evidence;
-    int evNum = get_all_tamper_types(&evidence);
-    guard->device = evidence[rand_int_threadsafe(0, evNum)];
+    rand_stream_init(&guard->randState, RAND_GUARD, (unsigned)id);
+    rand_bind(&guard->randState);
+    guard->device = (EvidenceMask)1 << rand_int_threadsafe(0, catalogue_type_count());
+    rand_bind(NULL);
 
+    guard->museum = museum;
+    guard->target = NULL;
     guard->casefile = &museum->casefile;
+    casefile_swap_device(guard->casefile, 0, guard->device);
     guard->stress = 0;
     guard->boredom = 0;
 
-    roomstack_init(&guard->breadcrumb);
+    roomstack_init(&guard->breadcrumb, museum->rooms);
 
     guard->active = true;
     guard->inControlRoom = true;
     guard->returningToControl = false;
     guard->starting = true;
     guard->whyExit = LR_CLUES;
-
-    sem_init(&guard->mutex, 0, 1);
-
-    sem_wait(&museum->starting_room->mutex);
+    guard->roomSlot = -1;
+    guard->region = -1;
+    guard->focus = (int)(guard - museum->guards);
+    guard->handoffTo = NULL;
+    guard->moveRetries = 0;
+    guard->moveAborts = 0;
+    guard->returns = 0;
+    guard->returnSteps = 0;
+    guard->returnLocks = 0;
+    guard->solveTurns = 0;
+
+    guard_publish(guard);
+
+    room_guard_enter(museum->starting_room);
+    lock_acquire(&museum->starting_room->mutex);
     add_guard(museum->starting_room, guard);
     log_guard_init(guard->id, museum->starting_room->name, guard->name, guard->device);
-    sem_post(&museum->starting_room->mutex);
+    lock_release(&museum->starting_room->mutex);
 }
 
 /**
- * @brief change guards device to a different type
+ * @brief change guards device to the one that tells the team the most
  *
- * select a new device that is neither identical to the current device nor
- * already collected within the casefile and log the swap
+ * looks at the candidate profiles left in the guard's focus case and scores
+ * every other device by how evenly finding it would split them, divided by
+ * one more than the number of guards already carrying it so the team
+ * spreads out. devices that split nothing fall back to the least carried
+ * one. each device costs one candidate table lookup, so the work grows with
+ * the catalogue's types but not with its profiles. the focus
+ * moves on to the next thief once its case is solved. logs the swap
  *
  * @param[in,out] guard pointer to the guard switching devices
  */
 void change_device(struct Guard* guard){
-    const enum TamperType* evidence;
-    int evNum = get_all_tamper_types(&evidence);
-
-    sem_wait(&guard->casefile->mutex);
-    EvidenceByte collected = guard->casefile->collected;
-    sem_post(&guard->casefile->mutex);
-
-    sem_wait(&guard->mutex);
-    enum TamperType curr = guard->device;
+    struct CaseFile* file = guard->casefile;
+    EvidenceMask curr = guard->device;
     int boredom = guard->boredom;
     int stress = guard->stress;
-    sem_post(&guard->mutex);
 
-    int ind = rand_int_threadsafe(0, evNum);
-
-    if (evNum > 1){
-        while (evidence[ind] == curr || (collected & evidence[ind]) != 0){
-            ind = rand_int_threadsafe(0, evNum);
+    EvidenceMask found = 0;
+    int total = 0;
+    if (file->caseCount > 0){
+        found = casefile_case(file, guard->focus % file->caseCount);
+        total = catalogue_candidates(found, NULL);
+        if (total <= 1){
+            guard->focus = (guard->focus + 1) % file->caseCount;
         }
     }
 
-    enum TamperType new = evidence[ind];
+    EvidenceMask new = curr;
+    long bestScore = LONG_MIN;
+    int ties = 0;
+    int types = catalogue_type_count();
+    for (int bit = 0; bit < types; bit++){
+        EvidenceMask device = (EvidenceMask)1 << bit;
+        if (device == curr){
+            continue;
+        }
 
-    sem_wait(&guard->mutex);
-    guard->device = new;
-    sem_post(&guard->mutex);
+        // candidates that would survive finding this device next
+        int with = total > 0 ? catalogue_candidates(found | device, NULL) : 0;
+        int split = with < total - with ? with : total - with;
+        int holders = casefile_holders(file, device);
+        long score = split > 0 ? ((long)split << 16) / (1 + holders) : -(long)holders;
+
+        // ties are broken uniformly so equal guards do not all pick the same device
+        if (score > bestScore){
+            bestScore = score;
+            new = device;
+            ties = 1;
+        } else if (score == bestScore && rand_int_threadsafe(0, ++ties) == 0){
+            new = device;
+        }
+    }
 
+    casefile_swap_device(file, curr, new);
+    guard->device = new;
     log_swap(guard->id, boredom, stress, curr, new);
 }
 
 /**
- * @brief move guard one step along breadcrumb path towards van
+ * @brief move guard one step along the shortest path towards van
  *
- * pop one room from the breadcrumb stack transfers the guard into that
- * room and log the movement
+ * follows the room's precomputed next hop to the exit, so the walk home
+ * skips any loops in the breadcrumb; the breadcrumb is only popped when no
+ * route exists. transfers the guard into that room and logs the movement
  *
  * @param[in,out] guard pointer to guard
  */
 void exit_to_control_room(struct Guard* guard){
     struct Room* thisRoom = guard->currentRoom;
-    struct Room* nextRoom = pop(&guard->breadcrumb);
+    struct Room* nextRoom = thisRoom->toExit;
+    if (!nextRoom){
+        nextRoom = pop(&guard->breadcrumb);
+    }
+    if (!nextRoom){
+        return;
+    }
+
+    unsigned long locksBefore = lock_thread_acquisitions();
+
+    room_guard_enter(nextRoom);
+    if (guard->region >= 0 && nextRoom->region != guard->region){
+        guard->handoffTo = nextRoom;
+        return;
+    }
 
     lock_rooms(thisRoom, nextRoom);
     remove_guard(thisRoom, guard);
     add_guard(nextRoom, guard);
+    room_guard_leave(thisRoom);
 
-    sem_wait(&guard->mutex);
     guard->currentRoom = nextRoom;
     guard->inControlRoom = nextRoom->isExit;
     int boredom = guard->boredom;
     int stress = guard->stress;
-    enum TamperType device = guard->device;
+    EvidenceMask device = guard->device;
     bool isExit = nextRoom->isExit;
-    sem_post(&guard->mutex);
 
     log_move(guard->id, boredom, stress, thisRoom->name, nextRoom->name, device);
     unlock_rooms(thisRoom, nextRoom);
 
+    guard->returnSteps++;
+    guard->returnLocks += lock_thread_acquisitions() - locksBefore;
+
     if (isExit){
     }
 }
 
 /**
- * @brief move guard to random connected room
+ * @brief move guard to a connected room
  *
  * if guard is currently returning to van, the function redirects to
- * exit_to_control_room(). otherwise select a random connected room, push the
- * current room onto the breadcrumb stack and log move.
+ * exit_to_control_room(). otherwise let the selected exploration strategy
+ * pick a connected room, claim a
+ * slot in it without any lock (the move is aborted if the room is at the
+ * --room-cap limit),
+ * push the current room onto the breadcrumb stack, tell the strategy the
+ * guard arrived and log move.
  *
  * @param[in,out] guard pointer to guard moving
 **/
 void guard_move(struct Guard* guard){
-    sem_wait(&guard->mutex);
     bool active = guard->active;
     bool returning = guard->returningToControl;
-    sem_post(&guard->mutex);
 
     if (!active){
         return;
@@ -142,91 +198,143 @@ void guard_move(struct Guard* guard){
     }
 
     struct Room* thisRoom = guard->currentRoom;
-    struct Room* nextRoom = NULL;
-
-    sem_wait(&thisRoom->mutex);
-    int connections = thisRoom->connections;
-    int toWhere = rand_int_threadsafe(0, connections);
-    nextRoom = thisRoom->connectedRooms[toWhere];
-    sem_post(&thisRoom->mutex);
+    struct Room* nextRoom = strategy_next_room(guard);
+    if (!nextRoom){
+        return;
+    }
 
-    lock_rooms(thisRoom, nextRoom);
+    if (!room_guard_reserve(nextRoom, &guard->moveRetries)){
+        guard->moveAborts++;
+        return;
+    }
 
-    if (nextRoom->guardCount >= MAX_ROOM_OCCUPANCY){
-        unlock_rooms(thisRoom, nextRoom);
+    // the slot is claimed; the worker owning the other region finishes the move
+    if (guard->region >= 0 && nextRoom->region != guard->region){
+        guard->handoffTo = nextRoom;
         return;
     }
 
+    lock_rooms(thisRoom, nextRoom);
+
     remove_guard(thisRoom, guard);
+    room_guard_leave(thisRoom);
 
-    sem_wait(&guard->mutex);
     bool shouldPush = !guard->returningToControl;
-    sem_post(&guard->mutex);
 
     if (shouldPush){
         push(&guard->breadcrumb, thisRoom);
     }
 
-    sem_wait(&guard->mutex);
     guard->currentRoom = nextRoom;
     guard->inControlRoom = nextRoom->isExit;
     int boredom = guard->boredom;
     int stress = guard->stress;
-    enum TamperType device = guard->device;
+    EvidenceMask device = guard->device;
     bool isExit = nextRoom->isExit;
-    sem_post(&guard->mutex);
 
     add_guard(nextRoom, guard);
+    strategy_note_arrival(guard, nextRoom);
 
     log_move(guard->id, boredom, stress, thisRoom->name, nextRoom->name, device);
     unlock_rooms(thisRoom, nextRoom);
 
     if (isExit){
-        sem_wait(&guard->mutex);
         guard->returningToControl = false;
-        sem_post(&guard->mutex);
     }
 }
 
+/**
+ * @brief first half of a move into another region: leave the current room
+ *
+ * run by the worker owning the current room once the handoff to
+ * guard->handoffTo has been queued; the slot in that room is already
+ * claimed. the breadcrumb is extended unless the guard is returning
+ *
+ * @param[in,out] guard pointer to guard with handoffTo set
+ */
+void guard_depart(struct Guard* guard){
+    struct Room* thisRoom = guard->currentRoom;
+
+    remove_guard(thisRoom, guard);
+    room_guard_leave(thisRoom);
+
+    if (!guard->returningToControl){
+        push(&guard->breadcrumb, thisRoom);
+    }
+    guard->handoffTo = NULL;
+}
+
+/**
+ * @brief second half of a move into another region: enter the new room
+ *
+ * run by the worker owning the new room when it takes the guard off its
+ * queue; mirrors the end of guard_move and exit_to_control_room
+ *
+ * @param[in,out] guard pointer to guard in transit
+ * @param[in] from room the guard left
+ * @param[in,out] to room the guard enters
+ */
+void guard_arrive(struct Guard* guard, struct Room* from, struct Room* to){
+    add_guard(to, guard);
+    guard->currentRoom = to;
+    guard->inControlRoom = to->isExit;
+
+    log_move(guard->id, guard->boredom, guard->stress, from->name, to->name, guard->device);
+
+    if (guard->returningToControl){
+        guard->returnSteps++;
+    } else {
+        strategy_note_arrival(guard, to);
+    }
+    guard_publish(guard);
+}
+
+/**
+ * @brief give back the slot claimed for a handoff that could not be queued
+ *
+ * @param[in,out] guard pointer to guard with handoffTo set
+ */
+void guard_cancel_handoff(struct Guard* guard){
+    room_guard_leave(guard->handoffTo);
+    guard->handoffTo = NULL;
+    guard->moveAborts++;
+}
+
 /**
  * @brief search current room for evidence and collect it if so
  *
  * if guards device matches evidence present in room the evidence
- * is collected, removed from the room and added to the casefile, and a return
+ * is collected, removed from the room and added to the case of the thief
+ * that dropped it, and a return
  * to the van is triggered. guards sometime get a "bad feeling";; and go back to the van
  *
  * @param[in,out] guard pointer to guard searching for evidence
  */
 void scan_for_clues(struct Guard* guard){
     struct Room* room = guard->currentRoom;
-    EvidenceByte inRoom = room->evidence;
 
-    sem_wait(&guard->mutex);
-    EvidenceByte device = guard->device;
+    EvidenceMask device = guard->device;
     int boredom = guard->boredom;
     int stress = guard->stress;
     bool inControlRoom = guard->inControlRoom;
-    sem_post(&guard->mutex);
 
-    EvidenceByte match = inRoom & device;
+    // the coverage mark goes first; see thief_haunt for why that order matters
+    atomic_fetch_or_explicit(&room->scanned, device, memory_order_acq_rel);
 
-    if (match != 0){
-        room->evidence = room->evidence & ~device;
+    // clearing the bit and learning whether it was there is one atomic step,
+    // so two guards holding the same device can never both collect it
+    EvidenceMask inRoom = atomic_fetch_and_explicit(&room->evidence, (EvidenceMask)~device, memory_order_acq_rel);
+    EvidenceMask match = inRoom & device;
 
-        sem_wait(&guard->casefile->mutex);
-        guard->casefile->collected |= device;
-        if (evidence_is_valid_ghost(guard->casefile->collected)){
-            guard->casefile->solved = true;
-        }
-        sem_post(&guard->casefile->mutex);
+    if (match != 0){
+        // the acquire above makes the dropper stored before the bit visible
+        int thief = atomic_load_explicit(&room->droppedBy[__builtin_ctzll(device)], memory_order_relaxed);
+        casefile_add_evidence(guard->casefile, thief, device);
 
         log_evidence(guard->id, boredom, stress, room->name, device);
         if (!inControlRoom){
             log_return_to_van(guard->id, boredom, stress, guard->currentRoom->name, device, true);
-
-            sem_wait(&guard->mutex);
             guard->returningToControl = true;
-            sem_post(&guard->mutex);
         }
         return;
     }
@@ -235,10 +343,7 @@ void scan_for_clues(struct Guard* guard){
 
     if (!inControlRoom && badFeeling == 0){
         log_return_to_van(guard->id, boredom, stress, guard->currentRoom->name, device, true);
-
-        sem_wait(&guard->mutex);
         guard->returningToControl = true;
-        sem_post(&guard->mutex);
     }
 }
 
@@ -255,31 +360,31 @@ void scan_for_clues(struct Guard* guard){
  */
 bool consider_exiting(struct Guard* guard){
     struct Room* room = guard->currentRoom;
-    sem_wait(&guard->mutex);
     int stress = guard->stress;
     int boredom = guard->boredom;
-    enum TamperType device = guard->device;
-    sem_post(&guard->mutex);
+    EvidenceMask device = guard->device;
 
     if (stress >= GUARD_STRESS_MAX){
+        room_lock(room);
         remove_guard(room, guard);
+        room_unlock(room);
+        room_guard_leave(room);
 
-        sem_wait(&guard->mutex);
         guard->active = false;
         guard->whyExit = LR_OVERWHELMED;
-        sem_post(&guard->mutex);
-
+        casefile_swap_device(guard->casefile, device, 0);
         log_exit(guard->id, boredom, stress, room->name, device, LR_OVERWHELMED);
         return true;
 
     } else if (boredom >= ENTITY_BOREDOM_MAX){
+        room_lock(room);
         remove_guard(room, guard);
+        room_unlock(room);
+        room_guard_leave(room);
 
-        sem_wait(&guard->mutex);
         guard->active = false;
         guard->whyExit = LR_BORED;
-        sem_post(&guard->mutex);
-
+        casefile_swap_device(guard->casefile, device, 0);
         log_exit(guard->id, boredom, stress, room->name, device, LR_BORED);
         return true;
     }
@@ -297,74 +402,114 @@ bool consider_exiting(struct Guard* guard){
  */
 void update_state(struct Guard* guard){
     struct Room* room = guard->currentRoom;
-    bool isThief = (room->thief != NULL);
-    sem_wait(&guard->mutex);
+    bool isThief = room_has_thief(room);
     if (isThief){
         guard->boredom = 0;
         guard->stress++;
     } else {
         guard->boredom++;
     }
-    sem_post(&guard->mutex);
 }
 
 /**
- * @brief a full guard turn
+ * @brief publish the guard's state for readers on other threads
+ *
+ * packs the fields other threads care about into one word, the device as
+ * its bit index, and stores it with release ordering; a plain store on
+ * x86, so the owning thread never takes a lock to keep readers up to date
+ *
+ * @param[in,out] guard pointer to guard
+ */
+void guard_publish(struct Guard* guard){
+    uint64_t stress = (uint64_t)(guard->stress > 0xFFFF ? 0xFFFF : guard->stress);
+    uint64_t boredom = (uint64_t)(guard->boredom > 0xFFFF ? 0xFFFF : guard->boredom);
+    uint64_t word = stress
+                  | (boredom << 16)
+                  | ((uint64_t)(__builtin_ctzll(guard->device) & 0xFF) << 32)
+                  | ((uint64_t)(guard->whyExit & 0xFF) << 40)
+                  | ((uint64_t)guard->active << 48)
+                  | ((uint64_t)guard->returningToControl << 49)
+                  | ((uint64_t)guard->inControlRoom << 50);
+
+    atomic_store_explicit(&guard->snapshot, word, memory_order_release);
+}
+
+/**
+ * @brief read the last state a guard published
+ *
+ * safe to call from any thread while the guard is running
+ *
+ * @param[in] guard pointer to guard
+ * @param[out] snap decoded snapshot
+ */
+void guard_read_snapshot(struct Guard* guard, struct GuardSnapshot* snap){
+    uint64_t word = atomic_load_explicit(&guard->snapshot, memory_order_acquire);
+
+    snap->stress = (int)(word & 0xFFFF);
+    snap->boredom = (int)((word >> 16) & 0xFFFF);
+    snap->device = (EvidenceMask)1 << ((word >> 32) & 0x3F);
+    snap->whyExit = (enum LogReason)((word >> 40) & 0xFF);
+    snap->active = (word >> 48) & 1;
+    snap->returningToControl = (word >> 49) & 1;
+    snap->inControlRoom = (word >> 50) & 1;
+}
+
+/**
+ * @brief the body of one guard turn
  *
  * performs update state, check for exit conditions checks if in van and calls iv_van
  * behavior performs evidence searching and moves the guard when allowed
  *
  * @param[in,out] guard pointer to guard taking turn
  */
-void guard_take_turn(struct Guard* guard){
-    if (!guard->active){
-        return;
-    }
-
-    struct Room* room = guard->currentRoom;
-    bool wasReturning, inControlRoom;
-    sem_wait(&guard->mutex);
-    wasReturning = guard->returningToControl;
-    inControlRoom = guard->inControlRoom;
-    sem_post(&guard->mutex);
-
-    if (inControlRoom && wasReturning){
+static void guard_step(struct Guard* guard){
+    if (guard->inControlRoom && guard->returningToControl){
         in_control_room(guard);
         if (!guard->active){
             return;
         }
     }
 
-    sem_wait(&room->mutex);
     update_state(guard);
 
     if (consider_exiting(guard)){
-        sem_post(&room->mutex);
         return;
     }
 
-    sem_wait(&guard->mutex);
-    wasReturning = guard->returningToControl;
-    sem_post(&guard->mutex);
-
-    if (wasReturning){
-        sem_post(&room->mutex);
+    if (guard->returningToControl){
         exit_to_control_room(guard);
         return;
     }
 
     scan_for_clues(guard);
 
-    bool nowReturning;
-    sem_wait(&guard->mutex);
-    nowReturning = guard->returningToControl;
-    sem_post(&guard->mutex);
-    sem_post(&room->mutex);
-
-    if (nowReturning){
+    if (guard->returningToControl){
         return;
     }
 
     guard_move(guard);
 }
 
+/**
+ * @brief a full guard turn
+ *
+ * runs the turn on the guard's own state without any guard lock, then
+ * publishes the result once for other threads. turns taken while a case is
+ * still open are counted for the turns-to-solve statistic
+ *
+ * @param[in,out] guard pointer to guard taking turn
+ */
+void guard_take_turn(struct Guard* guard){
+    if (!guard->active){
+        return;
+    }
+
+    if (!casefile_solved(guard->casefile)){
+        guard->solveTurns++;
+    }
+    rand_bind(&guard->randState);
+    guard_step(guard);
+    rand_bind(NULL);
+    guard_publish(guard);
+}
+
@@ -5,73 +5,26 @@
 #include <time.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <unistd.h>
 #include "helpers.h"
 
 // ---- House layout ----
 void museum_populate_rooms(struct Museum* museum) {
     // Museum layout for the heist simulation (room graph kept stable).
-    museum->room_count = 13;
-
-    room_init(museum->rooms+0, "Security Office", true);
-    room_init(museum->rooms+1, "Main Corridor", false);
-    room_init(museum->rooms+2, "Renaissance Gallery", false);
-    room_init(museum->rooms+3, "Modern Art Gallery", false);
-    room_init(museum->rooms+4, "Restroom", false);
-    room_init(museum->rooms+5, "Archives", false);
-    room_init(museum->rooms+6, "Service Corridor", false);
-    room_init(museum->rooms+7, "Storage A", false);
-    room_init(museum->rooms+8, "Storage B", false);
-    room_init(museum->rooms+9, "Cafe", false);
-    room_init(museum->rooms+10, "Grand Hall", false);
-    room_init(museum->rooms+11, "Loading Dock", false);
-    room_init(museum->rooms+12, "Control Closet", false);
-
-    room_connect(museum->rooms+0, museum->rooms+1);    // Security Office - Main Corridor
-    room_connect(museum->rooms+1, museum->rooms+2);    // Main Corridor - Renaissance Gallery
-    room_connect(museum->rooms+1, museum->rooms+3);    // Main Corridor - Modern Art Gallery
-    room_connect(museum->rooms+1, museum->rooms+4);    // Main Corridor - Restroom
-    room_connect(museum->rooms+1, museum->rooms+9);    // Main Corridor - Cafe
-    room_connect(museum->rooms+1, museum->rooms+5);    // Main Corridor - Archives
-    room_connect(museum->rooms+5, museum->rooms+6);    // Archives - Service Corridor
-    room_connect(museum->rooms+6, museum->rooms+7);    // Service Corridor - Storage A
-    room_connect(museum->rooms+6, museum->rooms+8);    // Service Corridor - Storage B
-    room_connect(museum->rooms+9, museum->rooms+10);   // Cafe - Grand Hall
-    room_connect(museum->rooms+9, museum->rooms+11);   // Cafe - Loading Dock
-    room_connect(museum->rooms+11, museum->rooms+12);  // Loading Dock - Control Closet
-
-    museum->starting_room = museum->rooms; // Van is at index 0
+    struct Layout layout;
+    if (layout_builtin(&layout)) {
+        museum_build(museum, &layout);
+    }
+    layout_free(&layout);
 }
 
 // ---- to_string functions ----
-const char* tamper_to_string(enum TamperType t) {
-    switch (t) {
-        case TP_CAMERA_BLACKOUT: return "camera_blackout";
-        case TP_FORCED_LOCK:     return "forced_lock";
-        case TP_GLASS_VIBRATION: return "glass_vibration";
-        case TP_RFID_SPOOF:      return "rfid_spoof";
-        case TP_MOTION_TRIGGER:  return "motion_trigger";
-        case TP_LASER_TRIP:      return "laser_trip";
-        case TP_TOOL_MARKS:      return "tool_marks";
-        default:                 return "unknown";
-    }
+const char* tamper_to_string(EvidenceMask t) {
+    return catalogue_type_name(t);
 }
 
-const char* thief_to_string(enum ThiefProfile p) {
-    switch (p) {
-        case TH_INSIDER:         return "insider";
-        case TH_SMASH_AND_GRAB:  return "smash_and_grab";
-        case TH_TECH_SPECIALIST: return "tech_specialist";
-        case TH_LOCKPICKER:      return "lockpicker";
-        case TH_ACROBAT:         return "acrobat";
-        case TH_VANDAL:          return "vandal";
-        case TH_CON_ARTIST:      return "con_artist";
-        case TH_PRO:             return "pro";
-        case TH_OPPORTUNIST:     return "opportunist";
-        case TH_NIGHT_CRAWLER:   return "night_crawler";
-        case TH_CUTTER:          return "cutter";
-        case TH_GHOST_ENTRY:     return "ghost_entry";
-        default:                 return "unknown";
-    }
+const char* thief_to_string(int p) {
+    return catalogue_profile_name(p);
 }
 
 const char* exit_reason_to_string(enum LogReason reason) {
@@ -83,43 +36,39 @@ const char* exit_reason_to_string(enum LogReason reason) {
     }
 }
 
-// ---- enum retrieval functions ----
-int get_all_tamper_types(const enum TamperType** list) {
-    static const enum TamperType tamper_types[] = {
-        TP_CAMERA_BLACKOUT,
-        TP_FORCED_LOCK,
-        TP_GLASS_VIBRATION,
-        TP_RFID_SPOOF,
-        TP_MOTION_TRIGGER,
-        TP_LASER_TRIP,
-        TP_TOOL_MARKS
-    };
+// ---- Thread-safe random number generation ----
+static unsigned base_seed = 0;
+static _Thread_local unsigned* bound_stream = NULL;
 
-    if (list) *list = tamper_types;
-    return (int)(sizeof(tamper_types) / sizeof(tamper_types[0]));
+void rand_seed(unsigned seed) {
+    base_seed = seed;
 }
 
-int get_all_thief_profiles(const enum ThiefProfile** list) {
-    static const enum ThiefProfile profiles[] = {
-        TH_INSIDER,
-        TH_SMASH_AND_GRAB,
-        TH_TECH_SPECIALIST,
-        TH_LOCKPICKER,
-        TH_ACROBAT,
-        TH_VANDAL,
-        TH_CON_ARTIST,
-        TH_PRO,
-        TH_OPPORTUNIST,
-        TH_NIGHT_CRAWLER,
-        TH_CUTTER,
-        TH_GHOST_ENTRY
-    };
+void rand_stream_init(unsigned* stream, enum RandOwner owner, unsigned id) {
+    static atomic_uint unseeded = 0;
+    // the owner takes the low two bits, so distinct keys stay distinct after the odd multiply
+    unsigned key = ((id << 2) | (unsigned)owner) * 0x9E3779B9u;
 
-    if (list) *list = profiles;
-    return (int)(sizeof(profiles) / sizeof(profiles[0]));
+    if (base_seed != 0) {
+        *stream = base_seed ^ key;
+    } else {
+        // every call takes a fresh count, so runs in one process, on the same addresses and
+        // within the same clock tick, still differ; the pid separates forked guard processes
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        unsigned count = atomic_fetch_add(&unseeded, 1) + 1;
+        *stream = key ^ (unsigned)now.tv_nsec ^ ((unsigned)now.tv_sec << 20) ^ (count * 0x85EBCA6Bu) ^
+                  ((unsigned)getpid() << 16);
+    }
+    if (*stream == 0) {
+        *stream = 0xA5A5A5A5u;
+    }
+}
+
+void rand_bind(unsigned* stream) {
+    bound_stream = stream;
 }
 
-// ---- Thread-safe random number generation ----
 int rand_int_threadsafe(int lower_inclusive, int upper_exclusive) {
     static _Thread_local unsigned seed = 0;
 
@@ -127,30 +76,29 @@ int rand_int_threadsafe(int lower_inclusive, int upper_exclusive) {
         return lower_inclusive;
     }
 
-    if (seed == 0) {
-        seed = (unsigned)time(NULL) ^ (unsigned)(uintptr_t)pthread_self();
+    unsigned* stream = bound_stream;
+    if (stream == NULL) {
+        // threads drawing for no entity all share stream 0 of their key space when seeded
         if (seed == 0) {
-            seed = 0xA5A5A5A5u;
+            rand_stream_init(&seed, RAND_THREAD, 0);
         }
+        stream = &seed;
     }
 
     unsigned span = (unsigned)(upper_exclusive - lower_inclusive);
-    unsigned value = (unsigned)rand_r(&seed) % span;
+    unsigned value = (unsigned)rand_r(stream) % span;
     return lower_inclusive + (int)value;
 }
 
 // ---- Evidence helpers ----
-bool evidence_is_valid_ghost(EvidenceByte mask) {
-    const enum ThiefProfile* thief_types = NULL;
-    int thief_count = get_all_thief_profiles(&thief_types);
-
-    for (int index = 0; index < thief_count; index++) {
-        if (mask == (EvidenceByte)thief_types[index]) {
-            return true;
-        }
-    }
+// Both are single lookups in the active catalogue's candidate table.
+bool evidence_is_valid_ghost(EvidenceMask mask) {
+    int profile;
+    return mask != 0 && catalogue_candidates(mask, &profile) == 1 && catalogue_profile_mask(profile) == mask;
+}
 
-    return false;
+bool evidence_identify(EvidenceMask mask, int* profile) {
+    return catalogue_candidates(mask, profile) == 1;
 }
 
 // ---- Logging (Writes CSV logs, DO NOT MODIFY the file outputs: timestamp,type,id,room,device,boredom,stress,action,extra) ----
@@ -183,6 +131,12 @@ static const char* log_entity_type_to_string(enum LogEntityType type) {
     }
 }
 
+static bool logging_enabled = true;
+
+void log_set_enabled(bool enabled) {
+    logging_enabled = enabled;
+}
+
 static void write_log_record(const struct LogRecord* record) {
     static _Thread_local unsigned line_count = 0;
 
@@ -230,7 +184,9 @@ static void write_log_record(const struct LogRecord* record) {
     nanosleep(&pause, NULL);
 }
 
-void log_move(int guard_id, int boredom, int stress, const char* from_room, const char* to_room, enum TamperType device) {
+void log_move(int guard_id, int boredom, int stress, const char* from_room, const char* to_room, EvidenceMask device) {
+    if (!logging_enabled) return;
+
     struct LogRecord record = {
         .entity_type = LOG_ENTITY_HUNTER,
         .entity_id = guard_id,
@@ -253,7 +209,9 @@ void log_move(int guard_id, int boredom, int stress, const char* from_room, cons
            stress);
 }
 
-void log_evidence(int guard_id, int boredom, int stress, const char* room_name, enum TamperType device) {
+void log_evidence(int guard_id, int boredom, int stress, const char* room_name, EvidenceMask device) {
+    if (!logging_enabled) return;
+
     const char* evidence = tamper_to_string(device);
     struct LogRecord record = {
         .entity_type = LOG_ENTITY_HUNTER,
@@ -276,7 +234,9 @@ void log_evidence(int guard_id, int boredom, int stress, const char* room_name,
            stress);
 }
 
-void log_swap(int guard_id, int boredom, int stress, enum TamperType from_device, enum TamperType to_device) {
+void log_swap(int guard_id, int boredom, int stress, EvidenceMask from_device, EvidenceMask to_device) {
+    if (!logging_enabled) return;
+
     char extra[64];
     const char* from_text = tamper_to_string(from_device);
     const char* to_text = tamper_to_string(to_device);
@@ -303,7 +263,9 @@ void log_swap(int guard_id, int boredom, int stress, enum TamperType from_device
            stress);
 }
 
-void log_exit(int guard_id, int boredom, int stress, const char* room_name, enum TamperType device, enum LogReason reason) {
+void log_exit(int guard_id, int boredom, int stress, const char* room_name, EvidenceMask device, enum LogReason reason) {
+    if (!logging_enabled) return;
+
     const char* device_text = tamper_to_string(device);
     const char* reason_text = exit_reason_to_string(reason);
 
@@ -329,7 +291,9 @@ void log_exit(int guard_id, int boredom, int stress, const char* room_name, enum
            stress);
 }
 
-void log_return_to_van(int guard_id, int boredom, int stress, const char* room_name, enum TamperType device, bool heading_home) {
+void log_return_to_van(int guard_id, int boredom, int stress, const char* room_name, EvidenceMask device, bool heading_home) {
+    if (!logging_enabled) return;
+
     const char* device_text = tamper_to_string(device);
     const char* extra = heading_home ? "start" : "complete";
     const char* action = heading_home ? "RETURN_START" : "RETURN_COMPLETE";
@@ -364,7 +328,9 @@ void log_return_to_van(int guard_id, int boredom, int stress, const char* room_n
     }
 }
 
-void log_guard_init(int guard_id, const char* room_name, const char* guard_name, enum TamperType device) {
+void log_guard_init(int guard_id, const char* room_name, const char* guard_name, EvidenceMask device) {
+    if (!logging_enabled) return;
+
     const char* device_text = tamper_to_string(device);
     struct LogRecord record = {
         .entity_type = LOG_ENTITY_HUNTER,
@@ -385,8 +351,10 @@ void log_guard_init(int guard_id, const char* room_name, const char* guard_name,
            device_text);
 }
 
-void log_thief_init(int thief_id, const char* room_name, enum ThiefProfile type) {
-    const char* type_text = thief_to_string(type);
+void log_thief_init(int thief_id, const char* room_name, int profile) {
+    if (!logging_enabled) return;
+
+    const char* type_text = thief_to_string(profile);
     struct LogRecord record = {
         .entity_type = LOG_ENTITY_GHOST,
         .entity_id = thief_id,
@@ -406,6 +374,8 @@ void log_thief_init(int thief_id, const char* room_name, enum ThiefProfile type)
 }
 
 void log_thief_move(int thief_id, int boredom, const char* from_room, const char* to_room) {
+    if (!logging_enabled) return;
+
     struct LogRecord record = {
         .entity_type = LOG_ENTITY_GHOST,
         .entity_id = thief_id,
@@ -426,7 +396,9 @@ void log_thief_move(int thief_id, int boredom, const char* from_room, const char
            to_room ? to_room : "");
 }
 
-void log_thief_evidence(int thief_id, int boredom, const char* room_name, enum TamperType evidence) {
+void log_thief_evidence(int thief_id, int boredom, const char* room_name, EvidenceMask evidence) {
+    if (!logging_enabled) return;
+
     const char* evidence_text = tamper_to_string(evidence);
 
     struct LogRecord record = {
@@ -450,6 +422,8 @@ void log_thief_evidence(int thief_id, int boredom, const char* room_name, enum T
 }
 
 void log_thief_exit(int thief_id, int boredom, const char* room_name) {
+    if (!logging_enabled) return;
+
     struct LogRecord record = {
         .entity_type = LOG_ENTITY_GHOST,
         .entity_id = thief_id,
@@ -470,6 +444,8 @@ void log_thief_exit(int thief_id, int boredom, const char* room_name) {
 }
 
 void log_thief_idle(int thief_id, int boredom, const char* room_name) {
+    if (!logging_enabled) return;
+
     struct LogRecord record = {
         .entity_type = LOG_ENTITY_GHOST,
         .entity_id = thief_id,
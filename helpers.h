@@ -5,17 +5,17 @@
 
 /**
  * @brief Return the lowercase token for a device.
- * @param[in] evidence  Evidence type value.
- * @return Static string such as "emf"; "unknown" when out of range.
+ * @param[in] evidence  A single evidence bit of the active catalogue.
+ * @return Catalogue name such as "laser_trip"; "unknown" when out of range.
  */
-const char* tamper_to_string(enum TamperType evidence);
+const char* tamper_to_string(EvidenceMask evidence);
 
 /**
- * @brief Return the lowercase token for a ghost type.
- * @param[in] ghost Thief type value.
- * @return Static string such as "goryo"; "unknown" when out of range.
+ * @brief Return the lowercase token for a thief profile.
+ * @param[in] ghost Profile index in the active catalogue.
+ * @return Catalogue name such as "cutter"; "unknown" when out of range.
  */
-const char* thief_to_string(enum ThiefProfile ghost);
+const char* thief_to_string(int ghost);
 
 /**
  * @brief Translate a log reason to text.
@@ -25,21 +25,41 @@ const char* thief_to_string(enum ThiefProfile ghost);
 const char* exit_reason_to_string(enum LogReason reason);
 
 /**
- * @brief Expose every evidence device.
- * @param[out] list Optional pointer updated to an array of seven entries.
- * @return Number of items in the returned list.
+ * @brief Derive every entity's random stream from a fixed seed instead of the clock.
+ *
+ * Must be called before the streams are initialized. Each guard and thief
+ * then draws from a stream keyed by its id, so a run repeats whatever
+ * thread ends up running which entity.
+ *
+ * @param[in] seed Base seed; 0 goes back to clock-based seeding.
  */
-int get_all_tamper_types(const enum TamperType** list);
+void rand_seed(unsigned seed);
 
 /**
- * @brief Expose every ghost archetype.
- * @param[out] list Optional pointer updated to an array of ghost types.
- * @return Number of ghost entries in the array.
+ * @brief Seed one entity's random stream.
+ *
+ * With a seed set the stream is a function of the seed, owner and id only.
+ * Without one, every call mixes in the monotonic clock and a process-wide
+ * count, so no two streams in a process start alike.
+ *
+ * @param[out] stream State to seed.
+ * @param[in] owner Kind of entity, keeping guards' and thieves' keys apart.
+ * @param[in] id Stable id of the entity that owns the stream.
  */
-int get_all_thief_profiles(const enum ThiefProfile** list);
+void rand_stream_init(unsigned* stream, enum RandOwner owner, unsigned id);
+
+/**
+ * @brief Make rand_int_threadsafe draw from an entity's stream on this thread.
+ * @param[in] stream State to draw from, or NULL for the thread's own stream.
+ */
+void rand_bind(unsigned* stream);
 
 /**
  * @brief Thread-safe random integer helper.
+ *
+ * Draws from the stream bound with rand_bind, or from the calling thread's
+ * own stream when none is bound.
+ *
  * @param[in] lower_inclusive Minimum value (inclusive).
  * @param[in] upper_exclusive Maximum value (exclusive).
  * @return Random number in [lower_inclusive, upper_exclusive).
@@ -49,23 +69,30 @@ int rand_int_threadsafe(int lower_inclusive, int upper_exclusive);
 /**
  * @brief Verify whether an evidence mask matches a supported ghost type.
  * @param[in] mask Combined evidence mask.
- * @return true when the mask maps exactly to a ghost definition.
+ * @return true when the mask maps exactly to a profile of the active catalogue.
  */
-bool evidence_is_valid_ghost(EvidenceByte mask);
+bool evidence_is_valid_ghost(EvidenceMask mask);
 
 /**
- * @brief Check whether at least three unique evidence bits are set.
- * @param[in] mask Evidence bitmask to inspect.
- * @return true when three or more distinct bits are set.
+ * @brief Name the profile an evidence mask identifies.
+ * @param[in] mask Evidence collected for one thief.
+ * @param[out] profile The identified profile index, untouched when there is none.
+ * @return true when exactly one profile is consistent with mask.
  */
-bool evidence_has_three_unique(EvidenceByte mask);
+bool evidence_identify(EvidenceMask mask, int* profile);
 
 /**
- * @brief Populate the museum structure with the Willow layout.
+ * @brief Populate the museum structure with the built-in layout.
  * @param[in,out] museum Museum to populate; starting_room is set to the van.
  */
 void museum_populate_rooms(struct Museum* museum);
 
+/**
+ * @brief Turn CSV logging and console narration on or off for every entity.
+ * @param[in] enabled false silences every log_* call (used for benchmarks).
+ */
+void log_set_enabled(bool enabled);
+
 /**
  * @brief Append a MOVE entry for a hunter.
  * @param[in] id Guard identifier.
@@ -75,7 +102,7 @@ void museum_populate_rooms(struct Museum* museum);
  * @param[in] to Destination room name.
  * @param[in] device Device the hunter is holding.
  */
-void log_move(int id, int boredom, int stress, const char* from, const char* to, enum TamperType device);
+void log_move(int id, int boredom, int stress, const char* from, const char* to, EvidenceMask device);
 
 /**
  * @brief Append an EVIDENCE entry for a hunter.
@@ -85,7 +112,7 @@ void log_move(int id, int boredom, int stress, const char* from, const char* to,
  * @param[in] room Room where evidence was collected.
  * @param[in] device Device used to collect evidence.
  */
-void log_evidence(int id, int boredom, int stress, const char* room, enum TamperType device);
+void log_evidence(int id, int boredom, int stress, const char* room, EvidenceMask device);
 
 /**
  * @brief Append a SWAP entry for a hunter.
@@ -95,7 +122,7 @@ void log_evidence(int id, int boredom, int stress, const char* room, enum Tamper
  * @param[in] from Device swapped from.
  * @param[in] to Device swapped to.
  */
-void log_swap(int id, int boredom, int stress, enum TamperType from, enum TamperType to);
+void log_swap(int id, int boredom, int stress, EvidenceMask from, EvidenceMask to);
 
 /**
  * @brief Append an EXIT entry for a hunter.
@@ -106,7 +133,7 @@ void log_swap(int id, int boredom, int stress, enum TamperType from, enum Tamper
  * @param[in] device Device carried.
  * @param[in] reason Exit reason.
  */
-void log_exit(int id, int boredom, int stress, const char* room, enum TamperType device, enum LogReason reason);
+void log_exit(int id, int boredom, int stress, const char* room, EvidenceMask device, enum LogReason reason);
 
 /**
  * @brief Append a MOVE entry for the ghost.
@@ -124,7 +151,7 @@ void log_thief_move(int id, int boredom, const char* from, const char* to);
  * @param[in] room Room where evidence was dropped.
  * @param[in] evidence Evidence type left behind.
  */
-void log_thief_evidence(int id, int boredom, const char* room, enum TamperType evidence);
+void log_thief_evidence(int id, int boredom, const char* room, EvidenceMask evidence);
 
 /**
  * @brief Append an EXIT entry for the ghost.
@@ -151,7 +178,7 @@ void log_thief_idle(int id, int boredom, const char* room);
  * @param[in] device Device being carried.
  * @param[in] heading_home true if beginning the return path.
  */
-void log_return_to_van(int id, int boredom, int stress, const char* room, enum TamperType device, bool heading_home);
+void log_return_to_van(int id, int boredom, int stress, const char* room, EvidenceMask device, bool heading_home);
 
 /**
  * @brief Append an INIT entry for a hunter.
@@ -160,15 +187,15 @@ void log_return_to_van(int id, int boredom, int stress, const char* room, enum T
  * @param[in] name Guard name.
  * @param[in] device Initial device.
  */
-void log_guard_init(int id, const char* room, const char* name, enum TamperType device);
+void log_guard_init(int id, const char* room, const char* name, EvidenceMask device);
 
 /**
  * @brief Append an INIT entry for the ghost.
  * @param[in] id Thief identifier.
  * @param[in] room Starting room.
- * @param[in] type Thief type.
+ * @param[in] profile Profile index in the active catalogue.
  */
-void log_thief_init(int id, const char* room, enum ThiefProfile type);
+void log_thief_init(int id, const char* room, int profile);
 
 #endif // HELPERS_H
 
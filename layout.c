@@ -0,0 +1,430 @@
+#include "layout.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LAYOUT_LINE_MAX 512
+
+void layout_init(struct Layout* layout){
+    strtab_init(&layout->names);
+    layout->nameIds = NULL;
+    layout->nameNumbers = NULL;
+    layout->roomCount = 0;
+    layout->roomCap = 0;
+    layout->nameRooms = NULL;
+    layout->nameRoomCap = 0;
+    layout->doors = NULL;
+    layout->doorCount = 0;
+    layout->doorCap = 0;
+    layout->exitRoom = LAYOUT_NO_ROOM;
+}
+
+void layout_free(struct Layout* layout){
+    strtab_free(&layout->names);
+    free(layout->nameIds);
+    free(layout->nameNumbers);
+    free(layout->nameRooms);
+    free(layout->doors);
+    layout_init(layout);
+}
+
+uint32_t layout_room_count(const struct Layout* layout){
+    return layout->roomCount;
+}
+
+uint32_t layout_intern_name(struct Layout* layout, const char* name){
+    uint32_t id = strtab_intern(&layout->names, name);
+    if (id == UINT32_MAX){
+        return LAYOUT_NO_ROOM;
+    }
+
+    if (id >= layout->nameRoomCap){
+        uint32_t newCap = layout->nameRoomCap ? layout->nameRoomCap * 2 : 16;
+        while (newCap <= id){
+            newCap *= 2;
+        }
+        uint32_t* nameRooms = realloc(layout->nameRooms, newCap * sizeof(uint32_t));
+        if (!nameRooms){
+            return LAYOUT_NO_ROOM;
+        }
+        for (uint32_t i = layout->nameRoomCap; i < newCap; i++){
+            nameRooms[i] = LAYOUT_NO_ROOM;
+        }
+        layout->nameRooms = nameRooms;
+        layout->nameRoomCap = newCap;
+    }
+    return id;
+}
+
+bool layout_reserve(struct Layout* layout, uint32_t count, size_t doorCount){
+    if (count > layout->roomCap){
+        uint32_t* nameIds = realloc(layout->nameIds, (size_t)count * sizeof(uint32_t));
+        if (!nameIds){
+            return false;
+        }
+        layout->nameIds = nameIds;
+        uint32_t* nameNumbers = realloc(layout->nameNumbers, (size_t)count * sizeof(uint32_t));
+        if (!nameNumbers){
+            return false;
+        }
+        layout->nameNumbers = nameNumbers;
+        layout->roomCap = count;
+    }
+
+    if (doorCount > layout->doorCap){
+        uint32_t (*doors)[2] = realloc(layout->doors, doorCount * sizeof(*doors));
+        if (!doors){
+            return false;
+        }
+        layout->doors = doors;
+        layout->doorCap = doorCount;
+    }
+    return true;
+}
+
+uint32_t layout_add_room(struct Layout* layout, const char* name){
+    uint32_t id = layout_intern_name(layout, name);
+    if (id == LAYOUT_NO_ROOM){
+        return LAYOUT_NO_ROOM;
+    }
+    if (layout->nameRooms[id] != LAYOUT_NO_ROOM){
+        return layout->nameRooms[id];
+    }
+
+    if (layout->roomCount >= layout->roomCap){
+        uint32_t newCap = layout->roomCap ? layout->roomCap * 2 : 16;
+        if (!layout_reserve(layout, newCap, layout->doorCap)){
+            return LAYOUT_NO_ROOM;
+        }
+    }
+
+    uint32_t room = layout->roomCount++;
+    layout->nameIds[room] = id;
+    layout->nameNumbers[room] = 0;
+    layout->nameRooms[id] = room;
+    return room;
+}
+
+bool layout_add_door(struct Layout* layout, uint32_t a, uint32_t b){
+    if (a >= layout->roomCount || b >= layout->roomCount || a == b){
+        return false;
+    }
+
+    if (layout->doorCount >= layout->doorCap &&
+        !layout_reserve(layout, layout->roomCap, layout->doorCap ? layout->doorCap * 2 : 16)){
+        return false;
+    }
+
+    layout->doors[layout->doorCount][0] = a;
+    layout->doors[layout->doorCount][1] = b;
+    layout->doorCount++;
+    return true;
+}
+
+const char* layout_room_name(const struct Layout* layout, uint32_t room, char* buffer, size_t size){
+    const char* base = strtab_get(&layout->names, layout->nameIds[room]);
+    if (layout->nameNumbers[room]){
+        snprintf(buffer, size, "%s %u", base, layout->nameNumbers[room]);
+    } else {
+        snprintf(buffer, size, "%s", base);
+    }
+    return buffer;
+}
+
+bool layout_to_compact(const struct Layout* layout, struct CompactMuseum* compact){
+    if (!compact_build(compact, layout->roomCount, (const uint32_t (*)[2])layout->doors,
+                       layout->doorCount, layout->exitRoom)){
+        return false;
+    }
+
+    // base names are interned once each and then mapped, so naming costs no hashing per room
+    uint32_t* mapped = malloc(((size_t)layout->names.count + 1) * sizeof(uint32_t));
+    if (!mapped){
+        compact_free(compact);
+        return false;
+    }
+    for (uint32_t id = 0; id < layout->names.count; id++){
+        mapped[id] = strtab_intern(&compact->names, strtab_get(&layout->names, id));
+    }
+    for (uint32_t r = 0; r < layout->roomCount; r++){
+        compact->nameIds[r] = mapped[layout->nameIds[r]];
+        compact->nameNumbers[r] = layout->nameNumbers[r];
+    }
+    free(mapped);
+    return true;
+}
+
+/**
+ * @brief find the representative of a room's component, halving the path
+ *
+ * @param[in,out] parent union-find parent of each room
+ * @param[in] room room id
+ *
+ * @return representative room id
+ */
+static uint32_t uf_find(uint32_t* parent, uint32_t room){
+    while (parent[room] != room){
+        parent[room] = parent[parent[room]];
+        room = parent[room];
+    }
+    return room;
+}
+
+/**
+ * @brief check connectivity with one union-find pass over the doors
+ *
+ * no adjacency has to be built, so validation costs one array of room ids
+ * and stays linear in the number of doors
+ */
+bool layout_validate(const struct Layout* layout, char* error, size_t errorSize){
+    uint32_t rooms = layout->roomCount;
+    if (rooms == 0){
+        snprintf(error, errorSize, "layout has no rooms");
+        return false;
+    }
+    if (layout->exitRoom >= rooms){
+        snprintf(error, errorSize, "layout has no exit room");
+        return false;
+    }
+
+    uint32_t* parent = malloc((size_t)rooms * sizeof(uint32_t));
+    if (!parent){
+        snprintf(error, errorSize, "out of memory validating %u rooms", rooms);
+        return false;
+    }
+    for (uint32_t r = 0; r < rooms; r++){
+        parent[r] = r;
+    }
+
+    for (size_t d = 0; d < layout->doorCount; d++){
+        uint32_t a = uf_find(parent, layout->doors[d][0]);
+        uint32_t b = uf_find(parent, layout->doors[d][1]);
+        if (a != b){
+            parent[a] = b;
+        }
+    }
+
+    uint32_t exitSet = uf_find(parent, layout->exitRoom);
+    uint32_t unreachable = 0;
+    uint32_t first = LAYOUT_NO_ROOM;
+    for (uint32_t r = 0; r < rooms; r++){
+        if (uf_find(parent, r) != exitSet){
+            if (first == LAYOUT_NO_ROOM){
+                first = r;
+            }
+            unreachable++;
+        }
+    }
+    free(parent);
+
+    if (unreachable > 0){
+        char exitName[LAYOUT_MAX_NAME + 16];
+        char firstName[LAYOUT_MAX_NAME + 16];
+        snprintf(error, errorSize, "%u room(s) cannot reach exit \"%s\", first is \"%s\"", unreachable,
+                 layout_room_name(layout, layout->exitRoom, exitName, sizeof(exitName)),
+                 layout_room_name(layout, first, firstName, sizeof(firstName)));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief strip leading and trailing whitespace in place
+ *
+ * @param[in,out] text string to trim
+ *
+ * @return start of the trimmed string
+ */
+static char* trim(char* text){
+    while (isspace((unsigned char)*text)){
+        text++;
+    }
+    char* end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])){
+        *--end = '\0';
+    }
+    return text;
+}
+
+/**
+ * @brief intern a room name read from a layout file
+ *
+ * @param[in,out] layout layout being loaded
+ * @param[in] name trimmed room name
+ * @param[out] error message on failure
+ * @param[in] errorSize size of error
+ *
+ * @return room id, LAYOUT_NO_ROOM on failure
+ */
+static uint32_t load_room(struct Layout* layout, const char* name, char* error, size_t errorSize){
+    size_t len = strlen(name);
+    if (len == 0){
+        snprintf(error, errorSize, "missing room name");
+        return LAYOUT_NO_ROOM;
+    }
+    if (len >= LAYOUT_MAX_NAME){
+        snprintf(error, errorSize, "room name longer than %d characters", LAYOUT_MAX_NAME - 1);
+        return LAYOUT_NO_ROOM;
+    }
+
+    uint32_t id = layout_add_room(layout, name);
+    if (id == LAYOUT_NO_ROOM){
+        snprintf(error, errorSize, "out of memory");
+    }
+    return id;
+}
+
+/**
+ * @brief apply one line of a layout file
+ *
+ * @param[in,out] layout layout being loaded
+ * @param[in,out] line line with the newline removed, modified in place
+ * @param[out] error message on failure
+ * @param[in] errorSize size of error
+ *
+ * @return true if the line was valid
+ */
+static bool load_line(struct Layout* layout, char* line, char* error, size_t errorSize){
+    line = trim(line);
+    if (*line == '\0' || *line == '#'){
+        return true;
+    }
+
+    char* rest = line;
+    while (*rest && !isspace((unsigned char)*rest)){
+        rest++;
+    }
+    if (*rest){
+        *rest++ = '\0';
+    }
+    rest = trim(rest);
+
+    if (strcmp(line, "room") == 0){
+        return load_room(layout, rest, error, errorSize) != LAYOUT_NO_ROOM;
+    }
+
+    if (strcmp(line, "exit") == 0){
+        uint32_t id = load_room(layout, rest, error, errorSize);
+        if (id == LAYOUT_NO_ROOM){
+            return false;
+        }
+        if (layout->exitRoom != LAYOUT_NO_ROOM && layout->exitRoom != id){
+            snprintf(error, errorSize, "second exit \"%s\", only one is supported", rest);
+            return false;
+        }
+        layout->exitRoom = id;
+        return true;
+    }
+
+    if (strcmp(line, "door") == 0){
+        char* split = strstr(rest, "--");
+        if (!split){
+            snprintf(error, errorSize, "door needs two rooms separated by \"--\"");
+            return false;
+        }
+        *split = '\0';
+        uint32_t a = load_room(layout, trim(rest), error, errorSize);
+        if (a == LAYOUT_NO_ROOM){
+            return false;
+        }
+        uint32_t b = load_room(layout, trim(split + 2), error, errorSize);
+        if (b == LAYOUT_NO_ROOM){
+            return false;
+        }
+        if (a == b){
+            snprintf(error, errorSize, "door from \"%s\" to itself", trim(rest));
+            return false;
+        }
+        if (!layout_add_door(layout, a, b)){
+            snprintf(error, errorSize, "out of memory");
+            return false;
+        }
+        return true;
+    }
+
+    snprintf(error, errorSize, "unknown keyword \"%s\"", line);
+    return false;
+}
+
+bool layout_load(struct Layout* layout, const char* path, char* error, size_t errorSize){
+    layout_init(layout);
+
+    FILE* file = fopen(path, "r");
+    if (!file){
+        snprintf(error, errorSize, "%s: cannot open", path);
+        return false;
+    }
+
+    char line[LAYOUT_LINE_MAX];
+    char message[256];
+    int lineNo = 0;
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), file)){
+        lineNo++;
+        char* newL = strchr(line, '\n');
+        if (newL){
+            *newL = '\0';
+        } else if (!feof(file)){
+            snprintf(message, sizeof(message), "line longer than %d characters", LAYOUT_LINE_MAX - 2);
+            ok = false;
+            break;
+        }
+        ok = load_line(layout, line, message, sizeof(message));
+    }
+    fclose(file);
+
+    if (ok && layout->exitRoom == LAYOUT_NO_ROOM && layout_room_count(layout) > 0){
+        layout->exitRoom = 0;
+    }
+
+    if (!ok){
+        snprintf(error, errorSize, "%s:%d: %s", path, lineNo, message);
+    } else if (!layout_validate(layout, message, sizeof(message))){
+        snprintf(error, errorSize, "%s: %s", path, message);
+        ok = false;
+    }
+
+    if (!ok){
+        layout_free(layout);
+    }
+    return ok;
+}
+
+bool layout_builtin(struct Layout* layout){
+    // Museum layout for the heist simulation (room graph kept stable).
+    static const char* rooms[] = {
+        "Security Office", "Main Corridor", "Renaissance Gallery", "Modern Art Gallery",
+        "Restroom", "Archives", "Service Corridor", "Storage A", "Storage B",
+        "Cafe", "Grand Hall", "Loading Dock", "Control Closet"
+    };
+    static const uint32_t doors[][2] = {
+        { 0, 1 },    // Security Office - Main Corridor
+        { 1, 2 },    // Main Corridor - Renaissance Gallery
+        { 1, 3 },    // Main Corridor - Modern Art Gallery
+        { 1, 4 },    // Main Corridor - Restroom
+        { 1, 9 },    // Main Corridor - Cafe
+        { 1, 5 },    // Main Corridor - Archives
+        { 5, 6 },    // Archives - Service Corridor
+        { 6, 7 },    // Service Corridor - Storage A
+        { 6, 8 },    // Service Corridor - Storage B
+        { 9, 10 },   // Cafe - Grand Hall
+        { 9, 11 },   // Cafe - Loading Dock
+        { 11, 12 },  // Loading Dock - Control Closet
+    };
+
+    layout_init(layout);
+    for (size_t i = 0; i < sizeof(rooms) / sizeof(rooms[0]); i++){
+        if (layout_add_room(layout, rooms[i]) == LAYOUT_NO_ROOM){
+            return false;
+        }
+    }
+    for (size_t i = 0; i < sizeof(doors) / sizeof(doors[0]); i++){
+        if (!layout_add_door(layout, doors[i][0], doors[i][1])){
+            return false;
+        }
+    }
+    layout->exitRoom = 0; // Van is at index 0
+    return true;
+}
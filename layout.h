@@ -0,0 +1,201 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "compact.h"
+
+#define LAYOUT_MAX_NAME 64
+#define LAYOUT_NO_ROOM UINT32_MAX
+#define LAYOUT_GEN_MAX_EXTRA 8   // Cap on random extra doors per generated room
+
+enum LayoutShape {
+    SHAPE_GRID = 0,        // One floor, rooms in a square grid
+    SHAPE_WINGS = 1,       // Random tree: corridors branching into wings of galleries
+    SHAPE_SMALL_WORLD = 2, // Ring of rooms plus long random corridors
+    SHAPE_FLOORS = 3,      // Grid floors stacked and joined by stairwells
+    SHAPE_COUNT
+};
+
+enum LayoutExit {
+    EXIT_FIRST = 0,        // Room 0
+    EXIT_CENTER = 1,       // Middle of the (first) floor
+    EXIT_RANDOM = 2,       // Any room, picked from the seed
+    EXIT_COUNT
+};
+
+// Generator parameters. The same seed gives the same layout whatever the
+// thread count, because every room draws its doors from its own stream.
+struct LayoutGenOptions {
+    enum LayoutShape shape;
+    uint32_t rooms;
+    uint64_t seed;
+    double extraDoors;     // Mean random doors added per room on top of the shape, at most LAYOUT_GEN_MAX_EXTRA
+    int skew;              // Extra doors lead to room u^skew * rooms for uniform u; >1 grows a few large hubs
+    int branching;         // Wings: children per corridor
+    int floors;            // Floors: number of floors
+    int stairwells;        // Floors: stairwells between each pair of floors
+    enum LayoutExit exit;
+    int threads;           // 0 uses every online CPU
+};
+
+// A museum floor plan before any rooms are allocated. A room's name is an
+// interned base plus an optional number, the way CompactMuseum stores them,
+// so generated museums share a handful of strings. Files are read in one
+// pass: the first mention of a name creates the room, later mentions find it
+// through nameRooms.
+struct Layout {
+    struct StringTable names;   // Interned base names
+    uint32_t* nameIds;          // Base name of each room
+    uint32_t* nameNumbers;      // Appended to the base name when non-zero ("Gallery 17")
+    uint32_t roomCount;
+    uint32_t roomCap;
+    uint32_t* nameRooms;        // Room whose full name is exactly this string, by name id; LAYOUT_NO_ROOM if none
+    uint32_t nameRoomCap;
+    uint32_t (*doors)[2];       // Undirected doors as pairs of room ids
+    size_t doorCount;
+    size_t doorCap;
+    uint32_t exitRoom;          // LAYOUT_NO_ROOM until an exit is chosen
+};
+
+/**
+ * @brief Initialize an empty layout.
+ * @param[out] layout Layout to initialize.
+ */
+void layout_init(struct Layout* layout);
+
+/**
+ * @brief Free everything owned by a layout.
+ * @param[in,out] layout Layout to release.
+ */
+void layout_free(struct Layout* layout);
+
+/**
+ * @brief Number of rooms in a layout.
+ * @param[in] layout Layout to inspect.
+ * @return Room count.
+ */
+uint32_t layout_room_count(const struct Layout* layout);
+
+/**
+ * @brief Intern a base name without creating a room for it.
+ * @param[in,out] layout Layout holding the name.
+ * @param[in] name Base name.
+ * @return Name id, LAYOUT_NO_ROOM when memory ran out.
+ */
+uint32_t layout_intern_name(struct Layout* layout, const char* name);
+
+/**
+ * @brief Make room for at least count rooms and doorCount doors in total.
+ * @param[in,out] layout Layout to grow.
+ * @param[in] count Room capacity wanted.
+ * @param[in] doorCount Door capacity wanted.
+ * @return false when memory ran out.
+ */
+bool layout_reserve(struct Layout* layout, uint32_t count, size_t doorCount);
+
+/**
+ * @brief Return the id of a room, creating it on first use.
+ * @param[in,out] layout Layout holding the room.
+ * @param[in] name Room name, shorter than LAYOUT_MAX_NAME.
+ * @return Room id, LAYOUT_NO_ROOM when memory ran out.
+ */
+uint32_t layout_add_room(struct Layout* layout, const char* name);
+
+/**
+ * @brief Add a door between two rooms.
+ * @param[in,out] layout Layout holding both rooms.
+ * @param[in] a First room id.
+ * @param[in] b Second room id.
+ * @return false when an id is out of range, a == b or memory ran out.
+ */
+bool layout_add_door(struct Layout* layout, uint32_t a, uint32_t b);
+
+/**
+ * @brief Format a room's display name.
+ * @param[in] layout Layout holding the room.
+ * @param[in] room Room id.
+ * @param[out] buffer Destination.
+ * @param[in] size Size of buffer.
+ * @return buffer.
+ */
+const char* layout_room_name(const struct Layout* layout, uint32_t room, char* buffer, size_t size);
+
+/**
+ * @brief Build a compact museum with the same rooms, doors, names and exit.
+ * @param[in] layout Layout to convert.
+ * @param[out] compact Compact museum to build.
+ * @return false when memory ran out.
+ */
+bool layout_to_compact(const struct Layout* layout, struct CompactMuseum* compact);
+
+/**
+ * @brief Check that an exit is set and every room can reach it.
+ * @param[in] layout Layout to check.
+ * @param[out] error Message describing the first problem found.
+ * @param[in] errorSize Size of error.
+ * @return true when the layout can be simulated.
+ */
+bool layout_validate(const struct Layout* layout, char* error, size_t errorSize);
+
+/**
+ * @brief Read a layout from a text file in one pass and validate it.
+ *
+ * Lines are "room NAME", "door NAME -- NAME" or "exit NAME"; blank lines and
+ * lines starting with '#' are skipped. Doors and the exit may name rooms that
+ * have not been declared yet. When no exit line is given the first room is
+ * the exit.
+ *
+ * @param[out] layout Layout to fill; freed again on failure.
+ * @param[in] path File to read.
+ * @param[out] error Message with file and line of the first problem.
+ * @param[in] errorSize Size of error.
+ * @return true when the file was read and validated.
+ */
+bool layout_load(struct Layout* layout, const char* path, char* error, size_t errorSize);
+
+/**
+ * @brief Fill a layout with the built-in 13-room museum.
+ * @param[out] layout Layout to fill.
+ * @return false when memory ran out.
+ */
+bool layout_builtin(struct Layout* layout);
+
+/**
+ * @brief Fill in the default generator options: a 1000-room grid, seed 1.
+ * @param[out] options Options to reset.
+ */
+void layout_gen_defaults(struct LayoutGenOptions* options);
+
+/**
+ * @brief Parse a generator spec such as "shape=floors,rooms=100000,seed=7".
+ *
+ * Keys are shape (grid, wings, small-world, floors), rooms, seed, extra,
+ * skew, branching, floors, stairwells, exit (first, center, random) and
+ * threads. Keys not given keep their current value.
+ *
+ * @param[in] spec Comma-separated key=value list.
+ * @param[in,out] options Options to update.
+ * @param[out] error Message for the first bad key or value.
+ * @param[in] errorSize Size of error.
+ * @return false on a bad spec.
+ */
+bool layout_gen_parse(const char* spec, struct LayoutGenOptions* options, char* error, size_t errorSize);
+
+/**
+ * @brief Generate a connected layout in parallel.
+ * @param[out] layout Layout to fill; empty on failure.
+ * @param[in] options Generator parameters.
+ * @return false when the options are out of range or memory ran out.
+ */
+bool layout_generate(struct Layout* layout, const struct LayoutGenOptions* options);
+
+/**
+ * @brief Name of a shape.
+ * @param[in] shape Shape value.
+ * @return Static string such as "grid"; "unknown" when out of range.
+ */
+const char* layout_shape_to_string(enum LayoutShape shape);
+
+#endif // LAYOUT_H
@@ -0,0 +1,535 @@
+#define _GNU_SOURCE
+#include "lock.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Spins before a ticket/MCS waiter yields the CPU, and before a futex waiter parks.
+#define LOCK_SPIN_LIMIT 128
+#define LOCK_PROFILE_CHUNK 1024 // Profiles per shared mapping
+
+// Profiles are handed out from chunks that never move, so a lock's pointer stays valid
+struct LockProfileChunk {
+    struct LockProfileChunk* next;
+    int used;
+    struct LockProfile entries[LOCK_PROFILE_CHUNK];
+};
+
+static enum LockBackend selected_backend = LOCK_BACKEND_COUNT;
+static bool process_shared = false;
+static _Thread_local unsigned long thread_acquisitions = 0;
+static bool profiling = false;
+static struct LockProfileChunk* profile_chunks = NULL; // Newest first
+
+static _Thread_local struct McsNode mcs_nodes[LOCK_MCS_NODES];
+static _Thread_local unsigned mcs_in_use = 0;
+
+static const char* const backend_names[LOCK_BACKEND_COUNT] = {
+    "sem", "pthread", "ticket", "futex", "mcs"
+};
+
+static inline void cpu_relax(void){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/**
+ * @brief spin politely, giving the cpu away once the spin budget is gone
+ *
+ * @param[in,out] spins spin counter owned by the caller
+ */
+static inline void spin_wait(int* spins){
+    if (++(*spins) < LOCK_SPIN_LIMIT){
+        cpu_relax();
+    } else {
+        *spins = 0;
+        sched_yield();
+    }
+}
+
+void lock_backend_set(enum LockBackend backend){
+    if (backend < LOCK_BACKEND_COUNT){
+        selected_backend = backend;
+    }
+}
+
+enum LockBackend lock_backend_get(void){
+    if (selected_backend == LOCK_BACKEND_COUNT){
+        enum LockBackend fallback = LOCK_SEM;
+        lock_backend_from_string(HEIST_LOCK_DEFAULT, &fallback);
+        selected_backend = fallback;
+    }
+    return selected_backend;
+}
+
+bool lock_backend_from_string(const char* name, enum LockBackend* backend){
+    if (!name){
+        return false;
+    }
+    for (int i = 0; i < LOCK_BACKEND_COUNT; i++){
+        if (strcmp(name, backend_names[i]) == 0){
+            *backend = (enum LockBackend)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* lock_backend_to_string(enum LockBackend backend){
+    if (backend < LOCK_BACKEND_COUNT){
+        return backend_names[backend];
+    }
+    return "unknown";
+}
+
+void lock_set_process_shared(bool shared){
+    process_shared = shared;
+}
+
+bool lock_backend_process_safe(enum LockBackend backend){
+    return backend < LOCK_BACKEND_COUNT && backend != LOCK_MCS;
+}
+
+unsigned long lock_thread_acquisitions(void){
+    return thread_acquisitions;
+}
+
+// ---- futex helpers ----
+// private futexes skip the shared hash lookup, but only match within one process
+static void futex_wait(atomic_int* addr, int expected, bool shared){
+    syscall(SYS_futex, addr, shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_int* addr, bool shared){
+    syscall(SYS_futex, addr, shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// futex word: 0 = unlocked, 1 = locked, 2 = locked with possible sleepers
+static void futex_lock_acquire(atomic_int* word, bool shared){
+    int c = 0;
+    if (atomic_compare_exchange_strong(word, &c, 1)){
+        return;
+    }
+
+    for (int i = 0; i < LOCK_SPIN_LIMIT; i++){
+        c = 0;
+        if (atomic_load_explicit(word, memory_order_relaxed) == 0 &&
+            atomic_compare_exchange_weak(word, &c, 1)){
+            return;
+        }
+        cpu_relax();
+    }
+
+    c = atomic_exchange(word, 2);
+    while (c != 0){
+        futex_wait(word, 2, shared);
+        c = atomic_exchange(word, 2);
+    }
+}
+
+static void futex_lock_release(atomic_int* word, bool shared){
+    if (atomic_fetch_sub(word, 1) != 1){
+        atomic_store(word, 0);
+        futex_wake(word, shared);
+    }
+}
+
+// ---- MCS helpers ----
+/**
+ * @brief take a free queue node for the calling thread
+ *
+ * nodes come from the thread's LOCK_MCS_NODES slots; a thread nesting more
+ * MCS locks than that gets a heap node, and aborts if even that fails
+ *
+ * @return node owned by the caller until mcs_node_put
+ */
+static struct McsNode* mcs_node_get(void){
+    for (int i = 0; i < LOCK_MCS_NODES; i++){
+        if (!(mcs_in_use & (1u << i))){
+            mcs_in_use |= (1u << i);
+            return &mcs_nodes[i];
+        }
+    }
+
+    struct McsNode* node = malloc(sizeof(struct McsNode));
+    if (!node){
+        fprintf(stderr, "MCS lock: more than %d locks nested on one thread and no memory for another node\n",
+                LOCK_MCS_NODES);
+        abort();
+    }
+    return node;
+}
+
+static void mcs_node_put(struct McsNode* node){
+    uintptr_t at = (uintptr_t)node - (uintptr_t)mcs_nodes;
+    if (at < sizeof(mcs_nodes)){
+        mcs_in_use &= ~(1u << (unsigned)(node - mcs_nodes));
+    } else {
+        free(node);
+    }
+}
+
+static void mcs_lock_acquire(struct Lock* lock){
+    struct McsNode* node = mcs_node_get();
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+
+    struct McsNode* prev = atomic_exchange(&lock->mcs.tail, node);
+    if (prev){
+        atomic_store_explicit(&prev->next, node, memory_order_release);
+        int spins = 0;
+        while (atomic_load_explicit(&node->locked, memory_order_acquire)){
+            spin_wait(&spins);
+        }
+    }
+
+    lock->mcs.owner = node;
+}
+
+static bool mcs_lock_try_acquire(struct Lock* lock){
+    struct McsNode* node = mcs_node_get();
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+
+    struct McsNode* expected = NULL;
+    if (!atomic_compare_exchange_strong(&lock->mcs.tail, &expected, node)){
+        mcs_node_put(node);
+        return false;
+    }
+    lock->mcs.owner = node;
+    return true;
+}
+
+static void mcs_lock_release(struct Lock* lock){
+    struct McsNode* node = lock->mcs.owner;
+    struct McsNode* next = atomic_load_explicit(&node->next, memory_order_acquire);
+
+    if (!next){
+        struct McsNode* expected = node;
+        if (atomic_compare_exchange_strong(&lock->mcs.tail, &expected, NULL)){
+            mcs_node_put(node);
+            return;
+        }
+        // A waiter swapped itself in but has not linked to us yet
+        int spins = 0;
+        while (!(next = atomic_load_explicit(&node->next, memory_order_acquire))){
+            spin_wait(&spins);
+        }
+    }
+
+    atomic_store_explicit(&next->locked, 0, memory_order_release);
+    mcs_node_put(node);
+}
+
+// ---- backends ----
+/**
+ * @brief block on the lock's backend without counting or profiling
+ *
+ * @param[in,out] lock lock to acquire
+ */
+static void raw_acquire(struct Lock* lock){
+    switch (lock->backend){
+        case LOCK_SEM:
+            sem_wait(&lock->sem);
+            break;
+        case LOCK_PTHREAD:
+            pthread_mutex_lock(&lock->mtx);
+            break;
+        case LOCK_TICKET: {
+            unsigned mine = atomic_fetch_add_explicit(&lock->ticket.next, 1, memory_order_relaxed);
+            int spins = 0;
+            while (atomic_load_explicit(&lock->ticket.serving, memory_order_acquire) != mine){
+                spin_wait(&spins);
+            }
+            break;
+        }
+        case LOCK_FUTEX:
+            futex_lock_acquire(&lock->futex, lock->shared);
+            break;
+        case LOCK_MCS:
+            mcs_lock_acquire(lock);
+            break;
+    }
+}
+
+/**
+ * @brief try the lock's backend once without counting or profiling
+ *
+ * @param[in,out] lock lock to acquire
+ *
+ * @return true when the lock was free and is now held
+ */
+static bool raw_try_acquire(struct Lock* lock){
+    bool taken = false;
+
+    switch (lock->backend){
+        case LOCK_SEM:
+            taken = sem_trywait(&lock->sem) == 0;
+            break;
+        case LOCK_PTHREAD:
+            taken = pthread_mutex_trylock(&lock->mtx) == 0;
+            break;
+        case LOCK_TICKET: {
+            // only take the next ticket if it would be served right away
+            unsigned serving = atomic_load_explicit(&lock->ticket.serving, memory_order_acquire);
+            taken = atomic_compare_exchange_strong_explicit(&lock->ticket.next, &serving, serving + 1,
+                                                            memory_order_acquire, memory_order_relaxed);
+            break;
+        }
+        case LOCK_FUTEX: {
+            int c = 0;
+            taken = atomic_compare_exchange_strong(&lock->futex, &c, 1);
+            break;
+        }
+        case LOCK_MCS:
+            taken = mcs_lock_try_acquire(lock);
+            break;
+    }
+    return taken;
+}
+
+/**
+ * @brief release the lock's backend without profiling
+ *
+ * @param[in,out] lock lock to release
+ */
+static void raw_release(struct Lock* lock){
+    switch (lock->backend){
+        case LOCK_SEM:
+            sem_post(&lock->sem);
+            break;
+        case LOCK_PTHREAD:
+            pthread_mutex_unlock(&lock->mtx);
+            break;
+        case LOCK_TICKET: {
+            unsigned serving = atomic_load_explicit(&lock->ticket.serving, memory_order_relaxed);
+            atomic_store_explicit(&lock->ticket.serving, serving + 1, memory_order_release);
+            break;
+        }
+        case LOCK_FUTEX:
+            futex_lock_release(&lock->futex, lock->shared);
+            break;
+        case LOCK_MCS:
+            mcs_lock_release(lock);
+            break;
+    }
+}
+
+// ---- contention profiling ----
+/**
+ * @brief monotonic clock for wait and hold times
+ *
+ * @return nanoseconds since an arbitrary start
+ */
+static unsigned long long profile_now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+void lock_profile_enable(bool enabled){
+    profiling = enabled;
+}
+
+bool lock_profile_enabled(void){
+    return profiling;
+}
+
+void lock_profile_attach(struct Lock* lock, const char* kind, const char* name){
+    if (!profiling){
+        return;
+    }
+
+    if (!profile_chunks || profile_chunks->used == LOCK_PROFILE_CHUNK){
+        // shared so forked guard processes count into the parent's profiles
+        struct LockProfileChunk* chunk = mmap(NULL, sizeof(struct LockProfileChunk), PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (chunk == MAP_FAILED){
+            return;
+        }
+        chunk->next = profile_chunks;
+        chunk->used = 0;
+        profile_chunks = chunk;
+    }
+
+    struct LockProfile* profile = &profile_chunks->entries[profile_chunks->used++];
+    memset(profile, 0, sizeof(*profile));
+    strncpy(profile->kind, kind, LOCK_PROFILE_KIND - 1);
+    strncpy(profile->name, name, LOCK_PROFILE_NAME - 1);
+    lock->profile = profile;
+}
+
+/**
+ * @brief order profiles by total wait, longest first, for qsort
+ *
+ * @param[in] a pointer to a profile pointer
+ * @param[in] b pointer to a profile pointer
+ *
+ * @return negative when a ranks before b
+ */
+static int profile_wait_order(const void* a, const void* b){
+    const struct LockProfile* pa = *(struct LockProfile* const*)a;
+    const struct LockProfile* pb = *(struct LockProfile* const*)b;
+    if (pa->waitNs != pb->waitNs){
+        return pa->waitNs < pb->waitNs ? 1 : -1;
+    }
+    return pa->acquisitions < pb->acquisitions ? 1 : (pa->acquisitions > pb->acquisitions ? -1 : 0);
+}
+
+struct LockProfile** lock_profile_ranked(int* count){
+    int total = 0;
+    for (struct LockProfileChunk* chunk = profile_chunks; chunk; chunk = chunk->next){
+        total += chunk->used;
+    }
+    *count = total;
+    if (total == 0){
+        return NULL;
+    }
+
+    struct LockProfile** list = malloc((size_t)total * sizeof(*list));
+    if (!list){
+        *count = 0;
+        return NULL;
+    }
+    int at = 0;
+    for (struct LockProfileChunk* chunk = profile_chunks; chunk; chunk = chunk->next){
+        for (int i = 0; i < chunk->used; i++){
+            list[at++] = &chunk->entries[i];
+        }
+    }
+    qsort(list, (size_t)total, sizeof(*list), profile_wait_order);
+    return list;
+}
+
+/**
+ * @brief record an acquisition in the lock's profile and start the hold timer
+ *
+ * @param[in,out] profile profile of the lock the caller now holds
+ * @param[in] contended the lock was taken when the caller first tried
+ * @param[in] waited nanoseconds spent waiting, 0 when uncontended
+ */
+static void profile_acquired(struct LockProfile* profile, bool contended, unsigned long long waited){
+    // the lock is held from here on, so plain updates are safe
+    profile->acquisitions++;
+    if (contended){
+        profile->contended++;
+        profile->waitNs += waited;
+        if (waited > profile->maxWaitNs){
+            profile->maxWaitNs = waited;
+        }
+    }
+    profile->heldSince = profile_now_ns();
+}
+
+/**
+ * @brief block on a profiled lock, timing the wait
+ *
+ * @param[in,out] lock lock with a profile
+ * @param[in] tried the caller already failed a try, so the wait is contended without trying again
+ */
+static void profiled_acquire(struct Lock* lock, bool tried){
+    if (!tried && raw_try_acquire(lock)){
+        profile_acquired(lock->profile, false, 0);
+        return;
+    }
+    unsigned long long start = profile_now_ns();
+    raw_acquire(lock);
+    profile_acquired(lock->profile, true, profile_now_ns() - start);
+}
+
+// ---- public interface ----
+void lock_init(struct Lock* lock){
+    memset(lock, 0, sizeof(*lock));
+    lock->backend = (unsigned char)lock_backend_get();
+    lock->shared = process_shared;
+
+    switch (lock->backend){
+        case LOCK_SEM:
+            sem_init(&lock->sem, lock->shared, 1);
+            break;
+        case LOCK_PTHREAD: {
+            pthread_mutexattr_t attr;
+            pthread_mutexattr_init(&attr);
+#ifdef PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
+            pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+#endif
+            if (lock->shared){
+                pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+            }
+            pthread_mutex_init(&lock->mtx, &attr);
+            pthread_mutexattr_destroy(&attr);
+            break;
+        }
+        case LOCK_TICKET:
+            atomic_init(&lock->ticket.next, 0);
+            atomic_init(&lock->ticket.serving, 0);
+            break;
+        case LOCK_FUTEX:
+            atomic_init(&lock->futex, 0);
+            break;
+        case LOCK_MCS:
+            atomic_init(&lock->mcs.tail, NULL);
+            lock->mcs.owner = NULL;
+            break;
+    }
+}
+
+void lock_destroy(struct Lock* lock){
+    // the profile stays listed for lock_profile_ranked
+    lock->profile = NULL;
+
+    switch (lock->backend){
+        case LOCK_SEM:
+            sem_destroy(&lock->sem);
+            break;
+        case LOCK_PTHREAD:
+            pthread_mutex_destroy(&lock->mtx);
+            break;
+        default:
+            break;
+    }
+}
+
+void lock_acquire(struct Lock* lock){
+    thread_acquisitions++;
+    if (__builtin_expect(lock->profile != NULL, 0)){
+        profiled_acquire(lock, false);
+        return;
+    }
+    raw_acquire(lock);
+}
+
+void lock_acquire_contended(struct Lock* lock){
+    thread_acquisitions++;
+    if (__builtin_expect(lock->profile != NULL, 0)){
+        profiled_acquire(lock, true);
+        return;
+    }
+    raw_acquire(lock);
+}
+
+bool lock_try_acquire(struct Lock* lock){
+    if (!raw_try_acquire(lock)){
+        return false;
+    }
+    thread_acquisitions++;
+    if (__builtin_expect(lock->profile != NULL, 0)){
+        profile_acquired(lock->profile, false, 0);
+    }
+    return true;
+}
+
+void lock_release(struct Lock* lock){
+    if (__builtin_expect(lock->profile != NULL, 0)){
+        lock->profile->holdNs += profile_now_ns() - lock->profile->heldSince;
+    }
+    raw_release(lock);
+}
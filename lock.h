@@ -0,0 +1,205 @@
+#ifndef LOCK_H
+#define LOCK_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+#include <pthread.h>
+
+// Backend used by lock_init when nothing else was selected. Override at build
+// time with `make LOCK=ticket` (or -DHEIST_LOCK_DEFAULT="ticket").
+#ifndef HEIST_LOCK_DEFAULT
+#define HEIST_LOCK_DEFAULT "sem"
+#endif
+
+// MCS queue nodes each thread keeps ready, enough for the nested locks it
+// may hold (or wait on) at once. Deeper nesting takes a node from the heap
+// for every extra lock and aborts if malloc fails.
+#define LOCK_MCS_NODES 8
+
+#define LOCK_PROFILE_KIND 8
+#define LOCK_PROFILE_NAME 64
+
+enum LockBackend {
+    LOCK_SEM = 0,      // sem_t used as a binary semaphore (original behaviour)
+    LOCK_PTHREAD = 1,  // pthread_mutex_t, adaptive when available
+    LOCK_TICKET = 2,   // FIFO ticket spinlock
+    LOCK_FUTEX = 3,    // spin briefly, then park on a futex
+    LOCK_MCS = 4,      // MCS queue lock, each waiter spins on its own node
+    LOCK_BACKEND_COUNT
+};
+
+struct McsNode {
+    _Atomic(struct McsNode*) next;
+    atomic_int locked;
+};
+
+// Contention counters for one lock. Every field is written by the thread
+// holding the lock, so the lock itself is what keeps them consistent.
+struct LockProfile {
+    char kind[LOCK_PROFILE_KIND];   // What the lock protects, e.g. "room"
+    char name[LOCK_PROFILE_NAME];
+    unsigned long acquisitions;
+    unsigned long contended;        // Acquisitions that found the lock taken
+    unsigned long long waitNs;      // Time spent waiting in those acquisitions
+    unsigned long long holdNs;      // Time between acquisition and release
+    unsigned long long maxWaitNs;
+    unsigned long long heldSince;   // Clock reading when the current holder got the lock
+};
+
+struct Lock {
+    unsigned char backend; // Fixed at lock_init so a lock never changes type mid-run
+    unsigned char shared;  // Usable from several processes; also fixed at lock_init
+    struct LockProfile* profile; // NULL unless lock profiling was on when the lock was attached
+    union {
+        sem_t sem;
+        pthread_mutex_t mtx;
+        struct {
+            atomic_uint next;
+            atomic_uint serving;
+        } ticket;
+        atomic_int futex;
+        struct {
+            _Atomic(struct McsNode*) tail;
+            struct McsNode* owner; // Only touched by the thread holding the lock
+        } mcs;
+    };
+};
+
+/**
+ * @brief Select the backend used by every later lock_init call.
+ * @param[in] backend Backend to use.
+ */
+void lock_backend_set(enum LockBackend backend);
+
+/**
+ * @brief Return the backend currently used by lock_init.
+ * @return The selected backend.
+ */
+enum LockBackend lock_backend_get(void);
+
+/**
+ * @brief Parse a backend name such as "sem", "pthread", "ticket", "futex" or "mcs".
+ * @param[in] name Backend name.
+ * @param[out] backend Parsed backend, untouched on failure.
+ * @return true when the name was recognised.
+ */
+bool lock_backend_from_string(const char* name, enum LockBackend* backend);
+
+/**
+ * @brief Return the lowercase name of a backend.
+ * @param[in] backend Backend value.
+ * @return Static string such as "ticket"; "unknown" when out of range.
+ */
+const char* lock_backend_to_string(enum LockBackend backend);
+
+/**
+ * @brief Make every later lock_init produce locks that work across processes.
+ *
+ * Semaphores are created with pshared=1, pthread mutexes with
+ * PTHREAD_PROCESS_SHARED and futexes use the shared (non-private) wait
+ * queue. Ticket locks need nothing extra. MCS locks cannot be shared because
+ * waiters spin on nodes in their own thread's memory.
+ *
+ * @param[in] shared true for process-shared locks.
+ */
+void lock_set_process_shared(bool shared);
+
+/**
+ * @brief Check whether a backend can be shared between processes.
+ * @param[in] backend Backend value.
+ * @return false for MCS.
+ */
+bool lock_backend_process_safe(enum LockBackend backend);
+
+/**
+ * @brief Number of lock acquisitions made by the calling thread so far.
+ * @return Per-thread acquisition counter.
+ */
+unsigned long lock_thread_acquisitions(void);
+
+/**
+ * @brief Turn contention profiling on or off for locks attached afterwards.
+ *
+ * Off by default. A lock without a profile pays one predictable branch per
+ * acquire and release; a profiled one reads the clock on acquire and
+ * release, and twice more when it has to wait.
+ *
+ * @param[in] enabled true to profile locks passed to lock_profile_attach.
+ */
+void lock_profile_enable(bool enabled);
+
+/**
+ * @brief Check whether lock profiling is on.
+ * @return true after lock_profile_enable(true).
+ */
+bool lock_profile_enabled(void);
+
+/**
+ * @brief Give a lock a named profile when profiling is on.
+ *
+ * Profiles live in shared anonymous memory, so guard processes forked
+ * afterwards add to the same counters. Call before any thread uses the lock.
+ *
+ * @param[in,out] lock Initialized lock.
+ * @param[in] kind Short label for what the lock protects, such as "room".
+ * @param[in] name Name of the protected object.
+ */
+void lock_profile_attach(struct Lock* lock, const char* kind, const char* name);
+
+/**
+ * @brief List every profile ranked by total wait time, longest first.
+ *
+ * Read once the threads using the locks have finished.
+ *
+ * @param[out] count Number of profiles.
+ * @return Array of count profiles for the caller to free, NULL when there are none.
+ */
+struct LockProfile** lock_profile_ranked(int* count);
+
+/**
+ * @brief Initialize an unlocked lock using the selected backend.
+ * @param[out] lock Lock to initialize.
+ */
+void lock_init(struct Lock* lock);
+
+/**
+ * @brief Release any resources held by a lock.
+ * @param[in,out] lock Lock to destroy; must not be held.
+ */
+void lock_destroy(struct Lock* lock);
+
+/**
+ * @brief Block until the calling thread owns the lock.
+ * @param[in,out] lock Lock to acquire.
+ */
+void lock_acquire(struct Lock* lock);
+
+/**
+ * @brief Block until the lock is free, after the caller's own try failed.
+ *
+ * Same as lock_acquire, but a profiled lock counts the acquisition as
+ * contended and times the whole wait instead of trying again first, so the
+ * failed try is not lost when the lock frees up in between.
+ *
+ * @param[in,out] lock Lock to acquire.
+ */
+void lock_acquire_contended(struct Lock* lock);
+
+/**
+ * @brief Take the lock only if nobody holds it or waits for it.
+ *
+ * Never blocks. A ticket or MCS lock with waiters queued counts as taken.
+ *
+ * @param[in,out] lock Lock to acquire.
+ * @return true when the calling thread now owns the lock.
+ */
+bool lock_try_acquire(struct Lock* lock);
+
+/**
+ * @brief Release a lock owned by the calling thread.
+ * @param[in,out] lock Lock to release.
+ */
+void lock_release(struct Lock* lock);
+
+#endif // LOCK_H
@@ -5,32 +5,318 @@
 #include "helpers.h"
 #include <pthread.h>
 
-void* thief_thread(void* arg) {
-    struct Thief* thief = arg;
-    while (thief->active) {
-        thief_update(thief);
+#define LOCK_REPORT_TOP 10   // Locks listed in the contention summary; the CSV has all of them
+
+struct RosterEntry {
+    char name[MAX_GUARD_NAME];
+    int id;
+};
+
+/**
+ * @brief append a guard to the roster read at start-up
+ *
+ * grows the roster using arraylist logic
+ *
+ * @param[in,out] roster roster array, reallocated as needed
+ * @param[in,out] count number of entries in use
+ * @param[in,out] max allocated capacity
+ * @param[in] name guard name
+ * @param[in] id guard id
+ */
+static void roster_append(struct RosterEntry** roster, int* count, int* max, const char* name, int id) {
+    if (*count >= *max) {
+        int resize = (*max == 0 ? 8 : 2 * *max);
+        struct RosterEntry* newArr = realloc(*roster, resize * sizeof(struct RosterEntry));
+        if (!newArr) {
+            return;
+        }
+        *roster = newArr;
+        *max = resize;
+    }
+
+    strncpy((*roster)[*count].name, name, MAX_GUARD_NAME);
+    (*roster)[*count].name[MAX_GUARD_NAME - 1] = '\0';
+    (*roster)[*count].id = id;
+    (*count)++;
+}
+
+/**
+ * @brief print command line usage
+ *
+ * @param[in] prog program name from argv
+ */
+static void print_usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--lock sem|pthread|ticket|futex|mcs] [--layout FILE | --generate SPEC] [--guards N] [--room-cap N]\n"
+            "          [--engine threads|sharded] [--workers K] [--processes P] [--shm-size MB]\n"
+            "          [--thieves N] [--catalogue FILE] [--strategy random|lrv|frontier|pursuit] [--ignore-congestion]\n"
+            "          [--pin CPUS] [--monitor MS] [--lock-stats FILE] [--quiet]\n"
+            "  --lock NAME  lock backend for room locks (default %s)\n"
+            "  --layout FILE load rooms and doors from a layout file instead of the built-in museum\n"
+            "  --generate SPEC generate a museum, e.g. shape=floors,rooms=100000,seed=7\n"
+            "               (shape grid|wings|small-world|floors, rooms, seed, extra, skew,\n"
+            "                branching, floors, stairwells, exit first|center|random, threads)\n"
+            "  --guards N   add N generated guards instead of reading names from stdin\n"
+            "  --room-cap N turn guards away from rooms already holding N guards (default unlimited)\n"
+            "  --engine NAME threads runs one thread per guard (default); sharded splits the\n"
+            "               museum into regions each run by one worker without room locks\n"
+            "  --workers K  regions and workers for the sharded engine (default one per CPU)\n"
+            "  --processes P run the guards in P forked processes sharing the museum in shared memory\n"
+            "  --shm-size MB address space reserved for the shared museum (default %d)\n"
+            "  --thieves N  let N thieves loose at once, each with its own case (default 1)\n"
+            "  --catalogue FILE read evidence types and thief profiles from FILE instead of the built-in set\n"
+            "  --strategy NAME how guards explore: random (default), lrv (least recently visited),\n"
+            "               frontier (nearest unscanned room) or pursuit (towards recent drops)\n"
+            "  --ignore-congestion choose rooms without looking at occupancy or lock waits\n"
+            "  --pin CPUS   pin the thieves, guards or region workers to CPUS, e.g. 0-7,16-23 or all\n"
+            "  --monitor MS print a live guard summary to stderr every MS milliseconds\n"
+            "  --lock-stats FILE count acquisitions, wait and hold time for every room lock,\n"
+            "               print the most waited-on ones and write the full ranking to FILE as CSV\n"
+            "  --quiet      disable CSV logs and per-action console output\n",
+            prog, HEIST_LOCK_DEFAULT, SHM_DEFAULT_MB);
+}
+
+/**
+ * @brief write a CSV field, quoted when it holds a comma or a quote
+ *
+ * @param[in,out] file CSV file
+ * @param[in] text field value
+ */
+static void csv_field(FILE* file, const char* text) {
+    if (!strpbrk(text, ",\"")) {
+        fputs(text, file);
+        return;
+    }
+    fputc('"', file);
+    for (const char* c = text; *c; c++) {
+        if (*c == '"') {
+            fputc('"', file);
+        }
+        fputc(*c, file);
     }
-    return NULL;
+    fputc('"', file);
 }
 
-void* guard_thread(void* arg) {
-    struct Guard* guard = arg;
-    while (guard->active) {
-        guard_take_turn(guard);
+/**
+ * @brief print the most waited-on locks and write every lock's counters to a CSV
+ *
+ * @param[in] csvPath file for the full ranking
+ */
+static void report_lock_profile(const char* csvPath) {
+    int count = 0;
+    struct LockProfile** ranked = lock_profile_ranked(&count);
+
+    printf("\nLock Contention (%d locks, ranked by total wait):\n", count);
+    printf("----------------------------------------------------\n");
+    printf("  %-6s %-24s %12s %10s %12s %12s %12s\n", "kind", "name", "acquired", "contended", "wait(us)",
+           "hold(us)", "max wait(us)");
+    for (int i = 0; i < count && i < LOCK_REPORT_TOP; i++) {
+        struct LockProfile* p = ranked[i];
+        printf("  %-6s %-24.24s %12lu %10lu %12.1f %12.1f %12.1f\n", p->kind, p->name, p->acquisitions, p->contended,
+               (double)p->waitNs / 1e3, (double)p->holdNs / 1e3, (double)p->maxWaitNs / 1e3);
+    }
+
+    FILE* file = fopen(csvPath, "w");
+    if (!file) {
+        fprintf(stderr, "Could not write %s\n", csvPath);
+        free(ranked);
+        return;
+    }
+    fprintf(file, "rank,kind,name,acquisitions,contended,wait_ns,hold_ns,max_wait_ns,mean_wait_ns,mean_hold_ns\n");
+    for (int i = 0; i < count; i++) {
+        struct LockProfile* p = ranked[i];
+        fprintf(file, "%d,%s,", i + 1, p->kind);
+        csv_field(file, p->name);
+        fprintf(file, ",%lu,%lu,%llu,%llu,%llu,%.1f,%.1f\n", p->acquisitions, p->contended, p->waitNs, p->holdNs,
+                p->maxWaitNs, p->contended > 0 ? (double)p->waitNs / (double)p->contended : 0.0,
+                p->acquisitions > 0 ? (double)p->holdNs / (double)p->acquisitions : 0.0);
     }
-    return NULL;
+    fclose(file);
+    printf("- Full ranking written to %s\n", csvPath);
+    free(ranked);
+}
+
+/**
+ * @brief name the profile a case identifies
+ *
+ * @param[in] found evidence collected for the case
+ *
+ * @return profile name, or "N/A" while more than one profile fits
+ */
+static const char* guess_profile(EvidenceMask found) {
+    int profile;
+    return evidence_identify(found, &profile) ? thief_to_string(profile) : "N/A";
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    int autoGuards = 0;
+    const char* layoutPath = NULL;
+    const char* generateSpec = NULL;
+    struct SimOptions options = { 0 };
+    size_t shmMb = SHM_DEFAULT_MB;
+    int thiefCount = 1;
+    bool quiet = false;
+    const char* lockStatsPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--lock") == 0 && i + 1 < argc) {
+            enum LockBackend backend;
+            if (!lock_backend_from_string(argv[++i], &backend)) {
+                fprintf(stderr, "Unknown lock backend: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 1;
+            }
+            lock_backend_set(backend);
+        } else if (strcmp(argv[i], "--layout") == 0 && i + 1 < argc) {
+            layoutPath = argv[++i];
+        } else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+            generateSpec = argv[++i];
+        } else if (strcmp(argv[i], "--guards") == 0 && i + 1 < argc) {
+            autoGuards = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--room-cap") == 0 && i + 1 < argc) {
+            room_set_guard_cap(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            const char* engine = argv[++i];
+            if (strcmp(engine, "threads") == 0) {
+                options.engine = ENGINE_THREADS;
+            } else if (strcmp(engine, "sharded") == 0) {
+                options.engine = ENGINE_SHARDED;
+            } else {
+                fprintf(stderr, "Unknown engine: %s\n", engine);
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            options.workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--processes") == 0 && i + 1 < argc) {
+            options.processes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shm-size") == 0 && i + 1 < argc) {
+            shmMb = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--thieves") == 0 && i + 1 < argc) {
+            thiefCount = atoi(argv[++i]);
+            if (thiefCount < 1 || thiefCount > UINT16_MAX) {
+                fprintf(stderr, "--thieves must be between 1 and %d\n", UINT16_MAX);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--catalogue") == 0 && i + 1 < argc) {
+            char error[512];
+            if (!catalogue_load(argv[++i], error, sizeof(error))) {
+                fprintf(stderr, "Invalid catalogue: %s\n", error);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc) {
+            enum GuardStrategy strategy;
+            if (!strategy_from_string(argv[++i], &strategy)) {
+                fprintf(stderr, "Unknown strategy: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 1;
+            }
+            strategy_set(strategy);
+        } else if (strcmp(argv[i], "--ignore-congestion") == 0) {
+            strategy_set_congestion_aware(false);
+        } else if (strcmp(argv[i], "--pin") == 0 && i + 1 < argc) {
+            char error[128];
+            if (!affinity_parse(argv[++i], error, sizeof(error))) {
+                fprintf(stderr, "Invalid --pin: %s\n", error);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--lock-stats") == 0 && i + 1 < argc) {
+            lockStatsPath = argv[++i];
+            lock_profile_enable(true);
+        } else if (strcmp(argv[i], "--monitor") == 0 && i + 1 < argc) {
+            options.monitorMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            log_set_enabled(false);
+            quiet = true;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // shared state has to exist before the first room or lock is created
+    if (options.processes > 1) {
+        char error[256];
+        if (options.engine == ENGINE_SHARDED) {
+            fprintf(stderr, "--processes cannot be combined with the sharded engine\n");
+            return 1;
+        }
+        if (!lock_backend_process_safe(lock_backend_get())) {
+            fprintf(stderr, "The %s lock cannot be shared between processes\n", lock_backend_to_string(lock_backend_get()));
+            return 1;
+        }
+        if (!shm_arena_create(shmMb << 20, error, sizeof(error))) {
+            fprintf(stderr, "Could not create the shared museum: %s\n", error);
+            return 1;
+        }
+        atexit(shm_arena_destroy);
+        lock_set_process_shared(true);
+    }
+
     // create museum
     struct Museum museum;
     museum_init(&museum);
-    museum_populate_rooms(&museum);
+
+    if (layoutPath || generateSpec) {
+        struct Layout layout;
+        char error[512];
+        if (layoutPath && !layout_load(&layout, layoutPath, error, sizeof(error))) {
+            fprintf(stderr, "Invalid layout: %s\n", error);
+            museum_cleanup(&museum);
+            return 1;
+        }
+        if (generateSpec) {
+            struct LayoutGenOptions gen;
+            layout_gen_defaults(&gen);
+            if (!layout_gen_parse(generateSpec, &gen, error, sizeof(error))) {
+                fprintf(stderr, "Invalid generator spec: %s\n", error);
+                museum_cleanup(&museum);
+                return 1;
+            }
+            unsigned long long start = stats_now_ns();
+            if (!layout_generate(&layout, &gen)) {
+                fprintf(stderr, "Could not generate a %u room %s museum\n", gen.rooms, layout_shape_to_string(gen.shape));
+                museum_cleanup(&museum);
+                return 1;
+            }
+            printf("Generated a %s museum: %u rooms, %zu doors in %.3f s\n", layout_shape_to_string(gen.shape),
+                   layout_room_count(&layout), layout.doorCount, (double)(stats_now_ns() - start) / 1e9);
+        }
+        if (generateSpec && !layout_validate(&layout, error, sizeof(error))) {
+            fprintf(stderr, "Generated layout is invalid: %s\n", error);
+            layout_free(&layout);
+            museum_cleanup(&museum);
+            return 1;
+        }
+        bool built = museum_build(&museum, &layout);
+        layout_free(&layout);
+        if (!built) {
+            fprintf(stderr, "Could not allocate the rooms of the museum\n");
+            museum_cleanup(&museum);
+            return 1;
+        }
+    } else {
+        museum_populate_rooms(&museum);
+    }
+
+    // the whole roster is read first so the guard slab can be sized once
+    struct RosterEntry* roster = NULL;
+    int rosterCount = 0;
+    int rosterMax = 0;
+
+    // generated roster skips the prompt entirely
+    for (int i = 0; i < autoGuards; i++) {
+        char name[MAX_GUARD_NAME];
+        snprintf(name, sizeof(name), "Guard %d", i + 1);
+        roster_append(&roster, &rosterCount, &rosterMax, name, i + 1);
+    }
 
     // get user input
-    printf("Enter guard names and IDs (type 'done' when finished):\n");
+    if (autoGuards == 0) {
+        printf("Enter guard names and IDs (type 'done' when finished):\n");
+    }
 
-    while (1) {
+    while (autoGuards == 0) {
         char name[MAX_GUARD_NAME];
 
         printf("Enter guard name (or 'done' to finish): ");
@@ -52,27 +338,29 @@ int main() {
 
         int id = atoi(trimId);
 
-        museum_add_guard(&museum, name, id);
+        roster_append(&roster, &rosterCount, &rosterMax, name, id);
     }
 
-    thief_init(&museum.thief, &museum);
-
-    pthread_t thiefThread;
-    pthread_create(&thiefThread, NULL, thief_thread, &museum.thief);
-
-    pthread_t* guardThreads = malloc(sizeof(pthread_t) * museum.guardCount);
-    for (int i = 0; i < museum.guardCount; i++) {
-        pthread_create(&guardThreads[i], NULL, guard_thread, museum.guards[i]);
+    if (rosterCount > 0 && !museum_reserve_guards(&museum, rosterCount)) {
+        fprintf(stderr, "Could not allocate %d guards\n", rosterCount);
+        free(roster);
+        museum_cleanup(&museum);
+        return 1;
     }
 
-    pthread_join(thiefThread, NULL);
+    for (int i = 0; i < rosterCount; i++) {
+        museum_add_guard(&museum, roster[i].name, roster[i].id);
+    }
+    free(roster);
 
-    // wait for guards to finish
-    for (int i = 0; i < museum.guardCount; i++) {
-        pthread_join(guardThreads[i], NULL);
+    if (!museum_add_thieves(&museum, thiefCount)) {
+        fprintf(stderr, "Could not allocate %d thieves\n", thiefCount);
+        museum_cleanup(&museum);
+        return 1;
     }
 
-    free(guardThreads);
+    struct SimResult result;
+    sim_run(&museum, &options, &result);
 
     // display output
     printf("================================================\n");
@@ -80,23 +368,25 @@ int main() {
     printf("================================================\n");
 
     for (int i = 0; i < museum.guardCount; i++) {
-        struct Guard* guard = museum.guards[i];
-        const char* reason = exit_reason_to_string(guard->whyExit);
+        struct Guard* guard = &museum.guards[i];
+        struct GuardSnapshot snap;
+        guard_read_snapshot(guard, &snap);
+        const char* reason = exit_reason_to_string(snap.whyExit);
 
         printf("[%s] Guard %s (ID %d) exited because of [%s] (bored=%d stress=%d).\n",
-               (guard->whyExit == LR_OVERWHELMED) ? "✗" : " ",
-               guard->name, guard->id, reason, guard->boredom, guard->stress);
+               (snap.whyExit == LR_OVERWHELMED) ? "✗" : " ",
+               guard->name, guard->id, reason, snap.boredom, snap.stress);
     }
 
     printf("\nShared Case File Checklist:\n");
-    EvidenceByte collected = museum.casefile.collected;
+    EvidenceMask collected = casefile_collected(&museum.casefile);
 
-    const enum TamperType* tamperTypes;
-    int tamperCount = get_all_tamper_types(&tamperTypes);
+    int tamperCount = catalogue_type_count();
 
     for (int i = 0; i < tamperCount; i++) {
-        bool hasIt = (collected & tamperTypes[i]) != 0;
-        printf("  - [%s] %s\n", hasIt ? "✓" : " ", tamper_to_string(tamperTypes[i]));
+        EvidenceMask type = (EvidenceMask)1 << i;
+        bool hasIt = (collected & type) != 0;
+        printf("  - [%s] %s\n", hasIt ? "✓" : " ", tamper_to_string(type));
     }
 
     printf("\nVictory Results:\n");
@@ -104,32 +394,87 @@ int main() {
 
     int guardsWon = 0;
     for (int i = 0; i < museum.guardCount; i++) {
-        if (museum.guards[i]->whyExit == LR_CLUES) {
+        struct GuardSnapshot snap;
+        guard_read_snapshot(&museum.guards[i], &snap);
+        if (snap.whyExit == LR_CLUES) {
             guardsWon++;
         }
     }
 
     printf("- Guards exited after identifying the thief: %d/%d\n", guardsWon, museum.guardCount);
 
-    const enum ThiefProfile* thiefProfiles;
-    int thiefCount = get_all_thief_profiles(&thiefProfiles);
-    const char* guess = "N/A";
-
-    if (museum.casefile.solved) {
-        for (int i = 0; i < thiefCount; i++) {
-            if (((EvidenceByte)thiefProfiles[i] & collected) == (EvidenceByte)thiefProfiles[i]) {
-                guess = thief_to_string(thiefProfiles[i]);
-                break;
+    if (museum.thiefCount == 1) {
+        printf("- Thief Guess: %s (%d candidate profiles left)\n", guess_profile(casefile_case(&museum.casefile, 0)),
+               casefile_candidates(&museum.casefile, 0));
+        printf("- Actual Thief Type: %s\n", thief_to_string(museum.thieves[0].profile));
+    } else {
+        int right = 0;
+        for (int i = 0; i < museum.thiefCount; i++) {
+            struct Thief* thief = &museum.thieves[i];
+            EvidenceMask found = casefile_case(&museum.casefile, i);
+            const char* guess = guess_profile(found);
+            if (strcmp(guess, thief_to_string(thief->profile)) == 0) {
+                right++;
+            }
+            if (!quiet) {
+                printf("- Thief %d: guess %s, actually %s\n", thief->id, guess, thief_to_string(thief->profile));
             }
         }
+        printf("- Cases solved: %d/%d (%d identified correctly)\n",
+               casefile_solved_cases(&museum.casefile), museum.thiefCount, right);
     }
 
-    printf("- Thief Guess: %s\n", guess);
-    printf("- Actual Thief Type: %s\n", thief_to_string(museum.thief.type));
-
     bool thiefWins = (guardsWon == 0);
     printf("\nOverall Result: %s\n", thiefWins ? "Thief Wins!" : "Guards Win!");
 
+    printf("\nPerformance (%s locks, %s strategy):\n", lock_backend_to_string(lock_backend_get()),
+           strategy_to_string(strategy_get()));
+    printf("----------------------------------------------------\n");
+    printf("- Guard turns: %lu in %.3f s (%.0f turns/s)\n", result.turns, result.seconds,
+           result.seconds > 0 ? (double)result.turns / result.seconds : 0.0);
+    printf("- Turn latency: p50 %llu ns, p99 %llu ns, p99.9 %llu ns\n",
+           latency_hist_percentile(&result.turnLatency, 50.0),
+           latency_hist_percentile(&result.turnLatency, 99.0),
+           latency_hist_percentile(&result.turnLatency, 99.9));
+    printf("- Lock acquisitions: %lu\n", result.lockOps);
+    if (result.lockWaits > 0) {
+        printf("- Room lock waits: %lu, %.3f ms in total (%.0f ns each)\n", result.lockWaits,
+               (double)result.lockWaitNs / 1e6, (double)result.lockWaitNs / (double)result.lockWaits);
+    }
+    if (result.solved) {
+        printf("- Solved after %lu guard turns\n", result.solveTurns);
+    }
+    printf("- Move retries: %lu, aborted moves: %lu\n", result.moveRetries, result.moveAborts);
+    if (result.returns > 0) {
+        printf("- Returns to the Security Office: %lu (%.1f steps, %.1f lock acquisitions each)\n",
+               result.returns,
+               (double)result.returnSteps / (double)result.returns,
+               (double)result.returnLocks / (double)result.returns);
+    }
+    if (options.engine == ENGINE_SHARDED) {
+        printf("- Regions: %d (%lu cut doors, largest region %.2fx the average)\n",
+               result.regions, result.cutDoors, result.imbalance);
+        printf("- Cross-region handoffs: %lu, refused by a full queue: %lu\n", result.handoffs, result.queueFull);
+        if (result.aborted) {
+            printf("- Stopped early: the sharded engine ran out of memory\n");
+        }
+    }
+    if (affinity_enabled()) {
+        bool sharded = options.engine == ENGINE_SHARDED;
+        unsigned long base = sharded ? result.handoffs : result.lockOps;
+        printf("- Pinned to %d CPUs on %d NUMA nodes; cross-node %s: %lu (%.1f%%)\n",
+               affinity_cpu_count(), affinity_node_count(), sharded ? "handoffs" : "room locks", result.crossNode,
+               base > 0 ? 100.0 * (double)result.crossNode / (double)base : 0.0);
+    }
+    if (result.processes > 0) {
+        printf("- Guard processes: %d (%d failed), %.1f MB used in %s\n", result.processes, result.failedProcesses,
+               (double)shm_arena_used() / 1e6, shm_arena_name());
+    }
+
+    if (lockStatsPath) {
+        report_lock_profile(lockStatsPath);
+    }
+
     // cleanup museum
     museum_cleanup(&museum);
     return 0;
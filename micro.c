@@ -0,0 +1,416 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "defs.h"
+#include "helpers.h"
+
+#define MICRO_MAX_THREADS 64
+#define MICRO_MAX_THREAD_COUNTS 16
+#define MICRO_MASKS 1024       // Evidence masks cycled through by the evidence_is_valid_ghost loop
+#define MICRO_STACK_DEPTH 8    // Rooms pushed before each empty_roomstack
+
+// Every worker's results end up here, so the compiler cannot drop a loop as dead code
+static volatile unsigned long micro_sink;
+
+// State every worker of one measurement shares
+struct MicroShared {
+    struct Museum* museum;
+    int roomPool;                    // lock_rooms draws its pairs from the first roomPool rooms
+    const EvidenceMask* masks;       // MICRO_MASKS masks, about half of them profiles
+    unsigned long iterations;        // Operations each thread performs
+    pthread_barrier_t start;         // Workers and the main thread, so thread creation is not timed
+};
+
+struct MicroWorker {
+    pthread_t thread;
+    int index;
+    struct MicroShared* shared;
+    void (*loop)(struct MicroWorker* worker);
+    unsigned long long ns;           // Time this worker spent in its loop
+    unsigned long sink;              // Folded into micro_sink after the join
+};
+
+// One primitive measured in isolation
+struct MicroBench {
+    const char* name;
+    unsigned long iterations;        // Per thread at --scale 1, sized for roughly 0.1 s on one thread
+    void (*loop)(struct MicroWorker* worker);
+};
+
+/**
+ * @brief lock and unlock pairs of rooms that every thread draws from the same small pool
+ *
+ * @param[in,out] worker calling worker
+ */
+static void micro_lock_rooms(struct MicroWorker* worker) {
+    struct MicroShared* shared = worker->shared;
+    struct Room* rooms = shared->museum->rooms;
+    unsigned rng = 0x9E3779B9u * (unsigned)(worker->index + 1);
+
+    for (unsigned long i = 0; i < shared->iterations; i++) {
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+        int a = (int)(rng % (unsigned)shared->roomPool);
+        int b = (int)((rng >> 16) % (unsigned)(shared->roomPool - 1));
+        if (b >= a) {
+            b++;
+        }
+        lock_rooms(&rooms[a], &rooms[b]);
+        worker->sink += (unsigned long)atomic_load_explicit(&rooms[a].guardCount, memory_order_relaxed);
+        unlock_rooms(&rooms[a], &rooms[b]);
+    }
+}
+
+/**
+ * @brief push one room onto a private breadcrumb and pop it again
+ *
+ * @param[in,out] worker calling worker
+ */
+static void micro_push_pop(struct MicroWorker* worker) {
+    struct MicroShared* shared = worker->shared;
+    struct Room* rooms = shared->museum->rooms;
+    int roomCount = shared->museum->room_count;
+    struct RoomStack stack;
+    roomstack_init(&stack, rooms);
+
+    for (unsigned long i = 0; i < shared->iterations; i++) {
+        push(&stack, &rooms[i % (unsigned long)roomCount]);
+        worker->sink += (unsigned long)(pop(&stack) - rooms);
+    }
+    roomstack_free(&stack);
+}
+
+/**
+ * @brief fill a private breadcrumb with MICRO_STACK_DEPTH rooms and empty it
+ *
+ * @param[in,out] worker calling worker
+ */
+static void micro_empty_roomstack(struct MicroWorker* worker) {
+    struct MicroShared* shared = worker->shared;
+    struct Room* rooms = shared->museum->rooms;
+    struct RoomStack stack;
+    roomstack_init(&stack, rooms);
+
+    for (unsigned long i = 0; i < shared->iterations; i++) {
+        for (int d = 0; d < MICRO_STACK_DEPTH; d++) {
+            push(&stack, &rooms[d]);
+        }
+        worker->sink += stack.size;
+        empty_roomstack(&stack);
+    }
+    roomstack_free(&stack);
+}
+
+/**
+ * @brief add a guard to a private room and remove it again
+ *
+ * a second guard stays in the room so remove_guard takes its swap path
+ *
+ * @param[in,out] worker calling worker
+ */
+static void micro_add_remove_guard(struct MicroWorker* worker) {
+    struct MicroShared* shared = worker->shared;
+    struct Room* room = aligned_alloc(CACHE_LINE, sizeof(struct Room));
+    struct Guard* guards = aligned_alloc(CACHE_LINE, 2 * sizeof(struct Guard));
+    if (!room || !guards) {
+        free(room);
+        free(guards);
+        return;
+    }
+    room_init(room, "Bench Room", false);
+    memset(guards, 0, 2 * sizeof(struct Guard));
+    guards[0].roomSlot = -1;
+    guards[1].roomSlot = -1;
+
+    // the room is private to this thread, so the room lock the simulation holds is left out
+    for (unsigned long i = 0; i < shared->iterations; i++) {
+        add_guard(room, &guards[0]);
+        add_guard(room, &guards[1]);
+        remove_guard(room, &guards[0]);
+        worker->sink += (unsigned long)guards[1].roomSlot;
+        remove_guard(room, &guards[1]);
+    }
+
+    lock_destroy(&room->mutex);
+    room_free_slots(room);
+    free(room);
+    free(guards);
+}
+
+/**
+ * @brief check a cycle of evidence masks against the catalogue
+ *
+ * @param[in,out] worker calling worker
+ */
+static void micro_valid_ghost(struct MicroWorker* worker) {
+    struct MicroShared* shared = worker->shared;
+    for (unsigned long i = 0; i < shared->iterations; i++) {
+        worker->sink += evidence_is_valid_ghost(shared->masks[i % MICRO_MASKS]);
+    }
+}
+
+/**
+ * @brief draw random numbers from the calling thread's stream
+ *
+ * @param[in,out] worker calling worker
+ */
+static void micro_rand(struct MicroWorker* worker) {
+    struct MicroShared* shared = worker->shared;
+    for (unsigned long i = 0; i < shared->iterations; i++) {
+        worker->sink += (unsigned long)rand_int_threadsafe(0, 1000);
+    }
+}
+
+/**
+ * @brief append log records, each a call to write_log_record through log_evidence
+ *
+ * every record opens, appends to and closes the entity's CSV file and then
+ * sleeps 2 ms, so this measures mostly the pause
+ *
+ * @param[in,out] worker calling worker
+ */
+static void micro_log_record(struct MicroWorker* worker) {
+    struct MicroShared* shared = worker->shared;
+    const char* room = shared->museum->rooms[0].name;
+    for (unsigned long i = 0; i < shared->iterations; i++) {
+        log_evidence(worker->index + 1, 0, 0, room, (EvidenceMask)1);
+    }
+    worker->sink += shared->iterations;
+}
+
+static const struct MicroBench micro_benches[] = {
+    { "lock_rooms+unlock_rooms", 1000000, micro_lock_rooms },
+    { "push+pop", 10000000, micro_push_pop },
+    { "push x8+empty_roomstack", 2000000, micro_empty_roomstack },
+    { "add_guard+remove_guard", 2000000, micro_add_remove_guard },
+    { "evidence_is_valid_ghost", 10000000, micro_valid_ghost },
+    { "rand_int_threadsafe", 10000000, micro_rand },
+    { "write_log_record", 50, micro_log_record },
+};
+
+static void* micro_thread(void* arg) {
+    struct MicroWorker* worker = arg;
+    pthread_barrier_wait(&worker->shared->start);
+
+    unsigned long long start = stats_now_ns();
+    worker->loop(worker);
+    worker->ns = stats_now_ns() - start;
+    return NULL;
+}
+
+/**
+ * @brief run one primitive on a number of threads at once
+ *
+ * @param[in] bench primitive to run
+ * @param[in,out] shared state shared by the workers, iterations already set
+ * @param[in] threads number of threads
+ * @param[out] nsPerOp mean time per operation seen by one thread
+ * @param[out] opsPerSec operations completed per second across every thread
+ */
+static void micro_measure(const struct MicroBench* bench, struct MicroShared* shared, int threads,
+                          double* nsPerOp, double* opsPerSec) {
+    struct MicroWorker workers[MICRO_MAX_THREADS];
+    pthread_barrier_init(&shared->start, NULL, (unsigned)threads + 1);
+
+    for (int t = 0; t < threads; t++) {
+        workers[t].index = t;
+        workers[t].shared = shared;
+        workers[t].loop = bench->loop;
+        workers[t].ns = 0;
+        workers[t].sink = 0;
+        pthread_create(&workers[t].thread, NULL, micro_thread, &workers[t]);
+    }
+
+    pthread_barrier_wait(&shared->start);
+    unsigned long long start = stats_now_ns();
+    unsigned long long threadNs = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t].thread, NULL);
+        threadNs += workers[t].ns;
+        micro_sink += workers[t].sink;
+    }
+    double wall = (double)(stats_now_ns() - start) / 1e9;
+    pthread_barrier_destroy(&shared->start);
+
+    double ops = (double)shared->iterations * threads;
+    *nsPerOp = ops > 0 ? (double)threadNs / ops : 0.0;
+    *opsPerSec = wall > 0 ? ops / wall : 0.0;
+}
+
+/**
+ * @brief send stdout and the CSV logs somewhere harmless while log records are timed
+ *
+ * @param[in,out] dir scratch directory template, filled in by mkdtemp
+ * @param[out] savedStdout duplicate of the real stdout to restore
+ * @param[out] savedCwd descriptor of the directory to return to
+ *
+ * @return false if the scratch directory could not be set up
+ */
+static bool micro_logs_begin(char* dir, int* savedStdout, int* savedCwd) {
+    fflush(stdout);
+    *savedCwd = open(".", O_RDONLY | O_DIRECTORY);
+    int devNull = open("/dev/null", O_WRONLY);
+    if (*savedCwd < 0 || devNull < 0 || !mkdtemp(dir) || chdir(dir) != 0) {
+        if (devNull >= 0) {
+            close(devNull);
+        }
+        return false;
+    }
+    *savedStdout = dup(STDOUT_FILENO);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+    return true;
+}
+
+/**
+ * @brief undo micro_logs_begin, deleting the logs written in the scratch directory
+ *
+ * @param[in] dir scratch directory
+ * @param[in] savedStdout descriptor returned by micro_logs_begin
+ * @param[in] savedCwd descriptor returned by micro_logs_begin
+ */
+static void micro_logs_end(const char* dir, int savedStdout, int savedCwd) {
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+
+    DIR* handle = opendir(".");
+    if (handle) {
+        struct dirent* entry;
+        while ((entry = readdir(handle)) != NULL) {
+            if (strncmp(entry->d_name, "log_", 4) == 0) {
+                unlink(entry->d_name);
+            }
+        }
+        closedir(handle);
+    }
+    if (fchdir(savedCwd) == 0) {
+        rmdir(dir);
+    }
+    close(savedCwd);
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--threads n,m,...] [--scale X] [--rooms N] [--lock NAME] [--only NAME]\n"
+            "  --threads  thread counts to run every primitive at (default 1,2,4,8)\n"
+            "  --scale  multiply every primitive's iteration count (default 1)\n"
+            "  --rooms  rooms lock_rooms draws its pairs from; 2 makes every thread fight over one pair (default 4)\n"
+            "  --lock  room lock backend (default %s)\n"
+            "  --only  run only the primitives whose name contains NAME\n",
+            prog, HEIST_LOCK_DEFAULT);
+}
+
+int main(int argc, char* argv[]) {
+    int threadCounts[MICRO_MAX_THREAD_COUNTS] = { 1, 2, 4, 8 };
+    int threadCountLen = 4;
+    double scale = 1.0;
+    int roomPool = 4;
+    const char* only = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCountLen = 0;
+            char* list = argv[++i];
+            for (char* tok = strtok(list, ","); tok && threadCountLen < MICRO_MAX_THREAD_COUNTS; tok = strtok(NULL, ",")) {
+                int threads = atoi(tok);
+                if (threads < 1 || threads > MICRO_MAX_THREADS) {
+                    fprintf(stderr, "Thread counts must be between 1 and %d\n", MICRO_MAX_THREADS);
+                    return 1;
+                }
+                threadCounts[threadCountLen++] = threads;
+            }
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--rooms") == 0 && i + 1 < argc) {
+            roomPool = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--lock") == 0 && i + 1 < argc) {
+            enum LockBackend backend;
+            if (!lock_backend_from_string(argv[++i], &backend)) {
+                fprintf(stderr, "Unknown lock backend: %s\n", argv[i]);
+                return 1;
+            }
+            lock_backend_set(backend);
+        } else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    rand_seed(1);
+
+    struct Museum museum;
+    museum_init(&museum);
+    museum_populate_rooms(&museum);
+    if (roomPool < 2 || roomPool > museum.room_count) {
+        fprintf(stderr, "--rooms must be between 2 and %d\n", museum.room_count);
+        museum_cleanup(&museum);
+        return 1;
+    }
+
+    // catalogue profiles interleaved with random masks over the same types
+    EvidenceMask masks[MICRO_MASKS];
+    int types = catalogue_type_count();
+    int profiles = catalogue_profile_count();
+    for (int i = 0; i < MICRO_MASKS; i++) {
+        if (i % 2 == 0) {
+            masks[i] = catalogue_profile_mask(rand_int_threadsafe(0, profiles));
+        } else {
+            masks[i] = (EvidenceMask)rand_int_threadsafe(1, 1 << (types < 30 ? types : 30));
+        }
+    }
+
+    struct MicroShared shared = { .museum = &museum, .roomPool = roomPool, .masks = masks };
+
+    printf("%s locks, %d CPUs\n", lock_backend_to_string(lock_backend_get()), (int)sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-24s %7s %12s %10s %12s %8s\n", "primitive", "threads", "ops/thread", "ns/op", "Mops/s", "scaling");
+
+    for (size_t b = 0; b < sizeof(micro_benches) / sizeof(micro_benches[0]); b++) {
+        const struct MicroBench* bench = &micro_benches[b];
+        if (only && !strstr(bench->name, only)) {
+            continue;
+        }
+
+        bool logging = bench->loop == micro_log_record;
+        char dir[] = "/tmp/heist-micro-XXXXXX";
+        int savedStdout = -1;
+        int savedCwd = -1;
+        if (logging && !micro_logs_begin(dir, &savedStdout, &savedCwd)) {
+            fprintf(stderr, "Could not set up a scratch directory for %s\n", bench->name);
+            continue;
+        }
+
+        double baseRate = 0.0;
+        double nsPerOp[MICRO_MAX_THREAD_COUNTS];
+        double opsPerSec[MICRO_MAX_THREAD_COUNTS];
+        shared.iterations = (unsigned long)(bench->iterations * scale);
+        if (shared.iterations == 0) {
+            shared.iterations = 1;
+        }
+        for (int t = 0; t < threadCountLen; t++) {
+            micro_measure(bench, &shared, threadCounts[t], &nsPerOp[t], &opsPerSec[t]);
+        }
+
+        if (logging) {
+            micro_logs_end(dir, savedStdout, savedCwd);
+        }
+
+        // scaling is throughput relative to the first thread count, ideally the thread ratio
+        for (int t = 0; t < threadCountLen; t++) {
+            if (t == 0) {
+                baseRate = opsPerSec[t];
+            }
+            printf("%-24s %7d %12lu %10.1f %12.3f %7.2fx\n", bench->name, threadCounts[t], shared.iterations,
+                   nsPerOp[t], opsPerSec[t] / 1e6, baseRate > 0 ? opsPerSec[t] / baseRate : 0.0);
+        }
+        fflush(stdout);
+    }
+
+    museum_cleanup(&museum);
+    return 0;
+}
@@ -1,30 +1,185 @@
 #include "defs.h"
+#include "helpers.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * @brief initialize casefile
  *
- * sets collected evidence to zero, marks case as unsolved, initializes mutex
+ * sets collected evidence to zero, marks case as unsolved with no per-thief
+ * cases yet and makes sure a
+ * catalogue and its candidate table exist before any guard thread reads them
  *
  * @param[out] file pointer to the casefile
  */
 void casefile_init(struct CaseFile* file){
-    file->collected = 0;
-    file->solved = false;
-    sem_init(&file->mutex, 0, 1);
+    catalogue_ensure();
+    atomic_init(&file->collected, 0);
+    atomic_init(&file->solved, false);
+    file->cases = NULL;
+    file->caseCount = 0;
+    atomic_init(&file->solvedCases, 0);
+    for (int i = 0; i < EVIDENCE_TYPES; i++){
+        atomic_init(&file->holders[i], 0);
+    }
+    for (int i = 0; i < RECENT_DROPS; i++){
+        atomic_init(&file->recentDrops[i], NULL);
+    }
+    atomic_init(&file->dropCursor, 0);
+}
+
+/**
+ * @brief add evidence bits to the casefile without taking a lock
+ *
+ * the evidence goes into the overall collected mask and into the case of
+ * the thief that dropped it. the fetch-or on that case returns its mask as
+ * it was just before this update; the candidate profiles before and after
+ * are table lookups, so the caller that narrows the case down to a single
+ * candidate is the one that counts it as solved, and the one that solves
+ * the last case latches solved
+ *
+ * @param[in,out] file pointer to the casefile
+ * @param[in] thief index of the thief the evidence is attributed to
+ * @param[in] evidence evidence bits to add
+ *
+ * @return that thief's case including the new bits
+ */
+EvidenceMask casefile_add_evidence(struct CaseFile* file, int thief, EvidenceMask evidence){
+    atomic_fetch_or_explicit(&file->collected, evidence, memory_order_acq_rel);
+    if (thief < 0 || thief >= file->caseCount){
+        return 0;
+    }
+
+    EvidenceMask before = atomic_fetch_or_explicit(&file->cases[thief], evidence, memory_order_acq_rel);
+    EvidenceMask after = before | evidence;
+
+    // candidates only shrink as bits are added, so exactly one update crosses to one
+    if (catalogue_candidates(after, NULL) == 1 && catalogue_candidates(before, NULL) != 1){
+        int solved = atomic_fetch_add_explicit(&file->solvedCases, 1, memory_order_acq_rel) + 1;
+        if (solved == file->caseCount){
+            atomic_store_explicit(&file->solved, true, memory_order_release);
+        }
+    }
+
+    return after;
+}
+
+/**
+ * @brief read the collected evidence mask
+ *
+ * @param[in] file pointer to the casefile
+ *
+ * @return union of all collected evidence bits
+ */
+EvidenceMask casefile_collected(struct CaseFile* file){
+    return atomic_load_explicit(&file->collected, memory_order_acquire);
 }
 
 /**
- * @brief close a casefile.
+ * @brief check whether the case has been solved
  *
- * used during cleanup to destroy mutex
+ * @param[in] file pointer to the casefile
+ *
+ * @return true once every thief's case matched a profile
+ */
+bool casefile_solved(struct CaseFile* file){
+    return atomic_load_explicit(&file->solved, memory_order_acquire);
+}
+
+/**
+ * @brief read the evidence attributed to one thief
+ *
+ * @param[in] file pointer to the casefile
+ * @param[in] thief thief index
+ *
+ * @return that thief's case, 0 for an unknown index
+ */
+EvidenceMask casefile_case(struct CaseFile* file, int thief){
+    if (thief < 0 || thief >= file->caseCount){
+        return 0;
+    }
+    return atomic_load_explicit(&file->cases[thief], memory_order_acquire);
+}
+
+/**
+ * @brief count the profiles still consistent with one thief's case
+ *
+ * @param[in] file pointer to the casefile
+ * @param[in] thief thief index
+ *
+ * @return candidate count, every profile for a case with no evidence yet
+ */
+int casefile_candidates(struct CaseFile* file, int thief){
+    return catalogue_candidates(casefile_case(file, thief), NULL);
+}
+
+/**
+ * @brief record a guard putting down one device and picking up another
+ *
+ * keeps the per-device holder counts that let guards spread over devices;
+ * pass 0 as from when a guard starts and 0 as to when it leaves
  *
  * @param[in,out] file pointer to the casefile
+ * @param[in] from device put down, or 0
+ * @param[in] to device picked up, or 0
  */
-void casefile_close(struct CaseFile* file){
-    sem_destroy(&file->mutex);
+void casefile_swap_device(struct CaseFile* file, EvidenceMask from, EvidenceMask to){
+    if (from){
+        atomic_fetch_sub_explicit(&file->holders[__builtin_ctzll(from)], 1, memory_order_relaxed);
+    }
+    if (to){
+        atomic_fetch_add_explicit(&file->holders[__builtin_ctzll(to)], 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief count the active guards carrying a device
+ *
+ * @param[in] file pointer to the casefile
+ * @param[in] device a single evidence bit
+ *
+ * @return number of holders, a hint that may be a moment out of date
+ */
+int casefile_holders(struct CaseFile* file, EvidenceMask device){
+    return device ? atomic_load_explicit(&file->holders[__builtin_ctzll(device)], memory_order_relaxed) : 0;
+}
+
+/**
+ * @brief remember a room a thief just dropped evidence in
+ *
+ * the ring keeps the last RECENT_DROPS rooms; older ones are overwritten
+ *
+ * @param[in,out] file pointer to the casefile
+ * @param[in] room room the evidence was dropped in
+ */
+void casefile_note_drop(struct CaseFile* file, struct Room* room){
+    unsigned slot = atomic_fetch_add_explicit(&file->dropCursor, 1, memory_order_relaxed) % RECENT_DROPS;
+    atomic_store_explicit(&file->recentDrops[slot], room, memory_order_relaxed);
+}
+
+/**
+ * @brief read one entry of the recent drop ring
+ *
+ * @param[in] file pointer to the casefile
+ * @param[in] slot index below RECENT_DROPS
+ *
+ * @return the room, NULL while the slot has never been written
+ */
+struct Room* casefile_recent_drop(struct CaseFile* file, int slot){
+    return atomic_load_explicit(&file->recentDrops[slot], memory_order_relaxed);
+}
+
+/**
+ * @brief count the thieves whose case is down to one candidate
+ *
+ * @param[in] file pointer to the casefile
+ *
+ * @return number of solved cases
+ */
+int casefile_solved_cases(struct CaseFile* file){
+    return atomic_load_explicit(&file->solvedCases, memory_order_acquire);
 }
 
 /**
@@ -35,84 +190,367 @@ void casefile_close(struct CaseFile* file){
  * @param[out] museum pointer to new museum
  */
 void museum_init(struct Museum* museum){
+    museum->rooms = NULL;
+    museum->doors = NULL;
+    museum->drops = NULL;
     museum->room_count = 0;
     museum->starting_room = NULL;
+    museum->routeNext = NULL;
+    museum->routeDist = NULL;
     museum->guards = NULL;
     museum->guardCount = 0;
     museum->guardMax = 0;
+    museum->thieves = NULL;
+    museum->thiefCount = 0;
     casefile_init(&museum->casefile);
 }
 
 /**
  * @brief free all memory associated with museum.
  *
- * frees every guard, destroys room mutexes, clears casefile,
- * and frees the guard pointer array
+ * frees every breadcrumb, destroys room mutexes, frees the
+ * rooms, doors, the guard and thief slabs and the per-thief cases
  *
  * @param[in,out] museum pointer to museum being cleaned up.
  */
 void museum_cleanup(struct Museum* museum){
     for(int i = 0; i < museum->guardCount; i++){
-        struct Guard* guard = museum->guards[i];
-        if(!guard){
-            continue;
-        }
-
-        empty_roomstack(&guard->breadcrumb);
-        sem_destroy(&guard->mutex);
-        free(guard);
+        roomstack_free(&museum->guards[i].breadcrumb);
     }
 
     for(int i = 0; i < museum->room_count; i++){
-        sem_destroy(&museum->rooms[i].mutex);
+        lock_destroy(&museum->rooms[i].mutex);
+        room_free_slots(&museum->rooms[i]);
     }
+    shm_free(museum->rooms);
+    shm_free(museum->drops);
+    free(museum->doors);
+    museum->rooms = NULL;
+    museum->drops = NULL;
+    museum->doors = NULL;
+    museum->room_count = 0;
+    museum->starting_room = NULL;
 
-    casefile_close(&museum->casefile);
+    free(museum->routeNext);
+    free(museum->routeDist);
+    museum->routeNext = NULL;
+    museum->routeDist = NULL;
 
-    free(museum->guards);
+    shm_free(museum->guards);
     museum->guards = NULL;
     museum->guardCount = 0;
     museum->guardMax = 0;
+
+    shm_free(museum->thieves);
+    shm_free(museum->casefile.cases);
+    museum->thieves = NULL;
+    museum->thiefCount = 0;
+    museum->casefile.cases = NULL;
+    museum->casefile.caseCount = 0;
+}
+
+/**
+ * @brief allocate and connect the rooms of a layout
+ *
+ * rooms go in one cache-line aligned array and every room's neighbour list
+ * is a slice of one shared door array, sized from a degree count over the
+ * layout's doors, so neither the number of rooms nor doors per room is
+ * capped. the exit becomes the starting room and routes are precomputed.
+ * rooms come from shm_alloc, so they land in the shared segment when guard
+ * processes are used, as does the drop table holding each room's droppedBy
+ * slots, one per evidence type of the active catalogue; doors and routes
+ * never change after the build and stay on the heap, where each forked
+ * process keeps its own copy
+ *
+ * @param[in,out] museum pointer to an initialized museum with no rooms yet
+ * @param[in] layout validated layout
+ *
+ * @return true if the rooms were built
+ * @return false if rooms already exist, the layout is empty or memory ran out
+ */
+bool museum_build(struct Museum* museum, const struct Layout* layout){
+    uint32_t count = layout_room_count(layout);
+    if(museum->rooms || count == 0 || count > INT32_MAX || layout->exitRoom >= count){
+        return false;
+    }
+
+    size_t types = (size_t)catalogue_type_count();
+    int* degree = calloc(count, sizeof(int));
+    struct Room* rooms = shm_alloc(CACHE_LINE, (size_t)count * sizeof(struct Room));
+    _Atomic uint16_t* drops = shm_alloc(CACHE_LINE, (size_t)count * types * sizeof(uint16_t));
+    struct Room** doors = malloc((layout->doorCount * 2 + 1) * sizeof(struct Room*));
+    if(!degree || !rooms || !drops || !doors){
+        free(degree);
+        shm_free(rooms);
+        shm_free(drops);
+        free(doors);
+        return false;
+    }
+
+    for(size_t d = 0; d < layout->doorCount; d++){
+        degree[layout->doors[d][0]]++;
+        degree[layout->doors[d][1]]++;
+    }
+
+    size_t offset = 0;
+    char name[MAX_ROOM_NAME];
+    for(uint32_t r = 0; r < count; r++){
+        room_init(&rooms[r], layout_room_name(layout, r, name, sizeof(name)), r == layout->exitRoom);
+        rooms[r].connectedRooms = doors + offset;
+        rooms[r].doorCapacity = degree[r];
+        rooms[r].droppedBy = drops + (size_t)r * types;
+        for(size_t t = 0; t < types; t++){
+            atomic_init(&rooms[r].droppedBy[t], 0);
+        }
+        offset += (size_t)degree[r];
+    }
+    free(degree);
+
+    for(size_t d = 0; d < layout->doorCount; d++){
+        room_connect(&rooms[layout->doors[d][0]], &rooms[layout->doors[d][1]]);
+    }
+
+    museum->rooms = rooms;
+    museum->drops = drops;
+    museum->doors = doors;
+    museum->room_count = (int)count;
+    museum->starting_room = &rooms[layout->exitRoom];
+    museum_build_routes(museum);
+    return true;
+}
+
+/**
+ * @brief allocate the guard slab for the whole roster
+ *
+ * guards live in one cache-line aligned block that never moves, so rooms
+ * can keep pointers to them; it must be sized before the first guard is
+ * added and can only be reserved once. like the rooms, the slab goes in
+ * the shared segment when one is mapped
+ *
+ * @param[in,out] museum pointer to the museum
+ * @param[in] count number of guards in the roster
+ *
+ * @return true if the slab was allocated
+ * @return false if a slab already exists or memory allocation failed
+ */
+bool museum_reserve_guards(struct Museum* museum, int count){
+    if(museum->guards || count <= 0){
+        return false;
+    }
+
+    // struct Guard is cache-line aligned, so its size is already a whole number of lines
+    struct Guard* slab = shm_alloc(CACHE_LINE, (size_t)count * sizeof(struct Guard));
+    if(!slab){
+        return false;
+    }
+
+    museum->guards = slab;
+    museum->guardMax = count;
+    return true;
 }
 
 /**
  * @brief add a guard to the museum.
  *
- * resizes guard array if needed using arraylist logic, allocates a new guard,
- * initializes it, and stores it in the museum
+ * takes the next slot of the guard slab, initializes it, and places the
+ * guard in the starting room
  *
  * @param[in,out] museum pointer to the museum
  * @param[in] name the guard's name
  * @param[in] id the guard's id
  *
  * @return true if the guard was added successfully
- * @return false if memory allocation failed
+ * @return false if the slab is full or was never reserved
  */
 bool museum_add_guard(struct Museum* museum, const char* name, int id){
     if(museum->guardCount >= museum->guardMax){
-        int resize = (museum->guardMax == 0 ? 1 : 2 * museum->guardMax);
+        return false;
+    }
 
-        struct Guard** newArr =
-            realloc(museum->guards, resize * sizeof(struct Guard*));
+    struct Guard* guard = &museum->guards[museum->guardCount];
+    museum->guardCount++;
 
-        if(!newArr){
-            return false;
-        }
+    guard_init(guard, museum, name, id);
 
-        museum->guards = newArr;
-        museum->guardMax = resize;
-    }
+    return true;
+}
 
-    struct Guard* guard = malloc(sizeof(struct Guard));
-    if(!guard){
+/**
+ * @brief create every thief of the run
+ *
+ * thieves live in one cache-line aligned slab and each gets a case in the
+ * casefile, both from shm_alloc so guard processes can attribute evidence.
+ * every thief picks its own profile and starting room. can only be called
+ * once, after the rooms are built
+ *
+ * @param[in,out] museum pointer to the museum
+ * @param[in] count number of thieves
+ *
+ * @return true if the thieves were created
+ * @return false if thieves already exist, there are no rooms or memory ran out
+ */
+bool museum_add_thieves(struct Museum* museum, int count){
+    if(museum->thieves || !museum->rooms || count <= 0 || count > UINT16_MAX){
         return false;
     }
 
-    museum->guards[museum->guardCount] = guard;
-    museum->guardCount++;
+    // struct Thief is cache-line aligned, so its size is already a whole number of lines
+    struct Thief* thieves = shm_alloc(CACHE_LINE, (size_t)count * sizeof(struct Thief));
+    _Atomic EvidenceMask* cases = shm_alloc(CACHE_LINE, (size_t)count * sizeof(*cases));
+    if(!thieves || !cases){
+        shm_free(thieves);
+        shm_free(cases);
+        return false;
+    }
 
-    guard_init(guard, museum, name, id);
+    for(int i = 0; i < count; i++){
+        atomic_init(&cases[i], 0);
+    }
+    museum->casefile.cases = cases;
+    museum->casefile.caseCount = count;
 
+    museum->thieves = thieves;
+    museum->thiefCount = count;
+    for(int i = 0; i < count; i++){
+        thief_init(&thieves[i], museum, i);
+    }
     return true;
 }
 
+/**
+ * @brief breadth-first search toward one target room
+ *
+ * every room reached records the neighbour it was discovered from, which
+ * is its next hop on a shortest path to the target
+ *
+ * @param[in] museum pointer to museum
+ * @param[in] target index of the target room
+ * @param[out] parent next-hop index per room, -1 for the target and unreachable rooms
+ * @param[out] dist doors to the target per room, -1 when unreachable
+ * @param[in,out] queue scratch space of room_count entries
+ */
+static void route_bfs(struct Museum* museum, int target, int* parent, int* dist, int* queue){
+    for(int i = 0; i < museum->room_count; i++){
+        parent[i] = -1;
+        dist[i] = -1;
+    }
+
+    int head = 0, tail = 0;
+    dist[target] = 0;
+    queue[tail++] = target;
+
+    while(head < tail){
+        int at = queue[head++];
+        struct Room* room = &museum->rooms[at];
+        for(int j = 0; j < room->connections; j++){
+            int next = (int)(room->connectedRooms[j] - museum->rooms);
+            if(dist[next] < 0){
+                dist[next] = dist[at] + 1;
+                parent[next] = at;
+                queue[tail++] = next;
+            }
+        }
+    }
+}
+
+/**
+ * @brief precompute shortest-path routing over the room graph
+ *
+ * always fills in each room's next hop and distance to the exit; museums of
+ * up to ROUTE_ALL_PAIRS_MAX rooms also get an all-pairs next-hop table
+ *
+ * @param[in,out] museum pointer to populated museum
+ */
+void museum_build_routes(struct Museum* museum){
+    int n = museum->room_count;
+    int* parent = malloc(sizeof(int) * n);
+    int* dist = malloc(sizeof(int) * n);
+    int* queue = malloc(sizeof(int) * n);
+    if(!parent || !dist || !queue || !museum->starting_room){
+        free(parent);
+        free(dist);
+        free(queue);
+        return;
+    }
+
+    int exitIndex = (int)(museum->starting_room - museum->rooms);
+    route_bfs(museum, exitIndex, parent, dist, queue);
+    for(int i = 0; i < n; i++){
+        museum->rooms[i].toExit = parent[i] >= 0 ? &museum->rooms[parent[i]] : NULL;
+        museum->rooms[i].exitDistance = dist[i];
+    }
+
+    free(museum->routeNext);
+    free(museum->routeDist);
+    museum->routeNext = NULL;
+    museum->routeDist = NULL;
+
+    if(n <= ROUTE_ALL_PAIRS_MAX){
+        museum->routeNext = malloc(sizeof(uint16_t) * n * n);
+        museum->routeDist = malloc(sizeof(uint16_t) * n * n);
+    }
+
+    if(museum->routeNext && museum->routeDist){
+        for(int to = 0; to < n; to++){
+            route_bfs(museum, to, parent, dist, queue);
+            for(int from = 0; from < n; from++){
+                museum->routeNext[from * n + to] = parent[from] >= 0 ? (uint16_t)parent[from] : ROUTE_NONE;
+                museum->routeDist[from * n + to] = dist[from] >= 0 ? (uint16_t)dist[from] : ROUTE_NONE;
+            }
+        }
+    } else {
+        free(museum->routeNext);
+        free(museum->routeDist);
+        museum->routeNext = NULL;
+        museum->routeDist = NULL;
+    }
+
+    free(parent);
+    free(dist);
+    free(queue);
+}
+
+/**
+ * @brief next room on a shortest path between two rooms
+ *
+ * @param[in] museum pointer to museum with routes built
+ * @param[in] from current room
+ * @param[in] to destination room
+ *
+ * @return next room to step into, NULL when already there, unreachable,
+ * or no table covers this pair
+ */
+struct Room* museum_next_hop(struct Museum* museum, struct Room* from, struct Room* to){
+    if(to == museum->starting_room){
+        return from->toExit;
+    }
+    if(!museum->routeNext){
+        return NULL;
+    }
+
+    int n = museum->room_count;
+    uint16_t next = museum->routeNext[(from - museum->rooms) * n + (to - museum->rooms)];
+    return next == ROUTE_NONE ? NULL : &museum->rooms[next];
+}
+
+/**
+ * @brief shortest-path length between two rooms
+ *
+ * @param[in] museum pointer to museum with routes built
+ * @param[in] from start room
+ * @param[in] to destination room
+ *
+ * @return number of doors, -1 when unreachable or no table covers this pair
+ */
+int museum_distance(struct Museum* museum, struct Room* from, struct Room* to){
+    if(to == museum->starting_room){
+        return from->exitDistance;
+    }
+    if(!museum->routeDist){
+        return -1;
+    }
+
+    int n = museum->room_count;
+    uint16_t dist = museum->routeDist[(from - museum->rooms) * n + (to - museum->rooms)];
+    return dist == ROUTE_NONE ? -1 : dist;
+}
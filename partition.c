@@ -0,0 +1,878 @@
+#include "defs.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARTITION_MAX_REGIONS 64
+#define PARTITION_COARSEST 40         // Coarsening stops near this many vertices per region
+#define PARTITION_MAX_LEVELS 48
+#define PARTITION_SHRINK 0.95         // A level that keeps more of the vertices than this ends coarsening
+#define PARTITION_TRIES 8             // Starting rooms tried when splitting the coarsest graph
+#define PARTITION_REFINE_PASSES 8
+#define PARTITION_FM_STALL 400        // Moves without a smaller cut before a refinement pass rolls back
+#define PARTITION_BALANCE_SLACK 0.05  // Regions may end this much above or below the average
+
+// Weighted graph of one coarsening level. Level 0 has a vertex per room and
+// an edge per door; every coarser level merges matched pairs of vertices.
+struct PartGraph {
+    int n;
+    int* xadj;                        // n + 1 offsets into adj
+    int* adj;                         // Neighbouring vertices
+    int* adjw;                        // Doors each edge stands for
+    int* vwgt;                        // Rooms each vertex stands for
+    int* cmap;                        // Vertex of the next coarser level this one was merged into
+    long total;                       // Sum of vwgt
+};
+
+// Indexed max-heap of vertices keyed by the gain of their best move
+struct PartHeap {
+    int* heap;
+    int* pos;                         // Index in heap, -1 when the vertex is not queued
+    int* key;
+    int count;
+};
+
+// Where a vertex stands in the current refinement pass
+enum PartState {
+    PART_FREE = 0,                    // Queued by gain, or not on the boundary
+    PART_LOCKED,                      // Already moved in this pass
+    PART_DEFERRED                     // On the boundary, but every move it has would break the size limits
+};
+
+// Scratch state shared by every level, sized for level 0
+struct PartWork {
+    int regions;
+    long size[PARTITION_MAX_REGIONS]; // Rooms in each region
+    int links[PARTITION_MAX_REGIONS]; // Edge weight from one vertex to each region, zero between uses
+    long minSize;
+    long maxSize;
+    struct PartHeap heap;
+    int* moved;                       // Vertices moved in the current refinement pass, in order
+    int* movedFrom;                   // Region each of them left
+    unsigned char* state;             // enum PartState of every vertex
+    int* deferred;                    // Vertices in PART_DEFERRED, retried after every move
+    int deferredCount;
+    int* order;                       // Breadth-first order used to grow the first regions
+    int* frontier;
+    int* dist;
+};
+
+/**
+ * @brief splitmix64 step for the coarsening order
+ *
+ * @param[in,out] state generator state
+ *
+ * @return next random value
+ */
+static uint64_t part_random(uint64_t* state){
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static void heap_swap(struct PartHeap* h, int a, int b){
+    int va = h->heap[a], vb = h->heap[b];
+    h->heap[a] = vb;
+    h->heap[b] = va;
+    h->pos[vb] = a;
+    h->pos[va] = b;
+}
+
+static void heap_up(struct PartHeap* h, int i){
+    while (i > 0 && h->key[h->heap[(i - 1) / 2]] < h->key[h->heap[i]]){
+        heap_swap(h, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heap_down(struct PartHeap* h, int i){
+    for (;;){
+        int best = i;
+        int l = 2 * i + 1, r = 2 * i + 2;
+        if (l < h->count && h->key[h->heap[l]] > h->key[h->heap[best]]){
+            best = l;
+        }
+        if (r < h->count && h->key[h->heap[r]] > h->key[h->heap[best]]){
+            best = r;
+        }
+        if (best == i){
+            return;
+        }
+        heap_swap(h, i, best);
+        i = best;
+    }
+}
+
+/**
+ * @brief queue a vertex or change its key if it is already queued
+ *
+ * @param[in,out] h heap
+ * @param[in] v vertex
+ * @param[in] key gain of the vertex's best move
+ */
+static void heap_set(struct PartHeap* h, int v, int key){
+    if (h->pos[v] < 0){
+        h->heap[h->count] = v;
+        h->pos[v] = h->count++;
+        h->key[v] = key;
+        heap_up(h, h->pos[v]);
+    } else {
+        int old = h->key[v];
+        h->key[v] = key;
+        if (key > old){
+            heap_up(h, h->pos[v]);
+        } else {
+            heap_down(h, h->pos[v]);
+        }
+    }
+}
+
+/**
+ * @brief take a vertex out of the heap if it is queued
+ *
+ * @param[in,out] h heap
+ * @param[in] v vertex
+ */
+static void heap_remove(struct PartHeap* h, int v){
+    int i = h->pos[v];
+    if (i < 0){
+        return;
+    }
+    h->pos[v] = -1;
+    if (--h->count == i){
+        return;
+    }
+    int last = h->heap[h->count];
+    h->heap[i] = last;
+    h->pos[last] = i;
+    heap_up(h, i);
+    heap_down(h, h->pos[last]);
+}
+
+/**
+ * @brief take the vertex with the largest key
+ *
+ * @param[in,out] h heap
+ * @param[out] key key the vertex was queued with
+ *
+ * @return vertex, -1 when the heap is empty
+ */
+static int heap_pop(struct PartHeap* h, int* key){
+    if (h->count == 0){
+        return -1;
+    }
+    int v = h->heap[0];
+    *key = h->key[v];
+    heap_remove(h, v);
+    return v;
+}
+
+static void heap_clear(struct PartHeap* h){
+    for (int i = 0; i < h->count; i++){
+        h->pos[h->heap[i]] = -1;
+    }
+    h->count = 0;
+}
+
+static void part_graph_free(struct PartGraph* g){
+    free(g->xadj);
+    free(g->adj);
+    free(g->adjw);
+    free(g->vwgt);
+    free(g->cmap);
+    memset(g, 0, sizeof(*g));
+}
+
+/**
+ * @brief build the level 0 graph from the museum's doors
+ *
+ * @param[in] museum museum with rooms built
+ * @param[out] g graph with a vertex per room
+ *
+ * @return false if memory ran out
+ */
+static bool part_graph_from_museum(struct Museum* museum, struct PartGraph* g){
+    int n = museum->room_count;
+    long edges = 0;
+    for (int i = 0; i < n; i++){
+        edges += museum->rooms[i].connections;
+    }
+
+    g->n = n;
+    g->total = n;
+    g->xadj = malloc(sizeof(int) * (n + 1));
+    g->adj = malloc(sizeof(int) * (edges > 0 ? edges : 1));
+    g->adjw = malloc(sizeof(int) * (edges > 0 ? edges : 1));
+    g->vwgt = malloc(sizeof(int) * n);
+    g->cmap = malloc(sizeof(int) * n);
+    if (!g->xadj || !g->adj || !g->adjw || !g->vwgt || !g->cmap){
+        part_graph_free(g);
+        return false;
+    }
+
+    int at = 0;
+    for (int i = 0; i < n; i++){
+        struct Room* room = &museum->rooms[i];
+        g->xadj[i] = at;
+        g->vwgt[i] = 1;
+        for (int j = 0; j < room->connections; j++){
+            int other = (int)(room->connectedRooms[j] - museum->rooms);
+            if (other != i){
+                g->adj[at] = other;
+                g->adjw[at] = 1;
+                at++;
+            }
+        }
+    }
+    g->xadj[n] = at;
+    return true;
+}
+
+/**
+ * @brief merge matched pairs of vertices into a coarser graph
+ *
+ * vertices are visited in random order and each is matched with the
+ * unmatched neighbour sharing the heaviest edge, so the doors inside merged
+ * pairs can never be cut on the finer levels
+ *
+ * @param[in,out] g finer graph; its cmap is filled in
+ * @param[out] c coarser graph
+ * @param[in] maxWeight heaviest vertex a merge may produce
+ * @param[in,out] rng coarsening order generator
+ * @param[in,out] scratch two arrays of at least g->n entries
+ *
+ * @return false if memory ran out
+ */
+static bool part_coarsen(struct PartGraph* g, struct PartGraph* c, int maxWeight, uint64_t* rng, int* scratch[2]){
+    int n = g->n;
+    int* match = scratch[0];
+    int* perm = scratch[1];
+
+    for (int v = 0; v < n; v++){
+        match[v] = -1;
+        perm[v] = v;
+    }
+    for (int i = n - 1; i > 0; i--){
+        int j = (int)(part_random(rng) % (uint64_t)(i + 1));
+        int t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+    }
+
+    for (int i = 0; i < n; i++){
+        int v = perm[i];
+        if (match[v] >= 0){
+            continue;
+        }
+        int best = -1;
+        for (int e = g->xadj[v]; e < g->xadj[v + 1]; e++){
+            int u = g->adj[e];
+            if (match[u] >= 0 || g->vwgt[u] + g->vwgt[v] > maxWeight){
+                continue;
+            }
+            if (best < 0 || g->adjw[e] > g->adjw[best] ||
+                (g->adjw[e] == g->adjw[best] && g->vwgt[u] < g->vwgt[g->adj[best]])){
+                best = e;
+            }
+        }
+        int u = best < 0 ? v : g->adj[best];
+        match[v] = u;
+        match[u] = v;
+    }
+
+    int cn = 0;
+    for (int v = 0; v < n; v++){
+        g->cmap[v] = -1;
+    }
+    for (int v = 0; v < n; v++){
+        if (g->cmap[v] < 0){
+            g->cmap[v] = cn;
+            g->cmap[match[v]] = cn;
+            cn++;
+        }
+    }
+
+    c->n = cn;
+    c->total = g->total;
+    c->xadj = malloc(sizeof(int) * (cn + 1));
+    c->adj = malloc(sizeof(int) * (g->xadj[n] > 0 ? g->xadj[n] : 1));
+    c->adjw = malloc(sizeof(int) * (g->xadj[n] > 0 ? g->xadj[n] : 1));
+    c->vwgt = malloc(sizeof(int) * cn);
+    c->cmap = malloc(sizeof(int) * cn);
+    if (!c->xadj || !c->adj || !c->adjw || !c->vwgt || !c->cmap){
+        part_graph_free(c);
+        return false;
+    }
+
+    // perm is free again; it maps each coarse neighbour to its slot in the current row
+    int* slot = perm;
+    for (int i = 0; i < cn; i++){
+        slot[i] = -1;
+    }
+
+    int len = 0;
+    int next = 0;
+    for (int v = 0; v < n; v++){
+        int cv = g->cmap[v];
+        if (cv < next){
+            continue;
+        }
+        next = cv + 1;
+        c->xadj[cv] = len;
+        c->vwgt[cv] = g->vwgt[v] + (match[v] != v ? g->vwgt[match[v]] : 0);
+
+        int members[2] = { v, match[v] };
+        for (int m = 0; m < (match[v] != v ? 2 : 1); m++){
+            int f = members[m];
+            for (int e = g->xadj[f]; e < g->xadj[f + 1]; e++){
+                int cu = g->cmap[g->adj[e]];
+                if (cu == cv){
+                    continue;
+                }
+                int s = slot[cu];
+                if (s >= c->xadj[cv] && s < len && c->adj[s] == cu){
+                    c->adjw[s] += g->adjw[e];
+                } else {
+                    slot[cu] = len;
+                    c->adj[len] = cu;
+                    c->adjw[len] = g->adjw[e];
+                    len++;
+                }
+            }
+        }
+    }
+    c->xadj[cn] = len;
+    return true;
+}
+
+/**
+ * @brief weight of the edges joining different regions
+ *
+ * @param[in] g graph
+ * @param[in] owner region of each vertex
+ *
+ * @return cut weight, each edge counted once
+ */
+static long part_cut(const struct PartGraph* g, const int* owner){
+    long cut = 0;
+    for (int v = 0; v < g->n; v++){
+        for (int e = g->xadj[v]; e < g->xadj[v + 1]; e++){
+            if (owner[g->adj[e]] != owner[v]){
+                cut += g->adjw[e];
+            }
+        }
+    }
+    return cut / 2;
+}
+
+/**
+ * @brief find the region a vertex gains most by joining
+ *
+ * the gain is the edge weight to the new region minus the edge weight to
+ * the old one. only regions the vertex has an edge to are considered, and
+ * the move must keep both regions within the balance limits
+ *
+ * @param[in] g graph
+ * @param[in] owner region of each vertex
+ * @param[in,out] work sizes, limits and the zeroed links array
+ * @param[in] v vertex
+ * @param[in] minSize smallest the old region may become
+ * @param[out] to chosen region, -1 if the vertex has no allowed move
+ * @param[out] blocked set when the vertex has a neighbouring region but the limits rule every move out; may be NULL
+ *
+ * @return gain of the move
+ */
+static int part_best_move(const struct PartGraph* g, const int* owner, struct PartWork* work, int v, long minSize,
+                          int* to, bool* blocked){
+    int from = owner[v];
+    int w = g->vwgt[v];
+    int touched[PARTITION_MAX_REGIONS];
+    int count = 0;
+
+    for (int e = g->xadj[v]; e < g->xadj[v + 1]; e++){
+        int r = owner[g->adj[e]];
+        if (work->links[r] == 0){
+            touched[count++] = r;
+        }
+        work->links[r] += g->adjw[e];
+    }
+
+    *to = -1;
+    int gain = 0;
+    if (work->size[from] - w >= minSize){
+        for (int i = 0; i < count; i++){
+            int r = touched[i];
+            if (r == from || work->size[r] + w > work->maxSize){
+                continue;
+            }
+            int moveGain = work->links[r] - work->links[from];
+            if (*to < 0 || moveGain > gain || (moveGain == gain && work->size[r] < work->size[*to])){
+                *to = r;
+                gain = moveGain;
+            }
+        }
+    }
+
+    if (blocked){
+        *blocked = *to < 0 && (count > 1 || (count == 1 && touched[0] != from));
+    }
+    for (int i = 0; i < count; i++){
+        work->links[touched[i]] = 0;
+    }
+    return gain;
+}
+
+static void part_move(const struct PartGraph* g, int* owner, struct PartWork* work, int v, int to){
+    work->size[owner[v]] -= g->vwgt[v];
+    work->size[to] += g->vwgt[v];
+    owner[v] = to;
+}
+
+/**
+ * @brief move boundary vertices out of regions above the size limit
+ *
+ * heavy merged vertices can leave the coarse split, or its projection,
+ * unbalanced; the cheapest boundary moves into regions with room fix it
+ *
+ * @param[in] g graph
+ * @param[in,out] owner region of each vertex
+ * @param[in,out] work scratch state
+ */
+static void part_balance(const struct PartGraph* g, int* owner, struct PartWork* work){
+    for (int round = 0; round < PARTITION_REFINE_PASSES; round++){
+        bool over = false;
+        for (int r = 0; r < work->regions; r++){
+            over = over || work->size[r] > work->maxSize;
+        }
+        if (!over){
+            return;
+        }
+
+        heap_clear(&work->heap);
+        for (int v = 0; v < g->n; v++){
+            if (work->size[owner[v]] > work->maxSize){
+                int to;
+                int gain = part_best_move(g, owner, work, v, 1, &to, NULL);
+                if (to >= 0){
+                    heap_set(&work->heap, v, gain);
+                }
+            }
+        }
+        if (work->heap.count == 0){
+            return;
+        }
+
+        int v, key;
+        while ((v = heap_pop(&work->heap, &key)) >= 0){
+            if (work->size[owner[v]] <= work->maxSize){
+                continue;
+            }
+            int to;
+            part_best_move(g, owner, work, v, 1, &to, NULL);
+            if (to >= 0){
+                part_move(g, owner, work, v, to);
+            }
+        }
+    }
+}
+
+/**
+ * @brief queue a free vertex by the gain of its best move
+ *
+ * a boundary vertex whose every move breaks the size limits is set aside
+ * as deferred until a move changes the sizes
+ *
+ * @param[in] g graph
+ * @param[in] owner region of each vertex
+ * @param[in,out] work scratch state
+ * @param[in] v vertex in PART_FREE
+ */
+static void part_queue(const struct PartGraph* g, const int* owner, struct PartWork* work, int v){
+    int to;
+    bool blocked;
+    int gain = part_best_move(g, owner, work, v, work->minSize, &to, &blocked);
+    if (to >= 0){
+        heap_set(&work->heap, v, gain);
+        return;
+    }
+    heap_remove(&work->heap, v);
+    if (blocked){
+        work->state[v] = PART_DEFERRED;
+        work->deferred[work->deferredCount++] = v;
+    }
+}
+
+/**
+ * @brief requeue deferred vertices whose moves fit the size limits again
+ *
+ * @param[in] g graph
+ * @param[in] owner region of each vertex
+ * @param[in,out] work scratch state
+ */
+static void part_retry_deferred(const struct PartGraph* g, const int* owner, struct PartWork* work){
+    int count = work->deferredCount;
+    work->deferredCount = 0;
+    for (int i = 0; i < count; i++){
+        int v = work->deferred[i];
+        if (work->state[v] == PART_DEFERRED){
+            work->state[v] = PART_FREE;
+            part_queue(g, owner, work, v);
+        }
+    }
+}
+
+/**
+ * @brief one Fiduccia-Mattheyses pass over the cut
+ *
+ * every boundary vertex is queued by the gain of its best balanced move.
+ * the best one is moved and locked and its neighbours are requeued, also
+ * when the gain is negative, so the pass can climb out of a local minimum.
+ * vertices held back by the size limits are retried after every move, so
+ * under a tight limit the moves alternate between regions. after
+ * PARTITION_FM_STALL moves without a smaller cut the pass stops and every
+ * move after the smallest cut seen is undone
+ *
+ * @param[in] g graph
+ * @param[in,out] owner region of each vertex
+ * @param[in,out] work scratch state
+ * @param[in] cut cut weight of owner
+ *
+ * @return cut weight after the pass
+ */
+static long part_fm_pass(const struct PartGraph* g, int* owner, struct PartWork* work, long cut){
+    struct PartHeap* heap = &work->heap;
+    heap_clear(heap);
+    work->deferredCount = 0;
+    for (int v = 0; v < g->n; v++){
+        part_queue(g, owner, work, v);
+    }
+
+    long best = cut;
+    int bestAt = 0;
+    int count = 0;
+    int v, key;
+    while ((v = heap_pop(heap, &key)) >= 0){
+        int to;
+        bool blocked;
+        int gain = part_best_move(g, owner, work, v, work->minSize, &to, &blocked);
+        if (to < 0){
+            if (blocked && work->state[v] == PART_FREE){
+                work->state[v] = PART_DEFERRED;
+                work->deferred[work->deferredCount++] = v;
+            }
+            continue;
+        }
+        if (gain < key){
+            // the sizes changed since v was queued; its best move got worse
+            heap_set(heap, v, gain);
+            continue;
+        }
+
+        work->moved[count] = v;
+        work->movedFrom[count] = owner[v];
+        count++;
+        work->state[v] = PART_LOCKED;
+        part_move(g, owner, work, v, to);
+        cut -= gain;
+
+        if (cut < best){
+            best = cut;
+            bestAt = count;
+        } else if (count - bestAt >= PARTITION_FM_STALL){
+            break;
+        }
+
+        for (int e = g->xadj[v]; e < g->xadj[v + 1]; e++){
+            int u = g->adj[e];
+            if (work->state[u] == PART_FREE){
+                part_queue(g, owner, work, u);
+            }
+        }
+        part_retry_deferred(g, owner, work);
+    }
+
+    for (int i = count - 1; i >= bestAt; i--){
+        part_move(g, owner, work, work->moved[i], work->movedFrom[i]);
+    }
+    for (int i = 0; i < count; i++){
+        work->state[work->moved[i]] = PART_FREE;
+    }
+    for (int i = 0; i < work->deferredCount; i++){
+        work->state[work->deferred[i]] = PART_FREE;
+    }
+    work->deferredCount = 0;
+    return best;
+}
+
+/**
+ * @brief balance a split and run refinement passes until the cut stops shrinking
+ *
+ * @param[in] g graph
+ * @param[in,out] owner region of each vertex
+ * @param[in,out] work scratch state
+ *
+ * @return cut weight of the refined split
+ */
+static long part_refine(const struct PartGraph* g, int* owner, struct PartWork* work){
+    part_balance(g, owner, work);
+    long cut = part_cut(g, owner);
+    for (int pass = 0; pass < PARTITION_REFINE_PASSES; pass++){
+        long after = part_fm_pass(g, owner, work, cut);
+        if (after >= cut){
+            break;
+        }
+        cut = after;
+    }
+    return cut;
+}
+
+/**
+ * @brief split the coarsest graph by growing regions breadth-first
+ *
+ * regions grow one after another, each from the unclaimed vertex farthest
+ * from the start and stopping at an equal share of the rooms still
+ * unclaimed. a region that runs out of reachable vertices starts again
+ * from the next farthest one
+ *
+ * @param[in] g coarsest graph
+ * @param[out] owner region of each vertex
+ * @param[in,out] work scratch state; sizes are filled in
+ * @param[in] start vertex distances are measured from
+ */
+static void part_grow(const struct PartGraph* g, int* owner, struct PartWork* work, int start){
+    int n = g->n;
+    int* order = work->order;
+    int* dist = work->dist;
+    int* frontier = work->frontier;
+
+    // order lists the vertices nearest the start first, other components after
+    for (int v = 0; v < n; v++){
+        dist[v] = -1;
+        owner[v] = -1;
+    }
+    int head = 0, tail = 0;
+    for (int s = 0; s < n; s++){
+        int source = s == 0 ? start : s;
+        if (dist[source] >= 0){
+            continue;
+        }
+        dist[source] = 0;
+        order[tail++] = source;
+        while (head < tail){
+            int v = order[head++];
+            for (int e = g->xadj[v]; e < g->xadj[v + 1]; e++){
+                int u = g->adj[e];
+                if (dist[u] < 0){
+                    dist[u] = dist[v] + 1;
+                    order[tail++] = u;
+                }
+            }
+        }
+    }
+
+    int k = work->regions;
+    int far = n - 1;
+    long left = g->total;
+    for (int r = 0; r < k; r++){
+        work->size[r] = 0;
+    }
+    for (int r = 0; r < k; r++){
+        long want = (left + (k - r) - 1) / (k - r);
+        head = 0;
+        tail = 0;
+        while (work->size[r] < want){
+            if (head == tail){
+                while (far >= 0 && owner[order[far]] >= 0){
+                    far--;
+                }
+                if (far < 0){
+                    break;
+                }
+                owner[order[far]] = r;
+                work->size[r] += g->vwgt[order[far]];
+                frontier[tail++] = order[far];
+                continue;
+            }
+            int v = frontier[head++];
+            for (int e = g->xadj[v]; e < g->xadj[v + 1] && work->size[r] < want; e++){
+                int u = g->adj[e];
+                if (owner[u] < 0){
+                    owner[u] = r;
+                    work->size[r] += g->vwgt[u];
+                    frontier[tail++] = u;
+                }
+            }
+        }
+        left -= work->size[r];
+    }
+
+    // heavy vertices can use up the rooms before the last region; give it any left over
+    for (int v = 0; v < n; v++){
+        if (owner[v] < 0){
+            owner[v] = k - 1;
+            work->size[k - 1] += g->vwgt[v];
+        }
+    }
+}
+
+static void part_limits(struct PartWork* work, long total){
+    double target = (double)total / work->regions;
+    work->maxSize = (long)(target * (1.0 + PARTITION_BALANCE_SLACK)) + 1;
+    work->minSize = (long)(target * (1.0 - PARTITION_BALANCE_SLACK));
+    if (work->minSize < 1){
+        work->minSize = 1;
+    }
+}
+
+/**
+ * @brief split the rooms into balanced regions with few cut doors
+ *
+ * multilevel partitioning: the door graph is coarsened by merging rooms
+ * along heavy edges until about PARTITION_COARSEST vertices per region are
+ * left. the coarsest graph is split by growing regions breadth-first,
+ * once from the room farthest from the exit and again from a few random
+ * rooms, each split refined and the one cutting fewest doors kept. the
+ * split is then projected back one level at a time, and at every level
+ * Fiduccia-Mattheyses passes move boundary vertices across the cut while
+ * every region stays within PARTITION_BALANCE_SLACK of the average. the
+ * result is stored in every room's region field
+ *
+ * @param[in,out] museum pointer to museum with rooms built
+ * @param[in] regions number of regions wanted
+ * @param[out] cutDoors doors whose rooms ended up in different regions
+ * @param[out] imbalance largest region size over the average
+ *
+ * @return number of regions used, 0 if memory ran out
+ */
+int museum_partition(struct Museum* museum, int regions, unsigned long* cutDoors, double* imbalance){
+    int n = museum->room_count;
+    if (regions > n){
+        regions = n;
+    }
+    if (regions > PARTITION_MAX_REGIONS){
+        regions = PARTITION_MAX_REGIONS;
+    }
+    if (regions < 1){
+        regions = 1;
+    }
+
+    struct PartGraph levels[PARTITION_MAX_LEVELS];
+    memset(levels, 0, sizeof(levels));
+    struct PartWork work;
+    memset(&work, 0, sizeof(work));
+    work.regions = regions;
+
+    int* owner = malloc(sizeof(int) * n);
+    int* spare = malloc(sizeof(int) * n);
+    work.heap.heap = malloc(sizeof(int) * n);
+    work.heap.pos = malloc(sizeof(int) * n);
+    work.heap.key = malloc(sizeof(int) * n);
+    work.moved = malloc(sizeof(int) * n);
+    work.movedFrom = malloc(sizeof(int) * n);
+    work.state = calloc(n, 1);
+    work.deferred = malloc(sizeof(int) * n);
+    bool ok = owner && spare && work.heap.heap && work.heap.pos && work.heap.key &&
+              work.moved && work.movedFrom && work.state && work.deferred && part_graph_from_museum(museum, &levels[0]);
+
+    // coarsen while matching still shrinks the graph
+    int depth = 1;
+    int coarsest = PARTITION_COARSEST * regions;
+    int maxWeight = (int)(1.5 * n / coarsest) + 1;
+    uint64_t rng = 0x5EED;
+    while (ok && depth < PARTITION_MAX_LEVELS && levels[depth - 1].n > coarsest){
+        int* scratch[2] = { owner, spare };
+        ok = part_coarsen(&levels[depth - 1], &levels[depth], maxWeight, &rng, scratch);
+        if (ok && levels[depth].n > PARTITION_SHRINK * levels[depth - 1].n){
+            part_graph_free(&levels[depth]);
+            break;
+        }
+        depth += ok ? 1 : 0;
+    }
+
+    struct PartGraph* top = &levels[depth - 1];
+    if (ok){
+        work.order = malloc(sizeof(int) * top->n);
+        work.frontier = malloc(sizeof(int) * top->n);
+        work.dist = malloc(sizeof(int) * top->n);
+        ok = work.order && work.frontier && work.dist;
+    }
+
+    if (ok){
+        for (int v = 0; v < top->n; v++){
+            work.heap.pos[v] = -1;
+        }
+        part_limits(&work, top->total);
+
+        // the exit room's vertex on the coarsest level
+        int exit = (int)(museum->starting_room - museum->rooms);
+        for (int l = 0; l + 1 < depth; l++){
+            exit = levels[l].cmap[exit];
+        }
+
+        long best = -1;
+        long bestSize[PARTITION_MAX_REGIONS];
+        for (int t = 0; t < PARTITION_TRIES; t++){
+            int start = t == 0 ? exit : (int)(part_random(&rng) % (uint64_t)top->n);
+            part_grow(top, spare, &work, start);
+            long cut = part_refine(top, spare, &work);
+            if (best < 0 || cut < best){
+                best = cut;
+                memcpy(owner, spare, sizeof(int) * top->n);
+                memcpy(bestSize, work.size, sizeof(bestSize));
+            }
+        }
+        memcpy(work.size, bestSize, sizeof(bestSize));
+
+        // project the split back and refine it on every finer level
+        for (int l = depth - 2; l >= 0; l--){
+            struct PartGraph* g = &levels[l];
+            for (int v = 0; v < g->n; v++){
+                spare[v] = owner[g->cmap[v]];
+                work.heap.pos[v] = -1;
+            }
+            int* t = owner;
+            owner = spare;
+            spare = t;
+            part_limits(&work, g->total);
+            part_refine(g, owner, &work);
+        }
+
+        unsigned long cut = 0;
+        long largest = 0;
+        for (int i = 0; i < n; i++){
+            struct Room* room = &museum->rooms[i];
+            room->region = owner[i];
+            for (int j = 0; j < room->connections; j++){
+                int other = (int)(room->connectedRooms[j] - museum->rooms);
+                if (other > i && owner[other] != owner[i]){
+                    cut++;
+                }
+            }
+        }
+        for (int r = 0; r < regions; r++){
+            if (work.size[r] > largest){
+                largest = work.size[r];
+            }
+        }
+        *cutDoors = cut;
+        *imbalance = (double)largest * regions / n;
+    }
+
+    for (int l = 0; l < PARTITION_MAX_LEVELS; l++){
+        part_graph_free(&levels[l]);
+    }
+    free(owner);
+    free(spare);
+    free(work.heap.heap);
+    free(work.heap.pos);
+    free(work.heap.key);
+    free(work.moved);
+    free(work.movedFrom);
+    free(work.state);
+    free(work.deferred);
+    free(work.order);
+    free(work.frontier);
+    free(work.dist);
+    return ok ? regions : 0;
+}
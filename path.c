@@ -1,33 +1,50 @@
 #include "defs.h"
 #include <stdlib.h>
+
+// Capacity given to a fresh breadcrumb so short walks never allocate
+#define ROOMSTACK_INITIAL 16
+
 /**
  * @brief initialize a roomstack
  *
- * initializes new empty stack
+ * initializes new empty stack of room indices and allocates a small
+ * starting capacity up front
  *
  * @param[out] stack pointer to the roomstack
+ * @param[in] rooms base of the room array the indices refer to
  */
-void roomstack_init(struct RoomStack* stack){
-    stack->head = NULL;
+void roomstack_init(struct RoomStack* stack, struct Room* rooms){
+    stack->rooms = rooms;
+    stack->size = 0;
+    stack->capacity = 0;
+    stack->items = malloc(ROOMSTACK_INITIAL * sizeof(uint32_t));
+    if (stack->items){
+        stack->capacity = ROOMSTACK_INITIAL;
+    }
 }
 
 /**
  * @brief push a room onto the top of the stack.
  *
- * allocates new roomnode and inserts it at the front of the list
+ * stores the room's index; the array only grows (by doubling) when a walk
+ * is longer than any walk before it, so steady-state pushes never allocate
  *
  * @param[in,out] stack pointer to the roomstack 
  * @param[in] room pointer to the room being pushed.
  */
 void push(struct RoomStack* stack, struct Room* room){
-    struct RoomNode* node = malloc(sizeof(struct RoomNode));
-    if (!node){
-        return;
+    if (stack->size >= stack->capacity){
+        uint32_t resize = (stack->capacity == 0 ? ROOMSTACK_INITIAL : 2 * stack->capacity);
+        uint32_t* newArr = realloc(stack->items, resize * sizeof(uint32_t));
+        if (!newArr){
+            return;
+        }
+
+        stack->items = newArr;
+        stack->capacity = resize;
     }
 
-    node->room = room;
-    node->next = stack->head;
-    stack->head = node;
+    stack->items[stack->size++] = (uint32_t)(room - stack->rooms);
 }
 
 /**
@@ -40,30 +57,32 @@ void push(struct RoomStack* stack, struct Room* room){
  * @return pointer to popped room
  */
 struct Room* pop(struct RoomStack* stack){
-    if (!stack->head){
+    if (stack->size == 0){
         return NULL;
     }
 
-    struct RoomNode* node = stack->head;
-    struct Room* room = node->room;
-    stack->head = node->next;
-    free(node);
-
-    return room;
+    return &stack->rooms[stack->items[--stack->size]];
 }
 
 /**
  * @brief empty a roomstack
  *
- * iterates through linked list and frees each node.
+ * drops every entry but keeps the capacity for the next walk
  *
  * @param[in,out] stack pointer to the breadcrumb
  */
 void empty_roomstack(struct RoomStack* stack){
-    while (stack->head){
-        struct RoomNode* node = stack->head;
-        stack->head = node->next;
-        free(node);
-    }
+    stack->size = 0;
 }
 
+/**
+ * @brief release a roomstack's memory
+ *
+ * @param[in,out] stack pointer to the breadcrumb
+ */
+void roomstack_free(struct RoomStack* stack){
+    free(stack->items);
+    stack->items = NULL;
+    stack->size = 0;
+    stack->capacity = 0;
+}
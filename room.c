@@ -1,9 +1,30 @@
 #include "defs.h"
 #include <string.h>
-#include <semaphore.h>
+#include "lock.h"
 #include "helpers.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
+
+// Layout of Room.occupancy
+#define OCC_GUARD_ONE   1ULL
+#define OCC_THIEF_ONE   (1ULL << 32)
+#define OCC_GUARDS(w)   ((int)((w) & 0xFFFFFFFFULL))
+#define OCC_THIEVES(w)  ((int)((w) >> 32))
+
+// Soft limit on guards per room, 0 for none
+static int guard_cap = 0;
+
+// Set while the sharded engine runs: every room is touched only by the
+// worker owning its region, so room locks are skipped
+static bool rooms_owned = false;
+
+// Room locks this thread took after a thread on another NUMA node
+static _Thread_local unsigned long cross_node_locks = 0;
+
+// Room locks this thread found taken, and how long it waited for them
+static _Thread_local unsigned long lock_waits = 0;
+static _Thread_local unsigned long lock_wait_ns = 0;
 
 /**
  * @brief initialize room struct using default values
@@ -17,59 +38,112 @@
 void room_init(struct Room* room, const char* name, bool isExit){
     strncpy(room->name, name, MAX_ROOM_NAME);
     room->name[MAX_ROOM_NAME - 1] = '\0';
+    room->connectedRooms = NULL;
     room->connections = 0;
-    room->thief = NULL;
-    room->guardCount = 0;
+    room->doorCapacity = 0;
+    atomic_init(&room->guardSlots, NULL);
+    atomic_init(&room->guardCount, 0);
     room->isExit = isExit;
-    room->evidence = 0;
+    room->toExit = NULL;
+    room->exitDistance = isExit ? 0 : -1;
+    room->region = 0;
+    room->lastNode = -1;
+    atomic_init(&room->waitNs, 0);
+    atomic_init(&room->occupancy, 0);
+    atomic_init(&room->evidence, 0);
+    atomic_init(&room->scanned, 0);
+    atomic_init(&room->lastVisit, 0);
+    room->droppedBy = NULL;
 
-    for (int i = 0; i < MAX_CONNECTIONS; i++){
-        room->connectedRooms[i] = NULL;
-    }
-    for (int i = 0; i < MAX_ROOM_OCCUPANCY; i++){
-        room->guards[i] = NULL;
-    }
 
-    sem_init(&room->mutex, 0, 1);
+    lock_init(&room->mutex);
+    lock_profile_attach(&room->mutex, "room", room->name);
 }
 
 /**
  * @brief link two rooms so movement between them becomes possible
  *
- * new link added to each room list if room still has open link slot
+ * new link added to each room list if room still has open link slot; the
+ * slots are sized from the layout by museum_build, so no door is dropped
  *
  * @param[in,out] first pointer to room being linked
  * @param[in,out] second pointer to room being linked
  */
 void room_connect(struct Room* first, struct Room* second){
-    if (first->connections < MAX_CONNECTIONS){
+    if (first->connections < first->doorCapacity){
         first->connectedRooms[first->connections++] = second;
     }
-    if (second->connections < MAX_CONNECTIONS){
+    if (second->connections < second->doorCapacity){
         second->connectedRooms[second->connections++] = first;
     }
 }
 
+/**
+ * @brief replace a room's guard slots with an array twice the size
+ *
+ * caller holds the room lock. the old array is kept on the retired chain
+ * because readers may still be scanning it. slots come from shm_alloc so
+ * guard processes sharing the museum see them
+ *
+ * @param[in,out] room pointer to room
+ *
+ * @return false if memory allocation failed
+ */
+static bool room_grow_slots(struct Room* room){
+    struct GuardSlots* old = atomic_load_explicit(&room->guardSlots, memory_order_relaxed);
+    int capacity = old ? old->capacity * 2 : ROOM_INITIAL_SLOTS;
+
+    struct GuardSlots* slots = shm_alloc(_Alignof(struct GuardSlots), sizeof(struct GuardSlots) + (size_t)capacity * sizeof(slots->entries[0]));
+    if (!slots){
+        return false;
+    }
+
+    int used = atomic_load_explicit(&room->guardCount, memory_order_relaxed);
+    for (int i = 0; i < capacity; i++){
+        struct Guard* guard = (old && i < used) ? atomic_load_explicit(&old->entries[i], memory_order_relaxed) : NULL;
+        atomic_init(&slots->entries[i], guard);
+    }
+    slots->capacity = capacity;
+    slots->retired = old;
+
+    atomic_store_explicit(&room->guardSlots, slots, memory_order_release);
+    return true;
+}
+
 /**
  * @brief place hunter inside room
  *
- * hunter count grows if room has open slot
+ * appends to the room's guard slots, growing them when full, and records the
+ * slot in the hunter so it can be removed without a search. caller holds
+ * the room lock
  *
  * @param[in,out] room pointer room receiving hunter
- * @param[in] hunter pointer to hunter being added
+ * @param[in,out] hunter pointer to hunter being added
+ *
+ * @return false if the slots could not grow
  */
-void add_guard(struct Room* room, struct Guard* hunter){
-    if (room->guardCount >= MAX_ROOM_OCCUPANCY){
-        return;
+bool add_guard(struct Room* room, struct Guard* hunter){
+    struct GuardSlots* slots = atomic_load_explicit(&room->guardSlots, memory_order_relaxed);
+    int used = atomic_load_explicit(&room->guardCount, memory_order_relaxed);
+
+    if (!slots || used >= slots->capacity){
+        if (!room_grow_slots(room)){
+            return false;
+        }
+        slots = atomic_load_explicit(&room->guardSlots, memory_order_relaxed);
     }
 
-    room->guards[room->guardCount++] = hunter;
+    atomic_store_explicit(&slots->entries[used], hunter, memory_order_release);
+    hunter->roomSlot = used;
+    atomic_store_explicit(&room->guardCount, used + 1, memory_order_release);
+    return true;
 }
 
 /**
  * @brief remove hunter from room
  *
- * removes hunter from dynamic array and performs arraylist shift
+ * swap-remove: the last guard moves into the hunter's slot and has its slot
+ * index updated, so removal is O(1). caller holds the room lock
  *
  * @param[in,out] room pointer to room holding hunter
  * @param[in] hunter pointer to hunter being removed
@@ -79,20 +153,325 @@ void remove_guard(struct Room* room, struct Guard* hunter){
         return;
     }
 
-    if (room->guardCount == 0){
+    struct GuardSlots* slots = atomic_load_explicit(&room->guardSlots, memory_order_relaxed);
+    int used = atomic_load_explicit(&room->guardCount, memory_order_relaxed);
+    int slot = hunter->roomSlot;
+
+    if (!slots || slot < 0 || slot >= used ||
+        atomic_load_explicit(&slots->entries[slot], memory_order_relaxed) != hunter){
         return;
     }
 
-    for (int i = 0; i < room->guardCount; i++){
-        if (room->guards[i] == hunter){
-            for (int j = i; j < room->guardCount - 1; j++){
-                room->guards[j] = room->guards[j + 1];
-            }
+    int last = used - 1;
+    struct Guard* moved = atomic_load_explicit(&slots->entries[last], memory_order_relaxed);
+    atomic_store_explicit(&slots->entries[slot], moved, memory_order_release);
+    moved->roomSlot = slot;
+    atomic_store_explicit(&slots->entries[last], NULL, memory_order_release);
+    atomic_store_explicit(&room->guardCount, last, memory_order_release);
+    hunter->roomSlot = -1;
+}
+
+/**
+ * @brief copy the guards listed in a room without taking its lock
+ *
+ * weakly consistent: a guard that moves during the scan may be missed or,
+ * after a swap-remove, seen twice, but every pointer returned is a guard
+ * that was listed in the room at some point during the call
+ *
+ * @param[in] room pointer to room
+ * @param[out] out destination array
+ * @param[in] max size of out
+ *
+ * @return number of guards copied
+ */
+int room_collect_guards(struct Room* room, struct Guard** out, int max){
+    struct GuardSlots* slots = atomic_load_explicit(&room->guardSlots, memory_order_acquire);
+    if (!slots){
+        return 0;
+    }
+
+    int used = atomic_load_explicit(&room->guardCount, memory_order_acquire);
+    if (used > slots->capacity){
+        used = slots->capacity;
+    }
+
+    int found = 0;
+    for (int i = 0; i < used && found < max; i++){
+        struct Guard* guard = atomic_load_explicit(&slots->entries[i], memory_order_acquire);
+        if (guard){
+            out[found++] = guard;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief free a room's guard slots and every array they replaced
+ *
+ * only safe once no thread can read the room
+ *
+ * @param[in,out] room pointer to room
+ */
+void room_free_slots(struct Room* room){
+    struct GuardSlots* slots = atomic_load_explicit(&room->guardSlots, memory_order_relaxed);
+    while (slots){
+        struct GuardSlots* retired = slots->retired;
+        shm_free(slots);
+        slots = retired;
+    }
+    atomic_store_explicit(&room->guardSlots, NULL, memory_order_relaxed);
+    atomic_store_explicit(&room->guardCount, 0, memory_order_relaxed);
+}
+
+/**
+ * @brief set the soft limit on guards per room
+ *
+ * @param[in] cap maximum guards room_guard_reserve admits, 0 for no limit
+ */
+void room_set_guard_cap(int cap){
+    guard_cap = cap > 0 ? cap : 0;
+}
+
+/**
+ * @brief current soft limit on guards per room
+ *
+ * @return limit, 0 when unlimited
+ */
+int room_get_guard_cap(void){
+    return guard_cap;
+}
+
+/**
+ * @brief number of guards in a room, read without the room lock
+ *
+ * @param[in] room pointer to room
+ *
+ * @return guards currently counted in the room
+ */
+int room_guard_count(struct Room* room){
+    return OCC_GUARDS(atomic_load_explicit(&room->occupancy, memory_order_acquire));
+}
+
+/**
+ * @brief check for a thief in the room, read without the room lock
+ *
+ * @param[in] room pointer to room
+ *
+ * @return true when at least one thief is in the room
+ */
+bool room_has_thief(struct Room* room){
+    return OCC_THIEVES(atomic_load_explicit(&room->occupancy, memory_order_acquire)) > 0;
+}
+
+/**
+ * @brief count a guard into a room regardless of occupancy
+ *
+ * used for the starting room and for guards retracing their path, which
+ * have never been turned away
+ *
+ * @param[in,out] room pointer to room
+ */
+void room_guard_enter(struct Room* room){
+    atomic_fetch_add_explicit(&room->occupancy, OCC_GUARD_ONE, memory_order_acq_rel);
+}
+
+/**
+ * @brief claim a guard slot in a room before moving into it
+ *
+ * the ownership step of a move. without a cap rooms never fill and the
+ * claim is a single fetch-add; with a cap set the room is validated to
+ * still have space and the claim is published with one compare-and-swap,
+ * retrying when another entity changed the occupancy word in between
+ *
+ * @param[in,out] room pointer to room being claimed
+ * @param[in,out] retries incremented for every lost compare-and-swap
+ *
+ * @return true if a slot was claimed, false if the room is at the cap
+ */
+bool room_guard_reserve(struct Room* room, unsigned long* retries){
+    int cap = guard_cap;
+    if (cap == 0){
+        room_guard_enter(room);
+        return true;
+    }
+
+    uint64_t seen = atomic_load_explicit(&room->occupancy, memory_order_acquire);
+
+    while (OCC_GUARDS(seen) < cap){
+        if (atomic_compare_exchange_weak_explicit(&room->occupancy, &seen, seen + OCC_GUARD_ONE,
+                                                  memory_order_acq_rel, memory_order_acquire)){
+            return true;
+        }
+        (*retries)++;
+    }
+
+    return false;
+}
 
-            room->guards[room->guardCount - 1] = NULL;
-            room->guardCount--;
-            break;
+/**
+ * @brief count a guard out of a room
+ *
+ * @param[in,out] room pointer to room
+ */
+void room_guard_leave(struct Room* room){
+    atomic_fetch_sub_explicit(&room->occupancy, OCC_GUARD_ONE, memory_order_acq_rel);
+}
+
+/**
+ * @brief count a thief into a room
+ *
+ * @param[in,out] room pointer to room
+ */
+void room_thief_enter(struct Room* room){
+    atomic_fetch_add_explicit(&room->occupancy, OCC_THIEF_ONE, memory_order_acq_rel);
+}
+
+/**
+ * @brief count a thief out of a room as long as no guard is present
+ *
+ * guard and thief counts share one word, so the check that the room is
+ * empty of guards and the departure happen in the same compare-and-swap
+ *
+ * @param[in,out] room pointer to room being left
+ * @param[in,out] retries incremented for every lost compare-and-swap
+ *
+ * @return true if the thief left, false if guards are present
+ */
+bool room_thief_leave(struct Room* room, unsigned long* retries){
+    uint64_t seen = atomic_load_explicit(&room->occupancy, memory_order_acquire);
+
+    while (OCC_GUARDS(seen) == 0 && OCC_THIEVES(seen) > 0){
+        if (atomic_compare_exchange_weak_explicit(&room->occupancy, &seen, seen - OCC_THIEF_ONE,
+                                                  memory_order_acq_rel, memory_order_acquire)){
+            return true;
         }
+        (*retries)++;
+    }
+
+    return false;
+}
+
+/**
+ * @brief mark rooms as owned by single threads, or shared again
+ *
+ * @param[in] owned true while each room is only touched by one thread
+ */
+void room_set_owned(bool owned){
+    rooms_owned = owned;
+}
+
+/**
+ * @brief record the calling thread's node on a room it just locked
+ *
+ * counts a crossing when the previous pinned locker ran on another node,
+ * which is when the room's lock and hot fields have to cross sockets.
+ * unpinned threads are not tracked
+ *
+ * @param[in,out] room pointer to room, locked by the caller
+ */
+static void room_note_node(struct Room* room){
+    int node = affinity_thread_node();
+    if (node < 0){
+        return;
+    }
+    if (room->lastNode >= 0 && room->lastNode != node){
+        cross_node_locks++;
+    }
+    room->lastNode = node;
+}
+
+/**
+ * @brief number of room locks the calling thread took across NUMA nodes
+ *
+ * @return crossings counted by room_note_node on this thread
+ */
+unsigned long room_thread_cross_node(void){
+    return cross_node_locks;
+}
+
+/**
+ * @brief number of room locks the calling thread had to wait for
+ *
+ * @return contended acquisitions counted by room_acquire on this thread
+ */
+unsigned long room_thread_lock_waits(void){
+    return lock_waits;
+}
+
+/**
+ * @brief time the calling thread spent waiting for room locks
+ *
+ * @return nanoseconds counted by room_acquire on this thread
+ */
+unsigned long room_thread_lock_wait_ns(void){
+    return lock_wait_ns;
+}
+
+/**
+ * @brief lock a room and keep its average wait up to date
+ *
+ * a free lock is taken with one try and costs no clock reads; only a lock
+ * that is already taken is timed. the room's average moves an eighth of
+ * the way to each sample, so uncontended acquisitions decay it towards 0
+ *
+ * @param[in,out] room pointer to room
+ */
+static void room_acquire(struct Room* room){
+    uint32_t waited = 0;
+    if (!lock_try_acquire(&room->mutex)){
+        unsigned long long start = stats_now_ns();
+        lock_acquire_contended(&room->mutex);
+        unsigned long long ns = stats_now_ns() - start;
+        lock_waits++;
+        lock_wait_ns += ns;
+        waited = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+    }
+
+    // only the holder writes, so a plain load and store cannot lose an update
+    uint32_t average = atomic_load_explicit(&room->waitNs, memory_order_relaxed);
+    if (average != 0 || waited != 0){
+        atomic_store_explicit(&room->waitNs, average - average / 8 + waited / 8, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief congestion of a room as seen by a guard choosing where to go
+ *
+ * guards in the room plus one for every ROOM_WAIT_PER_GUARD_NS of average
+ * lock wait; a room at the --room-cap limit is as congested as can be
+ *
+ * @param[in] room pointer to room
+ *
+ * @return congestion score, higher is busier
+ */
+int room_congestion(struct Room* room){
+    int guards = room_guard_count(room);
+    if (guard_cap > 0 && guards >= guard_cap){
+        return INT_MAX;
+    }
+    return guards + (int)(atomic_load_explicit(&room->waitNs, memory_order_relaxed) / ROOM_WAIT_PER_GUARD_NS);
+}
+
+/**
+ * @brief lock one room, unless rooms are thread-owned
+ *
+ * @param[in,out] room pointer to room
+ */
+void room_lock(struct Room* room){
+    if (!rooms_owned){
+        room_acquire(room);
+        room_note_node(room);
+    }
+}
+
+/**
+ * @brief unlock a room locked with room_lock
+ *
+ * @param[in,out] room pointer to room
+ */
+void room_unlock(struct Room* room){
+    if (!rooms_owned){
+        lock_release(&room->mutex);
     }
 }
 
@@ -103,13 +482,18 @@ void remove_guard(struct Room* room, struct Guard* hunter){
  * @param[in,out] to pointer to second room
  */
 void lock_rooms(struct Room* from, struct Room* to){
+    if (rooms_owned){
+        return;
+    }
     if (from < to){
-        sem_wait(&from->mutex);
-        sem_wait(&to->mutex);
+        room_acquire(from);
+        room_acquire(to);
     } else {
-        sem_wait(&to->mutex);
-        sem_wait(&from->mutex);
+        room_acquire(to);
+        room_acquire(from);
     }
+    room_note_node(from);
+    room_note_node(to);
 }
 
 /**
@@ -119,12 +503,15 @@ void lock_rooms(struct Room* from, struct Room* to){
  * @param[in,out] to pointer to second room
  */
 void unlock_rooms(struct Room* from, struct Room* to){
+    if (rooms_owned){
+        return;
+    }
     if (from < to){
-        sem_post(&from->mutex);
-        sem_post(&to->mutex);
+        lock_release(&from->mutex);
+        lock_release(&to->mutex);
     } else {
-        sem_post(&to->mutex);
-        sem_post(&from->mutex);
+        lock_release(&to->mutex);
+        lock_release(&from->mutex);
     }
 }
 
@@ -144,39 +531,32 @@ void in_control_room(struct Guard* hunter){
 
     empty_roomstack(&hunter->breadcrumb);
 
-    sem_wait(&hunter->casefile->mutex);
-    bool solved = hunter->casefile->solved;
-    EvidenceByte collected = hunter->casefile->collected;
-    sem_post(&hunter->casefile->mutex);
+    bool solved = casefile_solved(hunter->casefile);
 
-    sem_wait(&hunter->mutex);
     int boredom = hunter->boredom;
     int stress = hunter->stress;
-    enum TamperType device = hunter->device;
+    EvidenceMask device = hunter->device;
     bool wasReturning = hunter->returningToControl;
     hunter->returningToControl = false;
-    sem_post(&hunter->mutex);
 
-    sem_wait(&room->mutex);
     update_state(hunter);
-    sem_post(&room->mutex);
 
-    if (solved && evidence_is_valid_ghost(collected)){
-        sem_wait(&room->mutex);
+    if (solved){
+        room_lock(room);
         remove_guard(room, hunter);
-        sem_post(&room->mutex);
+        room_unlock(room);
+        room_guard_leave(room);
 
-        sem_wait(&hunter->mutex);
         hunter->active = false;
         hunter->whyExit = LR_CLUES;
-        sem_post(&hunter->mutex);
-
+        casefile_swap_device(hunter->casefile, device, 0);
         log_return_to_van(hunter->id, boredom, stress, room->name, device, false);
         log_exit(hunter->id, boredom, stress, room->name, device, LR_CLUES);
         return;
     }
 
     if (wasReturning){
+        hunter->returns++;
         log_return_to_van(hunter->id, boredom, stress, room->name, device, false);
         change_device(hunter);
     }
@@ -0,0 +1,496 @@
+#include "defs.h"
+#include "helpers.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SHARD_QUEUE_SIZE 256          // Power of two
+
+// One guard or thief crossing from one region to the next
+struct ShardMsg {
+    struct Guard* guard;              // NULL when a thief is being handed over
+    struct Thief* thief;
+    struct Room* from;
+    struct Room* to;
+};
+
+// Bounded single-producer single-consumer ring. Each index is written by one
+// side only and lives on its own cache line.
+struct ShardQueue {
+    _Alignas(CACHE_LINE) atomic_uint head;  // Next slot to read, written by the consumer
+    _Alignas(CACHE_LINE) atomic_uint tail;  // Next slot to write, written by the producer
+    _Alignas(CACHE_LINE) struct ShardMsg slots[SHARD_QUEUE_SIZE];
+};
+
+struct ShardEngine;
+
+struct ShardWorker {
+    _Alignas(CACHE_LINE) int region;
+    struct ShardEngine* engine;
+    struct Guard** guards;            // Guards in this region, owned by this worker only
+    int guardCount;
+    int guardCap;
+    struct Thief** thieves;           // Thieves in this region, owned by this worker only
+    int thiefCount;
+    int thiefCap;
+    struct ShardQueue** incoming;     // Queues other regions write to this one
+    int incomingCount;
+    struct LatencyHist hist;
+    unsigned long thiefTurns;
+    unsigned long handoffs;
+    unsigned long queueFull;
+    unsigned long lockOps;
+    unsigned long crossNode;          // Handoffs to a worker pinned to another NUMA node
+    pthread_t thread;
+};
+
+struct ShardEngine {
+    struct Museum* museum;
+    int regions;
+    struct ShardQueue** queues;       // [from * regions + to], NULL for regions that share no door
+    struct ShardWorker* workers;
+    _Alignas(CACHE_LINE) atomic_int active;  // Guards and thieves still in the simulation
+    atomic_bool failed;               // A worker could not grow its lists and stopped the run
+};
+
+/**
+ * @brief try to put a message on a queue
+ *
+ * @param[in,out] queue queue written only by the calling worker
+ * @param[in] msg message to copy in
+ *
+ * @return false if the queue is full
+ */
+static bool queue_push(struct ShardQueue* queue, const struct ShardMsg* msg){
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head >= SHARD_QUEUE_SIZE){
+        return false;
+    }
+
+    queue->slots[tail & (SHARD_QUEUE_SIZE - 1)] = *msg;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * @brief check whether a queue has no free slot
+ *
+ * @param[in] queue queue written only by the calling worker
+ *
+ * @return true if a push would fail
+ */
+static bool queue_full(struct ShardQueue* queue){
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    return tail - head >= SHARD_QUEUE_SIZE;
+}
+
+/**
+ * @brief take the oldest message off a queue
+ *
+ * @param[in,out] queue queue read only by the calling worker
+ * @param[out] msg message copied out
+ *
+ * @return false if the queue is empty
+ */
+static bool queue_pop(struct ShardQueue* queue, struct ShardMsg* msg){
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail){
+        return false;
+    }
+
+    *msg = queue->slots[head & (SHARD_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * @brief make room for one more guard and one more thief in a worker's lists
+ *
+ * called before a message is taken off a queue, so a failed allocation
+ * leaves the guard or thief queued instead of dropping it
+ *
+ * @param[in,out] worker owning worker
+ *
+ * @return false if either list could not be grown
+ */
+static bool worker_reserve(struct ShardWorker* worker){
+    if (worker->guardCount >= worker->guardCap){
+        int resize = worker->guardCap == 0 ? 16 : worker->guardCap * 2;
+        struct Guard** guards = realloc(worker->guards, sizeof(struct Guard*) * resize);
+        if (!guards){
+            return false;
+        }
+        worker->guards = guards;
+        worker->guardCap = resize;
+    }
+    if (worker->thiefCount >= worker->thiefCap){
+        int resize = worker->thiefCap == 0 ? 4 : worker->thiefCap * 2;
+        struct Thief** thieves = realloc(worker->thieves, sizeof(struct Thief*) * resize);
+        if (!thieves){
+            return false;
+        }
+        worker->thieves = thieves;
+        worker->thiefCap = resize;
+    }
+    return true;
+}
+
+/**
+ * @brief add a guard to the list a worker runs
+ *
+ * the caller must have reserved a slot with worker_reserve
+ *
+ * @param[in,out] worker owning worker
+ * @param[in,out] guard guard now in the worker's region
+ */
+static void worker_adopt(struct ShardWorker* worker, struct Guard* guard){
+    guard->region = worker->region;
+    worker->guards[worker->guardCount++] = guard;
+}
+
+/**
+ * @brief add a thief to the list a worker runs
+ *
+ * the caller must have reserved a slot with worker_reserve
+ *
+ * @param[in,out] worker owning worker
+ * @param[in] thief thief now in the worker's region
+ */
+static void worker_adopt_thief(struct ShardWorker* worker, struct Thief* thief){
+    worker->thieves[worker->thiefCount++] = thief;
+}
+
+/**
+ * @brief stop every worker because one of them could not go on
+ *
+ * @param[in,out] worker failing worker
+ */
+static void worker_fail(struct ShardWorker* worker){
+    struct ShardEngine* engine = worker->engine;
+    if (!atomic_exchange_explicit(&engine->failed, true, memory_order_acq_rel)){
+        fprintf(stderr, "Region %d worker ran out of memory, stopping the run\n", worker->region);
+    }
+    atomic_store_explicit(&engine->active, 0, memory_order_release);
+}
+
+/**
+ * @brief find the queue to another region, if it has a free slot
+ *
+ * only the calling worker writes to the queue, so a free slot stays free
+ * until it pushes; state can be handed over before the message is queued
+ *
+ * @param[in,out] worker sending worker
+ * @param[in] to destination region
+ *
+ * @return the queue, NULL if it is full
+ */
+static struct ShardQueue* worker_outbox(struct ShardWorker* worker, int to){
+    struct ShardEngine* engine = worker->engine;
+    struct ShardQueue* queue = engine->queues[worker->region * engine->regions + to];
+    if (!queue || queue_full(queue)){
+        worker->queueFull++;
+        return NULL;
+    }
+    worker->handoffs++;
+    if (affinity_node_for(worker->region) != affinity_node_for(to)){
+        worker->crossNode++;
+    }
+    return queue;
+}
+
+/**
+ * @brief take every waiting guard and thief off the worker's incoming queues
+ *
+ * @param[in,out] worker receiving worker
+ */
+static void worker_drain(struct ShardWorker* worker){
+    struct ShardMsg msg;
+    for (int q = 0; q < worker->incomingCount; q++){
+        while (true){
+            if (!worker_reserve(worker)){
+                worker_fail(worker);
+                return;
+            }
+            if (!queue_pop(worker->incoming[q], &msg)){
+                break;
+            }
+            if (msg.guard){
+                guard_arrive(msg.guard, msg.from, msg.to);
+                worker_adopt(worker, msg.guard);
+            } else {
+                worker_adopt_thief(worker, msg.thief);
+            }
+        }
+    }
+}
+
+/**
+ * @brief run one turn of every entity in the region
+ *
+ * guards that finish a turn with handoffTo set leave through a queue, or
+ * stay put if it is full; guards that left the simulation are dropped
+ *
+ * @param[in,out] worker worker running the turn
+ */
+static void worker_tick(struct ShardWorker* worker){
+    struct ShardEngine* engine = worker->engine;
+
+    for (int i = 0; i < worker->guardCount; ){
+        struct Guard* guard = worker->guards[i];
+
+        unsigned long long start = stats_now_ns();
+        guard_take_turn(guard);
+
+        bool active = guard->active;
+        bool keep = active;
+        if (guard->handoffTo){
+            struct ShardMsg msg = { guard, NULL, guard->currentRoom, guard->handoffTo };
+            struct ShardQueue* queue = worker_outbox(worker, guard->handoffTo->region);
+            if (queue){
+                // the guard must be out of this region before the other worker sees it
+                guard_depart(guard);
+                queue_push(queue, &msg);
+                keep = false;
+            } else {
+                guard_cancel_handoff(guard);
+            }
+        }
+        latency_hist_add(&worker->hist, stats_now_ns() - start);
+
+        if (!active){
+            atomic_fetch_sub_explicit(&engine->active, 1, memory_order_acq_rel);
+        }
+        if (keep){
+            i++;
+        } else {
+            worker->guards[i] = worker->guards[--worker->guardCount];
+        }
+    }
+
+    for (int i = 0; i < worker->thiefCount; ){
+        struct Thief* thief = worker->thieves[i];
+        thief_update(thief);
+        worker->thiefTurns++;
+
+        if (!thief->active){
+            worker->thieves[i] = worker->thieves[--worker->thiefCount];
+            atomic_fetch_sub_explicit(&engine->active, 1, memory_order_acq_rel);
+            continue;
+        }
+        if (thief->currentRoom->region != worker->region){
+            // the thief already moved using atomics; only ownership of its state changes hands
+            struct ShardMsg msg = { NULL, thief, NULL, thief->currentRoom };
+            struct ShardQueue* queue = worker_outbox(worker, thief->currentRoom->region);
+            if (queue){
+                worker->thieves[i] = worker->thieves[--worker->thiefCount];
+                queue_push(queue, &msg);
+                continue;
+            }
+        }
+        i++;
+    }
+}
+
+static void* shard_thread(void* arg){
+    struct ShardWorker* worker = arg;
+    struct ShardEngine* engine = worker->engine;
+    affinity_pin_self(worker->region);
+
+    while (atomic_load_explicit(&engine->active, memory_order_acquire) > 0){
+        worker_drain(worker);
+        worker_tick(worker);
+        if (worker->guardCount == 0 && worker->thiefCount == 0){
+            sched_yield();
+        }
+    }
+
+    worker->lockOps = lock_thread_acquisitions();
+    return NULL;
+}
+
+/**
+ * @brief move each page of rooms to the node of the worker owning them
+ *
+ * worker w runs as thread index w, so a page goes to the node of the
+ * region owning the room in its middle; pages straddling two regions
+ * cannot be split
+ *
+ * @param[in,out] museum partitioned museum
+ */
+static void shard_place_rooms(struct Museum* museum){
+    if (!affinity_enabled() || affinity_node_count() < 2){
+        return;
+    }
+
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    char* base = (char*)museum->rooms;
+    char* end = base + (size_t)museum->room_count * sizeof(struct Room);
+    for (char* at = base; at < end; at = (char*)(((uintptr_t)at + page) & ~(page - 1))){
+        char* next = (char*)(((uintptr_t)at + page) & ~(page - 1));
+        char* middle = at + ((next < end ? next : end) - at) / 2;
+        struct Room* room = &museum->rooms[(middle - base) / (ptrdiff_t)sizeof(struct Room)];
+        affinity_place(at, 1, affinity_node_for(room->region));
+    }
+}
+
+/**
+ * @brief run the simulation with one worker per region of the museum
+ *
+ * partitions the rooms, gives each worker the guards and thieves inside its
+ * region and connects every pair of regions that share a door with two
+ * bounded SPSC queues. rooms are owned by their region's worker for the
+ * whole run, so no room lock is taken; moves across a region boundary claim
+ * the slot atomically and are finished by the receiving worker
+ *
+ * @param[in,out] museum museum with guards and thieves added
+ * @param[in] options run options; workers picks the number of regions
+ * @param[out] result filled with statistics for this run
+ */
+void sim_run_sharded(struct Museum* museum, const struct SimOptions* options, struct SimResult* result){
+    memset(result, 0, sizeof(*result));
+    latency_hist_init(&result->turnLatency);
+
+    int wanted = options->workers > 0 ? options->workers : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    struct ShardEngine engine;
+    engine.museum = museum;
+    engine.regions = museum_partition(museum, wanted, &result->cutDoors, &result->imbalance);
+    if (engine.regions == 0){
+        fprintf(stderr, "Could not allocate the sharded engine's partition\n");
+        result->aborted = true;
+        return;
+    }
+    int k = engine.regions;
+    result->regions = k;
+
+    engine.queues = calloc((size_t)k * k, sizeof(struct ShardQueue*));
+    engine.workers = aligned_alloc(CACHE_LINE, sizeof(struct ShardWorker) * k);
+    bool ok = engine.queues && engine.workers;
+
+    for (int i = 0; ok && i < museum->room_count; i++){
+        struct Room* room = &museum->rooms[i];
+        for (int j = 0; j < room->connections; j++){
+            int a = room->region;
+            int b = room->connectedRooms[j]->region;
+            if (a != b && !engine.queues[a * k + b]){
+                struct ShardQueue* queue = aligned_alloc(CACHE_LINE, sizeof(struct ShardQueue));
+                if (!queue){
+                    ok = false;
+                    break;
+                }
+                atomic_init(&queue->head, 0);
+                atomic_init(&queue->tail, 0);
+                engine.queues[a * k + b] = queue;
+            }
+        }
+    }
+
+    bool built = ok;
+    if (built){
+        memset(engine.workers, 0, sizeof(struct ShardWorker) * k);
+        for (int w = 0; w < k; w++){
+            struct ShardWorker* worker = &engine.workers[w];
+            worker->region = w;
+            worker->engine = &engine;
+            latency_hist_init(&worker->hist);
+            worker->incoming = malloc(sizeof(struct ShardQueue*) * k);
+            ok = ok && worker->incoming;
+            for (int from = 0; worker->incoming && from < k; from++){
+                if (engine.queues[from * k + w]){
+                    worker->incoming[worker->incomingCount++] = engine.queues[from * k + w];
+                }
+            }
+        }
+
+        int active = 0;
+        for (int i = 0; ok && i < museum->guardCount; i++){
+            struct Guard* guard = &museum->guards[i];
+            if (guard->active){
+                struct ShardWorker* worker = &engine.workers[guard->currentRoom->region];
+                ok = worker_reserve(worker);
+                if (ok){
+                    worker_adopt(worker, guard);
+                    active++;
+                }
+            }
+        }
+        for (int i = 0; ok && i < museum->thiefCount; i++){
+            struct Thief* thief = &museum->thieves[i];
+            if (thief->active){
+                struct ShardWorker* worker = &engine.workers[thief->currentRoom->region];
+                ok = worker_reserve(worker);
+                if (ok){
+                    worker_adopt_thief(worker, thief);
+                    active++;
+                }
+            }
+        }
+        atomic_init(&engine.active, active);
+        atomic_init(&engine.failed, false);
+    }
+
+    if (ok){
+        shard_place_rooms(museum);
+        room_set_owned(true);
+        unsigned long long start = stats_now_ns();
+
+        for (int w = 0; w < k; w++){
+            pthread_create(&engine.workers[w].thread, NULL, shard_thread, &engine.workers[w]);
+        }
+        for (int w = 0; w < k; w++){
+            pthread_join(engine.workers[w].thread, NULL);
+        }
+
+        result->seconds = (double)(stats_now_ns() - start) / 1e9;
+        room_set_owned(false);
+        result->aborted = atomic_load(&engine.failed);
+
+        for (int w = 0; w < k; w++){
+            struct ShardWorker* worker = &engine.workers[w];
+            latency_hist_merge(&result->turnLatency, &worker->hist);
+            result->thiefTurns += worker->thiefTurns;
+            result->handoffs += worker->handoffs;
+            result->queueFull += worker->queueFull;
+            result->lockOps += worker->lockOps;
+            result->crossNode += worker->crossNode;
+        }
+        result->turns = result->turnLatency.count;
+
+        for (int i = 0; i < museum->guardCount; i++){
+            struct Guard* guard = &museum->guards[i];
+            result->moveRetries += guard->moveRetries;
+            result->moveAborts += guard->moveAborts;
+            result->returns += guard->returns;
+            result->returnSteps += guard->returnSteps;
+            result->returnLocks += guard->returnLocks;
+            result->solveTurns += guard->solveTurns;
+        }
+        for (int i = 0; i < museum->thiefCount; i++){
+            result->moveRetries += museum->thieves[i].moveRetries;
+            result->moveAborts += museum->thieves[i].moveAborts;
+        }
+    } else {
+        fprintf(stderr, "Could not allocate the sharded engine for %d regions\n", k);
+        result->aborted = true;
+    }
+
+    if (built){
+        for (int w = 0; w < k; w++){
+            free(engine.workers[w].guards);
+            free(engine.workers[w].thieves);
+            free(engine.workers[w].incoming);
+        }
+        for (int i = 0; i < museum->guardCount; i++){
+            museum->guards[i].region = -1;
+        }
+    }
+    for (int i = 0; engine.queues && i < k * k; i++){
+        free(engine.queues[i]);
+    }
+    free(engine.queues);
+    free(engine.workers);
+}
@@ -0,0 +1,99 @@
+#include "shm.h"
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Start of the segment; the bump pointer lives in shared memory so every
+// process allocates from the same cursor
+struct ShmHeader {
+    _Alignas(64) _Atomic size_t used;
+    size_t size;
+};
+
+static struct ShmHeader* arena = NULL;
+static char arena_name[32] = "";
+
+bool shm_arena_create(size_t bytes, char* error, size_t errorSize){
+    if (arena){
+        snprintf(error, errorSize, "a shared segment is already mapped");
+        return false;
+    }
+    if (bytes < sizeof(struct ShmHeader)){
+        bytes = sizeof(struct ShmHeader);
+    }
+
+    snprintf(arena_name, sizeof(arena_name), "/heist-%d", (int)getpid());
+    int fd = shm_open(arena_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0){
+        snprintf(error, errorSize, "shm_open %s failed", arena_name);
+        arena_name[0] = '\0';
+        return false;
+    }
+
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, (off_t)bytes) == 0){
+        base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED){
+        snprintf(error, errorSize, "could not map %zu bytes of %s", bytes, arena_name);
+        shm_unlink(arena_name);
+        arena_name[0] = '\0';
+        return false;
+    }
+
+    arena = base;
+    atomic_init(&arena->used, sizeof(struct ShmHeader));
+    arena->size = bytes;
+    return true;
+}
+
+void shm_arena_destroy(void){
+    if (!arena){
+        return;
+    }
+    munmap(arena, arena->size);
+    shm_unlink(arena_name);
+    arena = NULL;
+    arena_name[0] = '\0';
+}
+
+bool shm_arena_active(void){
+    return arena != NULL;
+}
+
+const char* shm_arena_name(void){
+    return arena_name;
+}
+
+size_t shm_arena_used(void){
+    return arena ? atomic_load_explicit(&arena->used, memory_order_relaxed) : 0;
+}
+
+void* shm_alloc(size_t align, size_t size){
+    if (!arena){
+        // aligned_alloc wants the size to be a multiple of the alignment
+        return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+    }
+
+    // reserve enough for any padding, then align inside the reservation
+    size_t start = atomic_fetch_add_explicit(&arena->used, size + align - 1, memory_order_relaxed);
+    if (start + size + align - 1 > arena->size){
+        return NULL;
+    }
+
+    uintptr_t at = ((uintptr_t)arena + start + align - 1) & ~(uintptr_t)(align - 1);
+    return (void*)at;
+}
+
+void shm_free(void* ptr){
+    if (arena && (char*)ptr >= (char*)arena && (char*)ptr < (char*)arena + arena->size){
+        return;
+    }
+    free(ptr);
+}
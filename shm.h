@@ -0,0 +1,71 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Address space reserved for the shared museum unless --shm-size says
+// otherwise. The segment is sparse, so only pages that are touched use memory.
+#define SHM_DEFAULT_MB 1024
+
+/**
+ * @brief Create a shared-memory segment and route shm_alloc to it.
+ *
+ * The segment is made with shm_open and mapped MAP_SHARED before any child
+ * process is forked, so every process sees it at the same address and
+ * pointers into it stay valid everywhere. Its name stays in /dev/shm until
+ * shm_arena_destroy.
+ *
+ * @param[in] bytes Size of the segment.
+ * @param[out] error Message describing a failure.
+ * @param[in] errorSize Size of error.
+ * @return false if the segment could not be created or mapped.
+ */
+bool shm_arena_create(size_t bytes, char* error, size_t errorSize);
+
+/**
+ * @brief Unmap and unlink the segment; shm_alloc falls back to the heap again.
+ */
+void shm_arena_destroy(void);
+
+/**
+ * @brief Check whether a shared segment is mapped.
+ * @return true between shm_arena_create and shm_arena_destroy.
+ */
+bool shm_arena_active(void);
+
+/**
+ * @brief Name of the mapped segment.
+ * @return Name such as "/heist-1234", or "" when no segment is mapped.
+ */
+const char* shm_arena_name(void);
+
+/**
+ * @brief Bytes handed out from the segment so far.
+ * @return Bytes in use, 0 when no segment is mapped.
+ */
+size_t shm_arena_used(void);
+
+/**
+ * @brief Allocate memory every process of the run can use.
+ *
+ * Takes the next block of the shared segment with one atomic add, so it is
+ * safe from any thread of any process. Without a segment it is an ordinary
+ * heap allocation.
+ *
+ * @param[in] align Alignment, a power of two.
+ * @param[in] size Bytes wanted.
+ * @return The block, NULL when the segment or the heap ran out.
+ */
+void* shm_alloc(size_t align, size_t size);
+
+/**
+ * @brief Release a block from shm_alloc.
+ *
+ * Blocks inside the segment are never reused; they go away with it.
+ *
+ * @param[in] ptr Block to release, may be NULL.
+ */
+void shm_free(void* ptr);
+
+#endif // SHM_H
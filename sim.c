@@ -0,0 +1,465 @@
+#include "defs.h"
+#include "helpers.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MONITOR_MAX_LISTED 256
+
+struct GuardWorker {
+    struct Guard* guard;
+    int index;                        // Thread index for affinity_pin_self; thieves come first
+    struct SimResult* result;
+    pthread_mutex_t* merge;
+};
+
+struct ThiefWorker {
+    struct Thief* thief;
+    struct SimResult* result;
+    pthread_mutex_t* merge;
+    pthread_t thread;
+};
+
+struct MonitorWorker {
+    struct Museum* museum;
+    int intervalMs;
+    atomic_bool done;
+};
+
+static void* thief_thread(void* arg) {
+    struct ThiefWorker* worker = arg;
+    struct Thief* thief = worker->thief;
+    unsigned long turns = 0;
+    affinity_pin_self(thief->index);
+
+    while (thief->active) {
+        thief_update(thief);
+        turns++;
+    }
+
+    pthread_mutex_lock(worker->merge);
+    worker->result->thiefTurns += turns;
+    worker->result->moveRetries += thief->moveRetries;
+    worker->result->moveAborts += thief->moveAborts;
+    pthread_mutex_unlock(worker->merge);
+    return NULL;
+}
+
+static void* guard_thread(void* arg) {
+    struct GuardWorker* worker = arg;
+    struct Guard* guard = worker->guard;
+    struct LatencyHist hist;
+    latency_hist_init(&hist);
+    affinity_pin_self(worker->index);
+
+    while (guard->active) {
+        unsigned long long start = stats_now_ns();
+        guard_take_turn(guard);
+        latency_hist_add(&hist, stats_now_ns() - start);
+    }
+
+    pthread_mutex_lock(worker->merge);
+    latency_hist_merge(&worker->result->turnLatency, &hist);
+    worker->result->turns += hist.count;
+    worker->result->lockOps += lock_thread_acquisitions();
+    worker->result->moveRetries += guard->moveRetries;
+    worker->result->moveAborts += guard->moveAborts;
+    worker->result->returns += guard->returns;
+    worker->result->returnSteps += guard->returnSteps;
+    worker->result->returnLocks += guard->returnLocks;
+    worker->result->solveTurns += guard->solveTurns;
+    worker->result->crossNode += room_thread_cross_node();
+    worker->result->lockWaits += room_thread_lock_waits();
+    worker->result->lockWaitNs += room_thread_lock_wait_ns();
+    pthread_mutex_unlock(worker->merge);
+    return NULL;
+}
+
+/**
+ * @brief start one thread per thief
+ *
+ * @param[in,out] museum museum with thieves added
+ * @param[out] result statistics the thieves merge into
+ * @param[in] merge mutex guarding result
+ *
+ * @return workers to pass to thieves_join, NULL if memory ran out
+ */
+static struct ThiefWorker* thieves_start(struct Museum* museum, struct SimResult* result, pthread_mutex_t* merge) {
+    struct ThiefWorker* workers = malloc(sizeof(struct ThiefWorker) * (museum->thiefCount > 0 ? museum->thiefCount : 1));
+    if (!workers) {
+        return NULL;
+    }
+
+    for (int i = 0; i < museum->thiefCount; i++) {
+        workers[i].thief = &museum->thieves[i];
+        workers[i].result = result;
+        workers[i].merge = merge;
+        pthread_create(&workers[i].thread, NULL, thief_thread, &workers[i]);
+    }
+    return workers;
+}
+
+/**
+ * @brief wait for every thief thread and free the workers
+ *
+ * @param[in] museum museum the thieves were started from
+ * @param[in] workers workers from thieves_start, may be NULL
+ */
+static void thieves_join(struct Museum* museum, struct ThiefWorker* workers) {
+    if (!workers) {
+        return;
+    }
+    for (int i = 0; i < museum->thiefCount; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    free(workers);
+}
+
+/**
+ * @brief periodically summarize every guard from its published snapshot
+ *
+ * never touches the guard's thread-owned fields, only guard_read_snapshot.
+ * the most crowded room's guards are listed without taking its lock
+ *
+ * @param[in] arg monitor worker
+ */
+static void* monitor_thread(void* arg) {
+    struct MonitorWorker* worker = arg;
+    struct Museum* museum = worker->museum;
+    struct timespec pause = { worker->intervalMs / 1000, (long)(worker->intervalMs % 1000) * 1000000L };
+
+    while (!atomic_load(&worker->done)) {
+        nanosleep(&pause, NULL);
+
+        int active = 0, returning = 0, stress = 0, boredom = 0;
+        for (int i = 0; i < museum->guardCount; i++) {
+            struct GuardSnapshot snap;
+            guard_read_snapshot(&museum->guards[i], &snap);
+            if (!snap.active) {
+                continue;
+            }
+            active++;
+            returning += snap.returningToControl;
+            stress += snap.stress;
+            boredom += snap.boredom;
+        }
+
+        struct Room* crowded = NULL;
+        int crowdedCount = 0;
+        for (int i = 0; i < museum->room_count; i++) {
+            int count = room_guard_count(&museum->rooms[i]);
+            if (count > crowdedCount) {
+                crowded = &museum->rooms[i];
+                crowdedCount = count;
+            }
+        }
+
+        int listed = 0, crowdedStress = 0;
+        if (crowded) {
+            struct Guard* inRoom[MONITOR_MAX_LISTED];
+            listed = room_collect_guards(crowded, inRoom, MONITOR_MAX_LISTED);
+            for (int i = 0; i < listed; i++) {
+                struct GuardSnapshot snap;
+                guard_read_snapshot(inRoom[i], &snap);
+                crowdedStress += snap.stress;
+            }
+        }
+
+        fprintf(stderr, "[monitor] active=%d returning=%d avg_stress=%.1f avg_boredom=%.1f crowded=%s(%d, avg_stress=%.1f)\n",
+                active, returning,
+                active ? (double)stress / active : 0.0,
+                active ? (double)boredom / active : 0.0,
+                crowded ? crowded->name : "-", listed,
+                listed ? (double)crowdedStress / listed : 0.0);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief put the guard slab and rooms on the nodes of the threads using them
+ *
+ * guard i runs as thread index thiefCount + i, so every page of the slab moves to
+ * the node of the guard whose struct starts in it. rooms are locked by
+ * every guard thread, so their pages are interleaved across the nodes
+ * instead of all landing on the node that built the museum
+ *
+ * @param[in,out] museum museum about to be run with pinned threads
+ */
+static void place_memory(struct Museum* museum) {
+    if (!affinity_enabled() || affinity_node_count() < 2) {
+        return;
+    }
+
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    char* base = (char*)museum->guards;
+    char* end = base + (size_t)museum->guardCount * sizeof(struct Guard);
+    for (char* at = base; at < end; at = (char*)(((uintptr_t)at + page) & ~(page - 1))) {
+        int guard = (int)((at - base) / (ptrdiff_t)sizeof(struct Guard));
+        affinity_place(at, 1, affinity_node_for(museum->thiefCount + guard));
+    }
+
+    affinity_interleave(museum->rooms, (size_t)museum->room_count * sizeof(struct Room));
+}
+
+/**
+ * @brief body of one forked guard process
+ *
+ * runs every processes-th guard starting at index on its own thread and
+ * writes the statistics into this process's slot of the shared results.
+ * never returns
+ *
+ * @param[in,out] museum museum in the shared segment
+ * @param[in] index this process's number
+ * @param[in] processes number of guard processes
+ * @param[out] result this process's slot in the shared segment
+ */
+static void guard_process(struct Museum* museum, int index, int processes, struct SimResult* result) {
+    memset(result, 0, sizeof(*result));
+    latency_hist_init(&result->turnLatency);
+
+    pthread_mutex_t merge;
+    pthread_mutex_init(&merge, NULL);
+
+    int count = (museum->guardCount - index + processes - 1) / processes;
+    struct GuardWorker* workers = malloc(sizeof(struct GuardWorker) * count);
+    pthread_t* threads = malloc(sizeof(pthread_t) * count);
+    if (!workers || !threads) {
+        _exit(1);
+    }
+
+    for (int i = 0; i < count; i++) {
+        workers[i].guard = &museum->guards[index + i * processes];
+        workers[i].index = museum->thiefCount + index + i * processes;
+        workers[i].result = result;
+        workers[i].merge = &merge;
+        pthread_create(&threads[i], NULL, guard_thread, &workers[i]);
+    }
+    for (int i = 0; i < count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    fflush(NULL);
+    _exit(0);
+}
+
+/**
+ * @brief run the guards in forked processes that share the museum
+ *
+ * the rooms, their guard slots and the guard slab already live in the
+ * shared segment and every lock was made process-shared. the casefile is
+ * copied into the segment for the run. guard i runs in process
+ * i % processes, while this process keeps the thieves and the monitor.
+ * breadcrumbs are private to whichever process runs the guard, so they are
+ * released before the fork and dropped afterwards. a process that crashes
+ * is reported and its guards stop where they were; any room lock it held
+ * stays held
+ *
+ * @param[in,out] museum museum built after shm_arena_create
+ * @param[in] options run options with processes > 1
+ * @param[out] result filled with statistics merged from every process
+ */
+static void sim_run_processes(struct Museum* museum, const struct SimOptions* options, struct SimResult* result) {
+    memset(result, 0, sizeof(*result));
+    latency_hist_init(&result->turnLatency);
+
+    int processes = options->processes < museum->guardCount ? options->processes : museum->guardCount;
+    struct SimResult* slots = shm_alloc(CACHE_LINE, sizeof(struct SimResult) * (processes > 0 ? processes : 1));
+    struct CaseFile* casefile = shm_alloc(CACHE_LINE, sizeof(struct CaseFile));
+    pid_t* pids = malloc(sizeof(pid_t) * (processes > 0 ? processes : 1));
+    if (!slots || !casefile || !pids) {
+        fprintf(stderr, "Could not allocate guard process state in %s\n", shm_arena_name());
+        free(pids);
+        return;
+    }
+
+    atomic_init(&casefile->collected, casefile_collected(&museum->casefile));
+    atomic_init(&casefile->solved, casefile_solved(&museum->casefile));
+    // the cases themselves are already in the segment, only the header is copied
+    casefile->cases = museum->casefile.cases;
+    casefile->caseCount = museum->casefile.caseCount;
+    atomic_init(&casefile->solvedCases, casefile_solved_cases(&museum->casefile));
+    for (int i = 0; i < EVIDENCE_TYPES; i++) {
+        atomic_init(&casefile->holders[i], casefile_holders(&museum->casefile, (EvidenceMask)1 << i));
+    }
+    for (int i = 0; i < RECENT_DROPS; i++) {
+        atomic_init(&casefile->recentDrops[i], casefile_recent_drop(&museum->casefile, i));
+    }
+    atomic_init(&casefile->dropCursor, atomic_load(&museum->casefile.dropCursor));
+    // thieves stay in this process but must record drops where the guards look
+    for (int i = 0; i < museum->thiefCount; i++) {
+        museum->thieves[i].casefile = casefile;
+    }
+    for (int i = 0; i < museum->guardCount; i++) {
+        museum->guards[i].casefile = casefile;
+        roomstack_free(&museum->guards[i].breadcrumb);
+    }
+
+    pthread_mutex_t merge;
+    pthread_mutex_init(&merge, NULL);
+
+    struct MonitorWorker monitor = { museum, options->monitorMs };
+    atomic_init(&monitor.done, false);
+    pthread_t monitorThread;
+
+    place_memory(museum);
+
+    // children inherit unflushed stdio buffers and would print them twice
+    fflush(NULL);
+    unsigned long long start = stats_now_ns();
+
+    int started = 0;
+    for (int p = 0; p < processes; p++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            guard_process(museum, p, processes, &slots[p]);
+        }
+        if (pid < 0) {
+            fprintf(stderr, "fork failed, %d guard processes started\n", started);
+            break;
+        }
+        pids[started++] = pid;
+        fprintf(stderr, "Guard process %d: pid %d, %d guards\n", p, (int)pid,
+                (museum->guardCount - p + processes - 1) / processes);
+    }
+
+    if (monitor.intervalMs > 0) {
+        pthread_create(&monitorThread, NULL, monitor_thread, &monitor);
+    }
+
+    struct ThiefWorker* thieves = thieves_start(museum, result, &merge);
+
+    for (int p = 0; p < started; p++) {
+        int status = 0;
+        waitpid(pids[p], &status, 0);
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            struct SimResult* one = &slots[p];
+            latency_hist_merge(&result->turnLatency, &one->turnLatency);
+            result->turns += one->turns;
+            result->lockOps += one->lockOps;
+            result->moveRetries += one->moveRetries;
+            result->moveAborts += one->moveAborts;
+            result->returns += one->returns;
+            result->returnSteps += one->returnSteps;
+            result->returnLocks += one->returnLocks;
+            result->solveTurns += one->solveTurns;
+            result->crossNode += one->crossNode;
+            result->lockWaits += one->lockWaits;
+            result->lockWaitNs += one->lockWaitNs;
+        } else {
+            result->failedProcesses++;
+            if (WIFSIGNALED(status)) {
+                fprintf(stderr, "Guard process %d (pid %d) was killed by signal %d\n", p, (int)pids[p], WTERMSIG(status));
+            } else {
+                fprintf(stderr, "Guard process %d (pid %d) exited with status %d\n", p, (int)pids[p], WEXITSTATUS(status));
+            }
+        }
+    }
+    thieves_join(museum, thieves);
+
+    result->seconds = (double)(stats_now_ns() - start) / 1e9;
+    result->processes = started;
+
+    if (monitor.intervalMs > 0) {
+        atomic_store(&monitor.done, true);
+        pthread_join(monitorThread, NULL);
+    }
+
+    // the breadcrumb arrays belonged to the children and went away with them
+    for (int i = 0; i < museum->guardCount; i++) {
+        struct RoomStack* trail = &museum->guards[i].breadcrumb;
+        trail->items = NULL;
+        trail->size = 0;
+        trail->capacity = 0;
+        museum->guards[i].casefile = &museum->casefile;
+    }
+    for (int i = 0; i < museum->thiefCount; i++) {
+        museum->thieves[i].casefile = &museum->casefile;
+    }
+    atomic_store(&museum->casefile.collected, casefile_collected(casefile));
+    atomic_store(&museum->casefile.solved, casefile_solved(casefile));
+    atomic_store(&museum->casefile.solvedCases, casefile_solved_cases(casefile));
+    for (int i = 0; i < EVIDENCE_TYPES; i++) {
+        atomic_store(&museum->casefile.holders[i], casefile_holders(casefile, (EvidenceMask)1 << i));
+    }
+
+    free(pids);
+    pthread_mutex_destroy(&merge);
+}
+
+/**
+ * @brief run every thief and guard on their own threads until all finish
+ *
+ * creates one thread per thief and one per guard, waits for all of them
+ * and fills in the turn counts, lock acquisitions, optimistic move retries
+ * and aborts, and the turn latency histogram
+ *
+ * @param[in,out] museum museum with guards and thieves added
+ * @param[in] options run options, NULL for defaults
+ * @param[out] result filled with statistics for this run
+ */
+void sim_run(struct Museum* museum, const struct SimOptions* options, struct SimResult* result) {
+    if (options && options->engine == ENGINE_SHARDED) {
+        sim_run_sharded(museum, options, result);
+        result->solved = casefile_solved(&museum->casefile);
+        return;
+    }
+    if (options && options->processes > 1 && shm_arena_active()) {
+        sim_run_processes(museum, options, result);
+        result->solved = casefile_solved(&museum->casefile);
+        return;
+    }
+
+    memset(result, 0, sizeof(*result));
+    latency_hist_init(&result->turnLatency);
+
+    pthread_mutex_t merge;
+    pthread_mutex_init(&merge, NULL);
+
+    struct GuardWorker* workers = malloc(sizeof(struct GuardWorker) * museum->guardCount);
+    pthread_t* guardThreads = malloc(sizeof(pthread_t) * museum->guardCount);
+
+    struct MonitorWorker monitor = { museum, options ? options->monitorMs : 0 };
+    atomic_init(&monitor.done, false);
+    pthread_t monitorThread;
+    if (monitor.intervalMs > 0) {
+        pthread_create(&monitorThread, NULL, monitor_thread, &monitor);
+    }
+
+    place_memory(museum);
+    unsigned long long start = stats_now_ns();
+
+    struct ThiefWorker* thieves = thieves_start(museum, result, &merge);
+
+    for (int i = 0; i < museum->guardCount; i++) {
+        workers[i].guard = &museum->guards[i];
+        workers[i].index = museum->thiefCount + i;
+        workers[i].result = result;
+        workers[i].merge = &merge;
+        pthread_create(&guardThreads[i], NULL, guard_thread, &workers[i]);
+    }
+
+    thieves_join(museum, thieves);
+
+    // wait for guards to finish
+    for (int i = 0; i < museum->guardCount; i++) {
+        pthread_join(guardThreads[i], NULL);
+    }
+
+    result->seconds = (double)(stats_now_ns() - start) / 1e9;
+    result->solved = casefile_solved(&museum->casefile);
+
+    if (monitor.intervalMs > 0) {
+        atomic_store(&monitor.done, true);
+        pthread_join(monitorThread, NULL);
+    }
+
+    free(guardThreads);
+    free(workers);
+    pthread_mutex_destroy(&merge);
+}
@@ -0,0 +1,144 @@
+#include "stats.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+unsigned long long stats_now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+/**
+ * @brief map a sample to its bucket
+ *
+ * values below 4 get an exact bucket, everything else uses the top
+ * LAT_SUB_BITS bits below the leading one as the sub-bucket
+ *
+ * @param[in] ns sample value
+ *
+ * @return bucket index
+ */
+static int bucket_of(unsigned long long ns){
+    if (ns < (1u << LAT_SUB_BITS)){
+        return (int)ns;
+    }
+
+    int msb = 63 - __builtin_clzll(ns);
+    int sub = (int)((ns >> (msb - LAT_SUB_BITS)) & ((1u << LAT_SUB_BITS) - 1));
+    return ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) + sub;
+}
+
+/**
+ * @brief midpoint of the range a bucket covers
+ *
+ * @param[in] index bucket index
+ *
+ * @return representative value in nanoseconds
+ */
+static unsigned long long bucket_value(int index){
+    if (index < (1 << LAT_SUB_BITS)){
+        return (unsigned long long)index;
+    }
+
+    int msb = (index >> LAT_SUB_BITS) + LAT_SUB_BITS - 1;
+    int sub = index & ((1 << LAT_SUB_BITS) - 1);
+    unsigned long long width = 1ULL << (msb - LAT_SUB_BITS);
+    unsigned long long lower = ((unsigned long long)((1 << LAT_SUB_BITS) + sub)) << (msb - LAT_SUB_BITS);
+    return lower + width / 2;
+}
+
+void latency_hist_init(struct LatencyHist* hist){
+    memset(hist, 0, sizeof(*hist));
+}
+
+void latency_hist_add(struct LatencyHist* hist, unsigned long long ns){
+    hist->buckets[bucket_of(ns)]++;
+    hist->count++;
+    hist->total += ns;
+}
+
+void latency_hist_merge(struct LatencyHist* into, const struct LatencyHist* from){
+    for (int i = 0; i < LAT_BUCKETS; i++){
+        into->buckets[i] += from->buckets[i];
+    }
+    into->count += from->count;
+    into->total += from->total;
+}
+
+unsigned long long latency_hist_percentile(const struct LatencyHist* hist, double pct){
+    if (hist->count == 0){
+        return 0;
+    }
+
+    unsigned long target = (unsigned long)((pct / 100.0) * (double)hist->count);
+    if (target >= hist->count){
+        target = hist->count - 1;
+    }
+
+    unsigned long seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++){
+        seen += hist->buckets[i];
+        if (seen > target){
+            return bucket_value(i);
+        }
+    }
+
+    return bucket_value(LAT_BUCKETS - 1);
+}
+
+/**
+ * @brief open one counting event for this process and its future threads
+ *
+ * @param[in] type perf event type
+ * @param[in] config perf event config
+ *
+ * @return file descriptor, -1 when the event is not available
+ */
+static int hw_counter_open(unsigned type, unsigned long long config){
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+bool hw_counters_start(struct HwCounters* counters){
+    counters->fds[HW_CACHE_MISSES] = hw_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    counters->fds[HW_L1D_MISSES] = hw_counter_open(PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+    bool any = false;
+    for (int i = 0; i < HW_COUNTER_COUNT; i++){
+        if (counters->fds[i] >= 0){
+            ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+            any = true;
+        }
+    }
+    return any;
+}
+
+void hw_counters_stop(struct HwCounters* counters, unsigned long long values[HW_COUNTER_COUNT]){
+    for (int i = 0; i < HW_COUNTER_COUNT; i++){
+        values[i] = 0;
+        if (counters->fds[i] < 0){
+            continue;
+        }
+        ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counters->fds[i], &values[i], sizeof(values[i])) != sizeof(values[i])){
+            values[i] = 0;
+        }
+        close(counters->fds[i]);
+        counters->fds[i] = -1;
+    }
+}
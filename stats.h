@@ -0,0 +1,77 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+
+// Log-linear histogram: every power of two is split into 4 sub-buckets,
+// so any reported percentile is within 25% of the true value.
+#define LAT_SUB_BITS 2
+#define LAT_BUCKETS (64 << LAT_SUB_BITS)
+
+struct LatencyHist {
+    unsigned long count;
+    unsigned long long total;
+    unsigned long buckets[LAT_BUCKETS];
+};
+
+enum HwCounter {
+    HW_CACHE_MISSES = 0,  // Last-level cache misses
+    HW_L1D_MISSES = 1,    // L1 data cache read misses
+    HW_COUNTER_COUNT
+};
+
+// Hardware counters opened with inherit set, so threads created after
+// hw_counters_start are counted as well.
+struct HwCounters {
+    int fds[HW_COUNTER_COUNT];
+};
+
+/**
+ * @brief Open and enable hardware cache counters for this process.
+ * @param[out] counters Counter handles.
+ * @return false when the kernel or hypervisor exposes no PMU.
+ */
+bool hw_counters_start(struct HwCounters* counters);
+
+/**
+ * @brief Read and close counters opened by hw_counters_start.
+ * @param[in,out] counters Counter handles, closed on return.
+ * @param[out] values One value per enum HwCounter, 0 when unavailable.
+ */
+void hw_counters_stop(struct HwCounters* counters, unsigned long long values[HW_COUNTER_COUNT]);
+
+/**
+ * @brief Read the monotonic clock.
+ * @return Current time in nanoseconds.
+ */
+unsigned long long stats_now_ns(void);
+
+/**
+ * @brief Reset a histogram to empty.
+ * @param[out] hist Histogram to reset.
+ */
+void latency_hist_init(struct LatencyHist* hist);
+
+/**
+ * @brief Record one sample.
+ * @param[in,out] hist Histogram receiving the sample.
+ * @param[in] ns Sample value in nanoseconds.
+ */
+void latency_hist_add(struct LatencyHist* hist, unsigned long long ns);
+
+/**
+ * @brief Add every sample of one histogram into another.
+ * @param[in,out] into Destination histogram.
+ * @param[in] from Source histogram.
+ */
+void latency_hist_merge(struct LatencyHist* into, const struct LatencyHist* from);
+
+/**
+ * @brief Estimate a percentile.
+ * @param[in] hist Histogram to inspect.
+ * @param[in] pct Percentile in [0, 100].
+ * @return Estimated value in nanoseconds, 0 for an empty histogram.
+ */
+unsigned long long latency_hist_percentile(const struct LatencyHist* hist, double pct);
+
+#endif // STATS_H
@@ -0,0 +1,329 @@
+#include "defs.h"
+#include "helpers.h"
+#include <string.h>
+#include <limits.h>
+
+static enum GuardStrategy selected_strategy = STRATEGY_RANDOM;
+
+// Break ties between otherwise equal rooms by room_congestion
+static bool congestion_aware = true;
+
+static const char* const strategy_names[STRATEGY_COUNT] = {
+    "random", "lrv", "frontier", "pursuit"
+};
+
+/**
+ * @brief select the exploration strategy every guard uses from now on
+ *
+ * @param[in] strategy strategy to use; out of range values are ignored
+ */
+void strategy_set(enum GuardStrategy strategy){
+    if (strategy >= 0 && strategy < STRATEGY_COUNT){
+        selected_strategy = strategy;
+    }
+}
+
+/**
+ * @brief return the selected exploration strategy
+ *
+ * @return the strategy, random unless strategy_set chose another
+ */
+enum GuardStrategy strategy_get(void){
+    return selected_strategy;
+}
+
+/**
+ * @brief parse a strategy name such as "random", "lrv", "frontier" or "pursuit"
+ *
+ * @param[in] name strategy name
+ * @param[out] strategy parsed strategy, untouched on failure
+ *
+ * @return true when the name was recognised
+ */
+bool strategy_from_string(const char* name, enum GuardStrategy* strategy){
+    if (!name){
+        return false;
+    }
+    for (int i = 0; i < STRATEGY_COUNT; i++){
+        if (strcmp(name, strategy_names[i]) == 0){
+            *strategy = (enum GuardStrategy)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief return the lowercase name of a strategy
+ *
+ * @param[in] strategy strategy value
+ *
+ * @return static string, "unknown" when out of range
+ */
+const char* strategy_to_string(enum GuardStrategy strategy){
+    if (strategy < 0 || strategy >= STRATEGY_COUNT){
+        return "unknown";
+    }
+    return strategy_names[strategy];
+}
+
+/**
+ * @brief choose whether strategies steer around congested rooms
+ *
+ * @param[in] aware false restores the choices made without congestion data
+ */
+void strategy_set_congestion_aware(bool aware){
+    congestion_aware = aware;
+}
+
+/**
+ * @brief check whether strategies steer around congested rooms
+ *
+ * @return true unless strategy_set_congestion_aware turned it off
+ */
+bool strategy_congestion_aware(void){
+    return congestion_aware;
+}
+
+/**
+ * @brief check whether the guard's device has scanned a room since the last drop there
+ *
+ * @param[in] guard guard asking
+ * @param[in] room room to check
+ *
+ * @return true if the coverage map has the guard's device for the room
+ */
+static bool scanned_by(struct Guard* guard, struct Room* room){
+    return (atomic_load_explicit(&room->scanned, memory_order_relaxed) & guard->device) != 0;
+}
+
+/**
+ * @brief random walk that tries a few doors for a room this device has not scanned
+ *
+ * congestion-aware guards draw every probe and take the least congested
+ * unscanned room, or the least congested room when all were scanned
+ *
+ * @param[in] guard guard moving
+ *
+ * @return the room chosen among the doors drawn
+ */
+static struct Room* random_next(struct Guard* guard){
+    struct Room* from = guard->currentRoom;
+    struct Room* best = NULL;
+    bool bestScanned = true;
+    int bestLoad = INT_MAX;
+
+    for (int probe = 0; probe < GUARD_MOVE_PROBES; probe++){
+        struct Room* next = from->connectedRooms[rand_int_threadsafe(0, from->connections)];
+        bool scanned = scanned_by(guard, next);
+        if (!congestion_aware){
+            best = next;
+            if (!scanned){
+                break;
+            }
+            continue;
+        }
+
+        int load = room_congestion(next);
+        if (!best || (bestScanned && !scanned) || (scanned == bestScanned && load < bestLoad)){
+            best = next;
+            bestScanned = scanned;
+            bestLoad = load;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief pick the neighbour no least-recently-visited guard has picked for longest
+ *
+ * rooms with more than STRATEGY_SAMPLE doors are judged on that many doors
+ * from a random starting point; rooms visited at the same moment (or never)
+ * are told apart by congestion. rooms are stamped on arrival, see
+ * strategy_note_arrival
+ *
+ * @param[in] guard guard moving
+ *
+ * @return the least recently visited neighbour looked at
+ */
+static struct Room* lrv_next(struct Guard* guard){
+    struct Room* from = guard->currentRoom;
+    int connections = from->connections;
+    int looks = connections < STRATEGY_SAMPLE ? connections : STRATEGY_SAMPLE;
+    int start = rand_int_threadsafe(0, connections);
+
+    struct Room* best = NULL;
+    uint64_t oldest = UINT64_MAX;
+    int bestLoad = INT_MAX;
+    for (int i = 0; i < looks; i++){
+        struct Room* room = from->connectedRooms[(start + i) % connections];
+        uint64_t visit = atomic_load_explicit(&room->lastVisit, memory_order_relaxed);
+        int load = congestion_aware && visit <= oldest ? room_congestion(room) : 0;
+        if (visit < oldest || (visit == oldest && load < bestLoad)){
+            oldest = visit;
+            bestLoad = load;
+            best = room;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief step towards the nearest room this device has not scanned
+ *
+ * an unscanned neighbour is taken straight away, the least congested one
+ * when there are several. otherwise the guard keeps
+ * walking to its target, choosing a new one from STRATEGY_SAMPLE random
+ * rooms once the target is reached or scanned by someone else. museums
+ * without route tables fall back to least recently visited
+ *
+ * @param[in] guard guard moving
+ *
+ * @return next room on the way to the frontier
+ */
+static struct Room* frontier_next(struct Guard* guard){
+    struct Room* from = guard->currentRoom;
+    struct Museum* museum = guard->museum;
+    int connections = from->connections;
+    int looks = connections < STRATEGY_SAMPLE ? connections : STRATEGY_SAMPLE;
+    int start = rand_int_threadsafe(0, connections);
+
+    struct Room* open = NULL;
+    int openLoad = INT_MAX;
+    for (int i = 0; i < looks; i++){
+        struct Room* room = from->connectedRooms[(start + i) % connections];
+        if (scanned_by(guard, room)){
+            continue;
+        }
+        if (!congestion_aware){
+            open = room;
+            break;
+        }
+        int load = room_congestion(room);
+        if (load < openLoad){
+            open = room;
+            openLoad = load;
+        }
+    }
+    if (open){
+        guard->target = NULL;
+        return open;
+    }
+
+    if (!museum->routeNext){
+        return lrv_next(guard);
+    }
+
+    if (!guard->target || guard->target == from || scanned_by(guard, guard->target)){
+        guard->target = NULL;
+        int nearest = -1;
+        for (int i = 0; i < STRATEGY_SAMPLE; i++){
+            struct Room* room = &museum->rooms[rand_int_threadsafe(0, museum->room_count)];
+            int distance = museum_distance(museum, from, room);
+            if (room != from && distance > 0 && !scanned_by(guard, room) && (nearest < 0 || distance < nearest)){
+                nearest = distance;
+                guard->target = room;
+            }
+        }
+    }
+
+    struct Room* next = guard->target ? museum_next_hop(museum, from, guard->target) : NULL;
+    return next ? next : random_next(guard);
+}
+
+/**
+ * @brief step towards a recent evidence drop, nearer drops being more likely
+ *
+ * each remembered drop this device has not scanned since is weighted by
+ * 1 / (1 + distance) and one is drawn. without a usable drop, or without
+ * route tables, the guard walks randomly
+ *
+ * @param[in] guard guard moving
+ *
+ * @return next room on the way to the chosen drop
+ */
+static struct Room* pursuit_next(struct Guard* guard){
+    struct Room* from = guard->currentRoom;
+    struct Museum* museum = guard->museum;
+    if (!museum->routeNext){
+        return random_next(guard);
+    }
+
+    struct Room* drops[RECENT_DROPS];
+    int weights[RECENT_DROPS];
+    int count = 0;
+    int total = 0;
+    for (int i = 0; i < RECENT_DROPS; i++){
+        struct Room* room = casefile_recent_drop(guard->casefile, i);
+        if (!room || room == from || scanned_by(guard, room)){
+            continue;
+        }
+        int distance = museum_distance(museum, from, room);
+        if (distance <= 0){
+            continue;
+        }
+        drops[count] = room;
+        weights[count] = 1024 / (1 + distance);
+        total += weights[count];
+        count++;
+    }
+
+    if (count == 0 || total == 0){
+        return random_next(guard);
+    }
+
+    int draw = rand_int_threadsafe(0, total);
+    int pick = 0;
+    while (draw >= weights[pick]){
+        draw -= weights[pick];
+        pick++;
+    }
+
+    struct Room* next = museum_next_hop(museum, from, drops[pick]);
+    return next ? next : random_next(guard);
+}
+
+/**
+ * @brief record that a guard that is not returning has entered a room
+ *
+ * least recently visited stamps rooms here rather than when picking them,
+ * so a move given up because the room was full leaves no mark. frontier
+ * stamps too on museums without route tables, where it falls back to
+ * least recently visited
+ *
+ * @param[in] guard guard that moved
+ * @param[in,out] room room it entered
+ */
+void strategy_note_arrival(struct Guard* guard, struct Room* room){
+    bool stamps = selected_strategy == STRATEGY_LRV ||
+                  (selected_strategy == STRATEGY_FRONTIER && !guard->museum->routeNext);
+    if (stamps){
+        atomic_store_explicit(&room->lastVisit, stats_now_ns(), memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief choose the room a guard that is not returning moves to next
+ *
+ * @param[in,out] guard guard moving; the frontier strategy keeps its target here
+ *
+ * @return a neighbour of the guard's room, NULL if the room has no doors
+ */
+struct Room* strategy_next_room(struct Guard* guard){
+    if (guard->currentRoom->connections == 0){
+        return NULL;
+    }
+
+    switch (selected_strategy){
+        case STRATEGY_LRV:
+            return lrv_next(guard);
+        case STRATEGY_FRONTIER:
+            return frontier_next(guard);
+        case STRATEGY_PURSUIT:
+            return pursuit_next(guard);
+        case STRATEGY_RANDOM:
+        default:
+            return random_next(guard);
+    }
+}
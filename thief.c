@@ -2,39 +2,44 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "helpers.h"
-#include <semaphore.h>
 
 
 /**
  * @brief Initialize a thief
  *
- * Assigns thief id, selects a random thief type,
- * places it into a random non van room, initializes its mutex, and logs the
- * initialization
+ * Assigns thief id counting up from DEFAULT_THIEF_ID, selects a random profile
+ * from the active catalogue,
+ * places it into a random non van room and logs the initialization
  *
  * @param[out] thief pointer to the thief struct.
  * @param[in,out] museum pointer to the museum.
+ * @param[in] index position in museum->thieves and in the casefile's cases
  */
-void thief_init(struct Thief* thief, struct Museum* museum){
-    thief->id = DEFAULT_THIEF_ID;
+void thief_init(struct Thief* thief, struct Museum* museum, int index){
+    thief->id = DEFAULT_THIEF_ID + index;
+    thief->index = index;
 
-    const enum ThiefProfile* types;
-    int typeNum = get_all_thief_profiles(&types);
-    int gType = rand_int_threadsafe(0, typeNum);
-    thief->type = types[gType];
+    rand_stream_init(&thief->randState, RAND_THIEF, (unsigned)thief->id);
+    rand_bind(&thief->randState);
+    thief->profile = rand_int_threadsafe(0, catalogue_profile_count());
 
+    thief->casefile = &museum->casefile;
     thief->boredom = 0;
     thief->active = true;
-
-    sem_init(&thief->mutex, 0, 1);
-
-    int startRoom = rand_int_threadsafe(1, museum->room_count);
+    thief->moveRetries = 0;
+    thief->moveAborts = 0;
+
+    // draw from every room but one and step over the van, wherever the layout put it
+    int exitRoom = (int)(museum->starting_room - museum->rooms);
+    int startRoom = rand_int_threadsafe(0, museum->room_count - 1);
+    if (startRoom >= exitRoom && museum->room_count > 1){
+        startRoom++;
+    }
+    rand_bind(NULL);
     thief->currentRoom = &museum->rooms[startRoom];
 
-    sem_wait(&thief->currentRoom->mutex);
-    thief->currentRoom->thief = thief;
-    log_thief_init(thief->id, thief->currentRoom->name, thief->type);
-    sem_post(&thief->currentRoom->mutex);
+    room_thief_enter(thief->currentRoom);
+    log_thief_init(thief->id, thief->currentRoom->name, thief->profile);
 }
 
 /**
@@ -42,7 +47,9 @@ void thief_init(struct Thief* thief, struct Museum* museum){
  *
  * thief only moves if no hunters are currently
  * in the room, random connected room is chosen, the thief is safelymoved,
- * and the movement is logged.
+ * and the movement is logged. no room lock is taken: leaving validates that
+ * the room is still free of guards in the same atomic step, and the move is
+ * aborted if a guard walked in since the check.
  *
  * @param[in,out] thief pointer to the thief moving
  */
@@ -54,45 +61,36 @@ void thief_move(struct Thief* thief){
     struct Room* thisRoom = thief->currentRoom;
     struct Room* nextRoom = NULL;
 
-    sem_wait(&thisRoom->mutex);
-    int huntersPresent = thisRoom->guardCount;
+    int huntersPresent = room_guard_count(thisRoom);
     int connections = thisRoom->connections;
 
     if(connections == 0){
-        sem_post(&thisRoom->mutex);
         return;
     }
     //choose a random room to move to
-    int next = rand_int_threadsafe(0, thisRoom->connections);
+    int next = rand_int_threadsafe(0, connections);
     nextRoom = thisRoom->connectedRooms[next];
-    sem_post(&thisRoom->mutex);
 
     if(huntersPresent > 0){
         return;
     }
 
-    lock_rooms(thisRoom, nextRoom);
-
-    if(thisRoom->thief == thief){
-        thisRoom->thief = NULL;
+    if(!room_thief_leave(thisRoom, &thief->moveRetries)){
+        thief->moveAborts++;
+        return;
     }
 
+    room_thief_enter(nextRoom);
     thief->currentRoom = nextRoom;
-    nextRoom->thief = thief;
 
-    sem_wait(&thief->mutex);
-    int boredom = thief->boredom;
-    log_thief_move(thief->id, boredom, thisRoom->name, nextRoom->name);
-    sem_post(&thief->mutex);
-
-    unlock_rooms(thisRoom, nextRoom);
+    log_thief_move(thief->id, thief->boredom, thisRoom->name, nextRoom->name);
 }
 
 /**
  * @brief thief drops one piece of evidence in its room.
  *
- * selects one of thief evidence bits at random,
- * sets corresponding bit in rooms evidence mask, and logs the
+ * selects one of the profile's evidence bits at random, records the thief as its
+ * dropper, sets corresponding bit in rooms evidence mask, and logs the
  * haunting.
  *
  * @param[in,out] thief pointer to the thief haunting
@@ -100,29 +98,21 @@ void thief_move(struct Thief* thief){
 void thief_haunt(struct Thief* thief){
     struct Room* room = thief->currentRoom;
 
-    sem_wait(&room->mutex);
-    //get thief type
-    EvidenceByte drops = thief->type;
-    EvidenceByte evidence[3];
-    int toDrop = 0;
-    //set evidence with thiefs evidence
-    for (int i = 0; i < 8; i++) {
-        EvidenceByte bit = 1 << i;
-        if (drops & bit) {
-            evidence[toDrop++] = bit;
-        }
-    }
-    //choose one to drop
-    int rand = rand_int_threadsafe(0, 3);
-    EvidenceByte drop = evidence[rand];
+    //choose one of the profile's bits to drop, whatever the profile's size
+    EvidenceMask drops = catalogue_profile_mask(thief->profile);
+    int rand = rand_int_threadsafe(0, __builtin_popcountll(drops));
+    EvidenceMask drop = evidence_nth_bit(drops, rand);
 
-    room->evidence |= drop;
+    // the release on the evidence bit publishes who dropped it; if two
+    // thieves leave the same type here before a guard finds it, the later one is credited
+    atomic_store_explicit(&room->droppedBy[__builtin_ctzll(drop)], (uint16_t)thief->index, memory_order_relaxed);
+    atomic_fetch_or_explicit(&room->evidence, drop, memory_order_release);
+    // cleared after the drop: a guard that still sees its scan bit afterwards
+    // marked the room first and is guaranteed to find this evidence
+    atomic_store_explicit(&room->scanned, 0, memory_order_release);
+    casefile_note_drop(thief->casefile, room);
 
-    sem_wait(&thief->mutex);
     log_thief_evidence(thief->id, thief->boredom, thief->currentRoom->name, drop);
-    sem_post(&thief->mutex);
-
-    sem_post(&room->mutex);
 }
 
 /**
@@ -141,10 +131,8 @@ void thief_update(struct Thief* thief) {
 
     struct Room* room = thief->currentRoom;
 
-    sem_wait(&room->mutex);
-    int huntersPresent = room->guardCount;
-    //check for hunters
-    sem_wait(&thief->mutex);
+    int huntersPresent = room_guard_count(room);
+    //check for hunters; the thief's fields belong to the thread running it, so no lock
     if (huntersPresent > 0) {
         thief->boredom = 0;
     } else {
@@ -156,11 +144,10 @@ void thief_update(struct Thief* thief) {
     if(boredom >= ENTITY_BOREDOM_MAX){
         thief->active = false;
         log_thief_exit(thief->id, boredom, room->name);
-        sem_post(&thief->mutex);
-        sem_post(&room->mutex);
         return;
     }
 
+    rand_bind(&thief->randState);
     int action;
     //if hunters present thief doesnt move
     if(huntersPresent > 0){
@@ -169,19 +156,16 @@ void thief_update(struct Thief* thief) {
         action = rand_int_threadsafe(0, 3);
     }
 
-    sem_post(&room->mutex);
     //perform whatever action
     if (action == 0) {
         log_thief_idle(thief->id, boredom, thief->currentRoom->name);
-        sem_post(&thief->mutex);
     }
     else if (action == 1) {
-        sem_post(&thief->mutex);
         thief_haunt(thief);
     }
     else if (action == 2) {
-        sem_post(&thief->mutex);
         thief_move(thief);
     }
+    rand_bind(NULL);
 }
 